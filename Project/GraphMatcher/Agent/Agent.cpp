@@ -1,9 +1,9 @@
 #include "stdafx.h"
 #include "Agent.h"
 
-bool Agent::HasPreviousMatch(/* in */ ContextGraph cg, /* out */ ContextGraph matchFound) const
+bool Agent::HasPreviousMatch(/* in */ const ContextGraph &cg, /* out */ ContextGraph &matchFound) const
 {
-	for (auto match : m_cachedMatches)
+	for (auto &match : m_cachedMatches)
 	{
 		if (match.first.IsIncludedIn(cg))
 		{
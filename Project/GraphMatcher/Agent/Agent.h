@@ -22,7 +22,7 @@ public:
 		AddPatterns(patterns...); 
 	}
 
-	bool HasPreviousMatch(/* in */ ContextGraph cg, /* out */ ContextGraph matchFound) const;
+	bool HasPreviousMatch(/* in */ const ContextGraph &cg, /* out */ ContextGraph &matchFound) const;
 
 private:
 
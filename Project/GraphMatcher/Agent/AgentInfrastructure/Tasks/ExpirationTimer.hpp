@@ -0,0 +1,76 @@
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <future>
+
+#include "CTimer.hpp"
+
+//evicts the expired edges of a context graph when the next one is due, instead of polling RefreshGraphConsistency
+//the callback runs on the timer service thread, so the graph owner and the timer share the same mutex
+//destroy it without that mutex held: teardown waits for a callback already running on the service thread
+template <class Graph>
+class TExpirationTimer : public ITimerCallBack
+{
+public:
+   TExpirationTimer(Graph& graph, std::mutex& mutex, CTimerService& srv)
+   : mGraph(graph)
+   , mMutex(mutex)
+   , mService(srv)
+   , mTimer(srv)
+   , mStopped(false)
+   {}
+
+   virtual ~TExpirationTimer()
+   {
+      {
+         //a running callback rearms under the same lock, so after this it can't start another wait
+         std::lock_guard<std::mutex> lock(mStateMutex);
+         mStopped = true;
+         mTimer.stop();
+      }
+
+      //the service runs its handlers one at a time, in order: once this one ran, the cancelled wait
+      //and any callback in flight are done with this object
+      std::promise<void> drained;
+      mService.get_io_service().post([&drained] { drained.set_value(); });
+      drained.get_future().wait();
+   }
+
+   //call with the mutex held, after adding edges that may expire before the armed deadline
+   void rearm()
+   {
+      std::lock_guard<std::mutex> lock(mStateMutex);
+      if (mStopped)
+         return;
+
+      auto next = mGraph.GetNextExpirationTime();
+      if (next == NEVER_EXPIRE)
+      {
+         mTimer.stop();
+         return;
+      }
+
+      //one more millisecond, eviction wants the deadline strictly passed
+      auto delayMs = std::chrono::duration_cast<std::chrono::milliseconds>(next - std::chrono::system_clock::now()).count() + 1;
+      mTimer.start(delayMs > 0 ? static_cast<long>(delayMs) : 0, *this);
+   }
+
+   virtual void timerCallBack()
+   {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mGraph.EvictExpired();
+      rearm();
+   }
+
+private:
+   TExpirationTimer(const TExpirationTimer&);
+   TExpirationTimer& operator =(const TExpirationTimer&);
+
+   Graph& mGraph;
+   std::mutex& mMutex;
+   CTimerService& mService;
+   SingleShotTimer mTimer;
+   std::mutex mStateMutex;
+   bool mStopped;
+};
@@ -9,6 +9,7 @@
 #include <string>
 #include <iostream>
 #include <algorithm>
+#include <numeric>
 #include <memory>
 #include <regex>
 #include <chrono>
@@ -17,9 +18,19 @@
 #include <locale>
 #include <tuple>
 #include <queue>
+#include <deque>
+#include <list>
 #include <sstream>
 #include <fstream>
 #include <random>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <limits>
+#include <cstdint>
+#include <cwctype>
 
 #define HAS_MEM_FUNC(func, name) \
 	template <typename Type, \
@@ -1,9 +1,10 @@
 #include "CommonTypes.h"
 #include "ContextGraph.h"
 
-void ContextGraph::AddEdge(/* in */ const std::wstring &strLabel, 
-						   /* in */ const std::wstring &strNode1,
-						   /* in */ const std::wstring &strNode2,
+template <typename Policy>
+void BasicContextGraph<Policy>::AddEdge(/* in */ const Label &strLabel, 
+						   /* in */ const Label &strNode1,
+						   /* in */ const Label &strNode2,
 						   /* in */ std::chrono::system_clock::time_point expireTime,
 						   /* in */ Duration duration)
 {
@@ -13,37 +14,194 @@ void ContextGraph::AddEdge(/* in */ const std::wstring &strLabel,
 	AddEdge(strLabel, n1, n2, expireTime, duration);
 }
 
-void ContextGraph::AddEdge(/* in */ const std::wstring &strLabel,
+template <typename Policy>
+void BasicContextGraph<Policy>::_AddEdgeFromText(/* in */ const std::wstring &strLabel,
+												 /* in */ const std::wstring &strNode1,
+												 /* in */ const std::wstring &strNode2,
+												 /* in */ std::chrono::system_clock::time_point expireTime,
+												 /* in */ Duration duration)
+{
+	const auto &storedSource = _StoreNode(CNode::FromText(strNode1));
+	const auto &storedDestination = _StoreNode(CNode::FromText(strNode2));
+
+	AddEdge(CEdge::FromText(strLabel, storedSource, storedDestination, expireTime, duration));
+}
+
+template <typename Policy>
+void BasicContextGraph<Policy>::AddEdge(/* in */ const Label &strLabel,
                            /* in */ const CNode &source,
 						   /* in */ const CNode &destination,
 						   /* in */ std::chrono::system_clock::time_point expireTime,
 						   /* in */ Duration duration)
 {
-	const auto its = m_nodes.emplace(source);
-	const auto itd = m_nodes.emplace(destination);
-
-	CEdge e(strLabel, *its.first, *itd.first, expireTime, duration);
+	//the label is checked before the graph changes, AddEdge stores the nodes
+	CEdge e(strLabel, source, destination, expireTime, duration);
 	AddEdge(e);
 }
 
-void ContextGraph::_AddEdgeToAdjacencyMatrix(/* in */ const CEdge &e)
+template <typename Policy>
+auto BasicContextGraph<Policy>::_StoreNode(/* in */ const CNode &node) -> const CNode &
+{
+	auto found = m_nodeIndex.find(node.GetLabelId());
+	if (found != m_nodeIndex.cend())
+		return *found->second;
+
+	auto index = m_nodes.Emplace(node);
+	auto &storedNode = m_nodes[index];
+	storedNode.SetIndex(index);
+	m_nodeIndex.emplace(node.GetLabelId(), &storedNode);
+	m_labelIndex.Insert(storedNode.GetLabel(), index);
+	m_labelDictionary.Add(storedNode.GetLabelId(), storedNode.GetLabel());
+
+	return storedNode;
+}
+
+template <typename Policy>
+void BasicContextGraph<Policy>::_ReleaseNode(/* in */ const CNode &node)
+{
+	//the id may go to another label once the record is gone, so nothing keeps it
+	auto index = node.GetIndex();
+	_ErasePathsOf(node.GetLabelId());
+	m_labelIndex.Erase(node.GetLabel(), index);
+	m_labelDictionary.Remove(node.GetLabelId());
+	m_adjacency.RemoveNode(index);
+	m_nodeIndex.erase(node.GetLabelId());
+	m_nodes.Erase(index);
+}
+
+template <typename Policy>
+auto BasicContextGraph<Policy>::_StoreEdge(/* in */ const CEdge &edge) -> const CEdge &
 {
-	const auto it = m_matrix.find(e.GetSource());
-	if (it != m_matrix.cend())
+	//the endpoints may belong to the caller (like CEdge(label, CNode(...), CNode(...))), the stored edge gets the graph's own
+	const auto &storedSource = _StoreNode(edge.GetSource());
+	const auto &storedDestination = _StoreNode(edge.GetDestination());
+
+	auto index = m_edges.Emplace(edge);
+	auto &storedEdge = m_edges[index];
+	storedEdge.SetIndex(index);
+	storedEdge.SetNodes(storedSource, storedDestination);
+	m_expirations.Push(storedEdge.GetLastExpirationTime(), index);
+	m_validity.Insert(storedEdge.GetDuration().first, storedEdge.GetDuration().second, index);
+	auto &bucket = m_edgesByLabel[edge.GetLabelId()];
+	storedEdge.SetLabelPosition(bucket.size());
+	bucket.emplace_back(&storedEdge);
+	_IndexEdgeEndpoints(storedEdge);
+	m_labelDictionary.Add(storedEdge.GetLabelId(), storedEdge.GetLabel());
+	m_labelDictionary.Add(storedEdge.GetSource().GetLabelId(), storedEdge.GetSource().GetLabel());
+	m_labelDictionary.Add(storedEdge.GetDestination().GetLabelId(), storedEdge.GetDestination().GetLabel());
+
+	return storedEdge;
+}
+
+template <typename Policy>
+void BasicContextGraph<Policy>::_ReleaseEdge(/* in */ const CEdge &edge)
+{
+	//swap with the last edge of the bucket, which takes over the position
+	auto bucket = m_edgesByLabel.find(edge.GetLabelId());
+	if (bucket != m_edgesByLabel.end())
 	{
-		it->second[e.GetDestination()].emplace_back(&e);
+		auto &edges = bucket->second;
+		auto position = edge.GetLabelPosition();
+		auto last = edges.back();
+		edges[position] = last;
+		const_cast<CEdge *>(last)->SetLabelPosition(position);
+		edges.pop_back();
+		if (edges.empty())
+			m_edgesByLabel.erase(bucket);
 	}
+	m_validity.Erase(edge.GetDuration().first, edge.GetIndex());
+	m_labelDictionary.Remove(edge.GetLabelId());
+	m_labelDictionary.Remove(edge.GetSource().GetLabelId());
+	m_labelDictionary.Remove(edge.GetDestination().GetLabelId());
+
+	m_expirations.Release(edge.GetIndex());
+	m_edges.Erase(edge.GetIndex());
+}
+
+template <typename Policy>
+void BasicContextGraph<Policy>::_IndexEdgeEndpoints(/* in */ const CEdge &edge)
+{
+	auto label = edge.GetLabelId();
+	auto source = edge.GetSource().GetLabelId();
+	auto destination = edge.GetDestination().GetLabelId();
+
+	m_edgesByLabelAndSource[MakeLabelNodeKey(label, source)].emplace_back(&edge);
+	m_edgesByLabelAndDestination[MakeLabelNodeKey(label, destination)].emplace_back(&edge);
+	m_edgesByKey[EdgeKey(label, source, destination)].emplace_back(&edge);
+}
+
+template <typename Policy>
+void BasicContextGraph<Policy>::_UnindexEdgeEndpoints(/* in */ const CEdge &edge)
+{
+	auto label = edge.GetLabelId();
+	auto source = edge.GetSource().GetLabelId();
+	auto destination = edge.GetDestination().GetLabelId();
+
+	_EraseFromIndex(m_edgesByLabelAndSource, MakeLabelNodeKey(label, source), &edge);
+	_EraseFromIndex(m_edgesByLabelAndDestination, MakeLabelNodeKey(label, destination), &edge);
+	_EraseFromIndex(m_edgesByKey, EdgeKey(label, source, destination), &edge);
+}
+
+template <typename Policy>
+void BasicContextGraph<Policy>::_AddEdgeToAdjacencyMatrix(/* in */ const CEdge &e)
+{
+	auto &adjacentEdges = m_matrix[e.GetSource().GetLabelId()][e.GetDestination().GetLabelId()];
+	adjacentEdges.emplace_back(&e);
+
+	//an edge between nodes the graph doesn't store can't be indexed by slot, so IsAdjacent goes back to the matrix
+	SlotIndex source, destination;
+	bool bSlots = _FindSlot(e.GetSource(), source) && _FindSlot(e.GetDestination(), destination);
+	if (bSlots)
+		m_adjacency.Set(source, destination);
 	else
+		m_bAdjacencyIndexComplete = false;
+
+	//the paths are node sequences, only a new pair of adjacent nodes makes new ones
+	if (adjacentEdges.size() == 1)
 	{
-		AdjacentEdges edges;
-		edges.emplace_back(&e);
-		Row rowAdjacent(10, [] (const CNode &node) { return std::hash<std::wstring>()(node.GetLabel()); });
-		rowAdjacent[e.GetDestination()] = std::move(edges);
-		m_matrix[e.GetSource()] = std::move(rowAdjacent);
+		_ExtendPathsWithArc(e.GetSource(), e.GetDestination());
+		if (!bSlots)
+			m_reachability.Clear();
+		else
+			m_reachability.AddArc(source, destination);
 	}
 }
 
-void ContextGraph::AddEdge(/* in */ const CEdge &e)
+template <typename Policy>
+void BasicContextGraph<Policy>::_RemoveEdgeFromAdjacencyMatrix(/* in */ const CEdge &e)
+{
+	auto &source = e.GetSource();
+	auto &dest = e.GetDestination();
+
+	auto row = m_matrix.find(source.GetLabelId());
+	if (row == m_matrix.end())
+		return;
+	auto cell = row->second.find(dest.GetLabelId());
+	if (cell == row->second.end())
+		return;
+
+	auto &adjacentEdges = cell->second;
+	auto found = std::find(adjacentEdges.begin(), adjacentEdges.end(), &e);
+	if (found != adjacentEdges.cend())
+		adjacentEdges.erase(found);
+	if (!adjacentEdges.empty())
+		return;
+
+	_InvalidatePathsThroughArc(source.GetLabelId(), dest.GetLabelId());
+	m_reachability.Clear();
+
+	//no empty cells are left behind, the path precomputation reads the front of every cell
+	row->second.erase(cell);
+	if (row->second.empty())
+		m_matrix.erase(row);
+
+	SlotIndex sourceSlot, destinationSlot;
+	if (_FindSlot(source, sourceSlot) && _FindSlot(dest, destinationSlot))
+		m_adjacency.Reset(sourceSlot, destinationSlot);
+}
+
+template <typename Policy>
+void BasicContextGraph<Policy>::AddEdge(/* in */ const CEdge &e)
 {
 	if (!m_bFixedExpireTime)
 	{
@@ -63,23 +221,31 @@ void ContextGraph::AddEdge(/* in */ const CEdge &e)
 
 	if (!m_bAllowDuplicateEdges)
 	{
-		auto found = m_edges.find(e);
-		if (found != m_edges.cend())
+		auto found = GetEdgesBetween(e.GetLabelId(), e.GetSource(), e.GetDestination());
+		if (found.first != found.second)
 		{
-			const_cast<CEdge &>(*found).AddExpirationTime(e.GetLastExpirationTime());
+			auto &merged = const_cast<CEdge &>(**found.first);
+			auto lastExpiration = merged.GetLastExpirationTime();
+			merged.AddExpirationTime(e.GetLastExpirationTime());
+			//an unchanged last expiration already has its entry, a second one would make the edge due twice
+			if (merged.GetLastExpirationTime() != lastExpiration)
+				m_expirations.Push(merged.GetLastExpirationTime(), merged.GetIndex());
 			return;
 		}
 	}
 
-	const auto edgeLocation = m_edges.insert(e);
+	_Thaw();
 
-	m_graph.emplace(e.GetSource(), &*edgeLocation);
-	m_tGraph.emplace(e.GetDestination(), &*edgeLocation);
+	const auto &storedEdge = _StoreEdge(e);
 
-	_AddEdgeToAdjacencyMatrix(*edgeLocation);
+	m_graph.emplace(e.GetSource().GetLabelId(), &storedEdge);
+	m_tGraph.emplace(e.GetDestination().GetLabelId(), &storedEdge);
+
+	_AddEdgeToAdjacencyMatrix(storedEdge);
 }
 
-bool ContextGraph::GetPathBetweenNodes(/* in */ const CNode &n1, /* in */ const CNode &n2, Paths &solutions) const
+template <typename Policy>
+bool BasicContextGraph<Policy>::GetPathBetweenNodes(/* in */ const CNode &n1, /* in */ const CNode &n2, Paths &solutions) const
 {
 	std::unordered_set<CEdgePtr> visitedEdges;
 
@@ -87,20 +253,22 @@ bool ContextGraph::GetPathBetweenNodes(/* in */ const CNode &n1, /* in */ const
 	typedef std::function<void(const CNode &, const CNode &, /* inout */ History &)> RecurringFn;
 
 	History path;
+	if (m_reachability.IsBuilt() && !IsReachable(n1, n2))
+		return false;
 
 	RecurringFn findPath = [&] (const CNode &n1, const CNode &n2, /* inout */ History &previous)
 	{
 		std::unordered_set<CNodePtr> unique_destination;
 
-		const auto foundSource = m_pathMatrix.find(n1);
+		const auto foundSource = m_pathMatrix.find(n1.GetLabelId());
 		if (foundSource != m_pathMatrix.cend())
 		{
-			const auto foundDest = foundSource->second.find(n2);
+			const auto foundDest = foundSource->second.find(n2.GetLabelId());
 			if (foundDest != foundSource->second.cend())
 			{
 				for (const auto &path : foundDest->second)
 				{
-					Paths::key_type solution;
+					typename Paths::key_type solution;
 					for (const auto &node : previous)
 					{
 						solution.emplace_back(node.get());
@@ -113,22 +281,20 @@ bool ContextGraph::GetPathBetweenNodes(/* in */ const CNode &n1, /* in */ const
 			}
 		}
 
-		auto &&children = GetChildren(n1);
-
-		for (auto &&it = children.first; it != children.second; it++)
+		_ForEachChild(n1, [&] (const CEdge *edge) -> bool
 		{
-			const CNode &destination = it->second->GetDestination();
+			const CNode &destination = edge->GetDestination();
 
 			if (unique_destination.cend() != unique_destination.find(CRefNodePtr(destination)))
-				continue;
+				return true;
 
 			unique_destination.emplace(CRefNodePtr(destination));
 
-			if (visitedEdges.cend() == visitedEdges.find(CRefEdgePtr(*it->second)))
+			if (visitedEdges.cend() == visitedEdges.find(CRefEdgePtr(*edge)))
 			{
 				if (&destination == &n2)
 				{
-					Paths::key_type solution;
+					typename Paths::key_type solution;
 					for (const auto &it : previous)
 					{
 						solution.emplace_back(it.get());
@@ -138,22 +304,23 @@ bool ContextGraph::GetPathBetweenNodes(/* in */ const CNode &n1, /* in */ const
 					solutions.emplace(solution);
 				}
 
-				visitedEdges.emplace(CRefEdgePtr(*it->second));
+				visitedEdges.emplace(CRefEdgePtr(*edge));
 
 				previous.emplace_back(CRefNodePtr(destination));
 				findPath(destination, n2, previous);
 				previous.pop_back();
 
-				visitedEdges.erase(CRefEdgePtr(*it->second));
+				visitedEdges.erase(CRefEdgePtr(*edge));
 			}
-		}
+
+			return true;
+		});
 	};
 
-	auto it = m_nodes.find(n1);
-	if (it != m_nodes.cend())
+	const CNode *firstNode = nullptr;
+	if (FindNodeById(n1.GetLabelId(), firstNode))
 	{
-		const CNode &firstNode = *m_nodes.find(n1);
-		path.emplace_back(CRefNodePtr(firstNode));
+		path.emplace_back(CRefNodePtr(*firstNode));
 		findPath(n1, n2, path);
 	}
 
@@ -163,75 +330,457 @@ bool ContextGraph::GetPathBetweenNodes(/* in */ const CNode &n1, /* in */ const
 	return true;
 }
 
-bool ContextGraph::_IsRegexMatch(/* in */ const std::wstring &regex, /* in */ const std::wstring &string) const
+template <typename Policy>
+void BasicContextGraph<Policy>::BuildReachabilityIndex(void)
 {
-	return boost::regex_match(string, boost::wregex(regex));
+	std::vector<std::pair<SlotIndex, SlotIndex>> arcs;
+	for (const auto &row : m_matrix)
+		for (const auto &cell : row.second)
+		{
+			SlotIndex source, destination;
+			if (!_FindSlot(cell.second.front()->GetSource(), source) || !_FindSlot(cell.second.front()->GetDestination(), destination))
+			{
+				m_reachability.Clear();
+				return;
+			}
+			arcs.emplace_back(source, destination);
+		}
+
+	m_reachability.Build(m_nodes.GetEndIndex(), arcs);
 }
 
-bool ContextGraph::_IsRegexMatch(/* in */ const boost::wregex &regex, /* in */ const std::wstring &string) const
+template <typename Policy>
+bool BasicContextGraph<Policy>::IsReachable(/* in */ const CNode &n1, /* in */ const CNode &n2) const
 {
-	return boost::regex_match(string, regex);
+	SlotIndex source, destination;
+	if (!_FindSlot(n1, source) || !_FindSlot(n2, destination))
+		return false;
+	if (m_reachability.IsBuilt())
+		return m_reachability.IsReachable(source, destination);
+
+	std::vector<bool> visited(m_nodes.GetEndIndex(), false);
+	std::vector<const CNode *> queue(1, &m_nodes[source]);
+	for (size_t next = 0; next < queue.size(); next++)
+	{
+		bool bFound = false;
+		_ForEachChild(*queue[next], [&] (const CEdge *edge) -> bool
+		{
+			auto &child = edge->GetDestination();
+			bFound = child.GetIndex() == destination;
+			if (!bFound && !visited[child.GetIndex()])
+			{
+				visited[child.GetIndex()] = true;
+				queue.emplace_back(&child);
+			}
+			return !bFound;
+		});
+		if (bFound)
+			return true;
+	}
+
+	return false;
 }
 
-void ContextGraph::_AddCurrentPathsToCache(/* in */ const CNode &source, /* in */ const CNode &dest, /* in */ const Paths &roads)
+template <typename Policy>
+auto BasicContextGraph<Policy>::GetShortestPath(/* in */ const CNode &n1, /* in */ const CNode &n2) const -> std::vector<const CEdge *>
 {
-	const auto it = m_pathMatrix.find(source);
-	if (it != m_pathMatrix.cend())
+	std::vector<const CEdge *> path;
+	SlotIndex source, destination;
+	if (!_FindSlot(n1, source) || !_FindSlot(n2, destination) || (m_reachability.IsBuilt() && !m_reachability.IsReachable(source, destination)))
+		return path;
+
+	//the edge each node was first reached by; the source has none, even when it is also the destination
+	std::vector<const CEdge *> reachedBy(m_nodes.GetEndIndex(), nullptr);
+	std::vector<const CNode *> queue(1, &m_nodes[source]);
+	const CEdge *last = nullptr;
+	for (size_t next = 0; next < queue.size() && !last; next++)
 	{
-		it->second[dest] = std::move(roads);
+		_ForEachChild(*queue[next], [&] (const CEdge *edge) -> bool
+		{
+			auto slot = edge->GetDestination().GetIndex();
+			if (slot == destination)
+			{
+				last = edge;
+				return false;
+			}
+			if (slot == source || reachedBy[slot])
+				return true;
+			//with the index, the nodes that can't get to the destination aren't expanded
+			if (m_reachability.IsBuilt() && !m_reachability.IsReachable(slot, destination))
+				return true;
+
+			reachedBy[slot] = edge;
+			queue.emplace_back(&edge->GetDestination());
+			return true;
+		});
 	}
-	else
+
+	for (auto edge = last; edge; edge = reachedBy[edge->GetSource().GetIndex()])
+		path.emplace_back(edge);
+	std::reverse(path.begin(), path.end());
+	return path;
+}
+
+template <typename Policy>
+auto BasicContextGraph<Policy>::GetShortestPaths(/* in */ const CNode &n1, /* in */ const CNode &n2, /* in */ size_t k) const -> std::vector<std::vector<const CEdge *>>
+{
+	std::vector<std::vector<const CEdge *>> paths;
+	auto shortest = k ? GetShortestPath(n1, n2) : std::vector<const CEdge *>();
+	if (shortest.empty())
+		return paths;
+
+	//the paths of exactly so many hops, one more at a time; the enumerator prunes on the distance to n2
+	PathEnumerator enumerator(*this);
+	for (size_t hops = shortest.size(); paths.size() < k && hops <= m_nodes.size(); hops++)
 	{
-		PathsRow rowAdjacent(10, [] (const CNode &node) { return std::hash<std::wstring>()(node.GetLabel()); });
-		rowAdjacent[dest] = roads;
-		m_pathMatrix[source] = std::move(rowAdjacent);
+		enumerator.SetLimits(PathLimits(hops));
+		enumerator.Reset(n1, &n2);
+		while (paths.size() < k && enumerator.Next())
+			if (enumerator.GetEdges().size() == hops)
+				paths.emplace_back(enumerator.GetEdges());
 	}
+
+	return paths;
+}
+
+template <typename Policy>
+bool BasicContextGraph<Policy>::_IsRegexMatch(/* in */ const std::wstring &regex, /* in */ const std::wstring &string) const
+{
+	return boost::regex_match(string, *CompiledRegexCache::Instance().Get(regex));
+}
+
+template <typename Policy>
+bool BasicContextGraph<Policy>::_IsRegexMatch(/* in */ const boost::wregex &regex, /* in */ const std::wstring &string) const
+{
+	return boost::regex_match(string, regex);
+}
+
+template <typename Policy>
+void BasicContextGraph<Policy>::_AddCurrentPathsToCache(/* in */ const CNode &source, /* in */ const CNode &dest, /* in */ const Paths &roads)
+{
+	m_pathMatrix[source.GetLabelId()][dest.GetLabelId()] = roads;
+	m_pathSources[dest.GetLabelId()].emplace(source.GetLabelId());
+	for (auto &road : roads)
+		_RegisterPathArcs(source.GetLabelId(), dest.GetLabelId(), road);
 }
 
-void ContextGraph::_AddSingleUniquePathToCache(/* in */ const CNode &source, /* in */ const CNode &dest, /* in */ const Paths::key_type &road)
+template <typename Policy>
+void BasicContextGraph<Policy>::_AddSingleUniquePathToCache(/* in */ const CNode &source, /* in */ const CNode &dest, /* in */ const typename Paths::key_type &road)
 {
 	static auto pathComparator = [] (const std::vector<CNode const *> &l1, const std::vector<CNode const *> &l2) { return l1.size() > l2.size(); };
 
-	const auto foundSource = m_pathMatrix.find(source);
-	if (foundSource != m_pathMatrix.cend())
+	auto &row = m_pathMatrix[source.GetLabelId()];
+	auto foundDest = row.find(dest.GetLabelId());
+	if (foundDest == row.end())
 	{
-		const auto foundDest = foundSource->second.find(dest);
-		if (foundDest != foundSource->second.cend())
-			foundDest->second.emplace(road);
-		else
+		foundDest = row.emplace(dest.GetLabelId(), Paths(pathComparator)).first;
+		m_pathSources[dest.GetLabelId()].emplace(source.GetLabelId());
+	}
+
+	foundDest->second.emplace(road);
+	_RegisterPathArcs(source.GetLabelId(), dest.GetLabelId(), road);
+}
+
+template <typename Policy>
+void BasicContextGraph<Policy>::_RegisterPathArcs(/* in */ LabelId source, /* in */ LabelId dest, /* in */ const typename Paths::key_type &road)
+{
+	auto cell = MakeLabelNodeKey(source, dest);
+	for (size_t i = 1; i < road.size(); i++)
+		m_pathsByArc[MakeLabelNodeKey(road[i - 1]->GetLabelId(), road[i]->GetLabelId())].emplace(cell);
+}
+
+template <typename Policy>
+void BasicContextGraph<Policy>::_ExtendPathsWithArc(/* in */ const CNode &source, /* in */ const CNode &dest)
+{
+	if (!m_bPathsComplete)
+	{
+		//a memo of queries can't tell which answers the arc extends
+		_ClearPaths();
+		return;
+	}
+
+	//every new trail is (trail ending at source) + arc + (trail starting at dest), with no node pair used twice;
+	//they are copied first since adding paths may touch the rows being read
+	typedef typename Paths::key_type Road;
+	std::vector<Road> prefixes(1, Road(1, &source));
+	auto sources = m_pathSources.find(source.GetLabelId());
+	if (sources != m_pathSources.cend())
+		for (auto from : sources->second)
+			for (auto &road : m_pathMatrix[from][source.GetLabelId()])
+				prefixes.emplace_back(road);
+
+	std::vector<Road> suffixes(1, Road(1, &dest));
+	auto row = m_pathMatrix.find(dest.GetLabelId());
+	if (row != m_pathMatrix.cend())
+		for (auto &cell : row->second)
+			suffixes.insert(suffixes.end(), cell.second.cbegin(), cell.second.cend());
+
+	std::unordered_set<uint64_t> arcs;
+	for (auto &prefix : prefixes)
+	{
+		for (auto &suffix : suffixes)
 		{
-			Paths paths(pathComparator);
-			paths.emplace(road);
-			foundSource->second[dest] = paths;
+			Road road(prefix);
+			road.insert(road.end(), suffix.cbegin(), suffix.cend());
+
+			arcs.clear();
+			bool bTrail = true;
+			for (size_t i = 1; i < road.size() && bTrail; i++)
+				bTrail = arcs.emplace(MakeLabelNodeKey(road[i - 1]->GetLabelId(), road[i]->GetLabelId())).second;
+
+			if (bTrail)
+				_AddSingleUniquePathToCache(*road.front(), *road.back(), road);
 		}
 	}
-	else
+}
+
+template <typename Policy>
+void BasicContextGraph<Policy>::_InvalidatePathsThroughArc(/* in */ LabelId source, /* in */ LabelId dest)
+{
+	auto arc = m_pathsByArc.find(MakeLabelNodeKey(source, dest));
+	if (arc == m_pathsByArc.end())
+		return;
+
+	auto fnUsesArc = [source, dest] (/* in */ const typename Paths::key_type &road)
+	{
+		for (size_t i = 1; i < road.size(); i++)
+			if (road[i - 1]->GetLabelId() == source && road[i]->GetLabelId() == dest)
+				return true;
+		return false;
+	};
+
+	//cells registered by paths dropped since then simply have nothing left to remove
+	for (auto key : arc->second)
+	{
+		LabelId from = static_cast<LabelId>(key >> 32);
+		LabelId to = static_cast<LabelId>(key);
+		auto row = m_pathMatrix.find(from);
+		if (row == m_pathMatrix.end())
+			continue;
+		auto cell = row->second.find(to);
+		if (cell == row->second.end())
+			continue;
+
+		auto &paths = cell->second;
+		for (auto path = paths.begin(); path != paths.end(); )
+			path = fnUsesArc(*path) ? paths.erase(path) : ++path;
+
+		if (!paths.empty())
+			continue;
+		row->second.erase(cell);
+		if (row->second.empty())
+			m_pathMatrix.erase(row);
+		auto sources = m_pathSources.find(to);
+		if (sources != m_pathSources.end())
+		{
+			sources->second.erase(from);
+			if (sources->second.empty())
+				m_pathSources.erase(sources);
+		}
+	}
+
+	m_pathsByArc.erase(arc);
+}
+
+template <typename Policy>
+void BasicContextGraph<Policy>::_ClearPaths(void)
+{
+	m_pathMatrix.clear();
+	m_pathSources.clear();
+	m_pathsByArc.clear();
+}
+
+template <typename Policy>
+template <typename Fn>
+void BasicContextGraph<Policy>::_ForEachPathMatchedByAutomaton(/* inout */ RegexAutomaton &automaton,
+															   /* in */ const CNode &source,
+															   /* in */ const CNode &destination,
+															   /* in */ const EdgeFilter &filter,
+															   /* in */ Fn fn) const
+{
+	typedef RegexAutomaton::StateId StateId;
+
+	//the product states (node, automaton state) reachable from (source, start), numbered as they are found
+	std::unordered_map<uint64_t, uint32_t> ids;
+	std::vector<std::pair<const CNode *, StateId>> states;
+	std::vector<std::vector<uint32_t>> predecessors;
+	//edges sharing a label share the automaton step
+	std::unordered_map<uint64_t, StateId> steps;
+
+	auto fnStep = [&] (StateId state, const CEdge &edge) -> StateId
+	{
+		auto key = MakeLabelNodeKey(state, edge.GetLabelId());
+		auto found = steps.find(key);
+		if (found != steps.end())
+			return found->second;
+		return steps[key] = automaton.Step(state, edge.GetLabel());
+	};
+	auto fnId = [&] (const CNode &node, StateId state) -> uint32_t
+	{
+		auto inserted = ids.emplace(MakeLabelNodeKey(node.GetLabelId(), state), static_cast<uint32_t>(states.size()));
+		if (inserted.second)
+		{
+			states.emplace_back(&node, state);
+			predecessors.emplace_back();
+		}
+		return inserted.first->second;
+	};
+
+	const CNode *start = nullptr;
+	if (automaton.Start() == RegexAutomaton::DEAD || !FindNodeById(source.GetLabelId(), start))
+		return;
+	if (m_reachability.IsBuilt() && !IsReachable(source, destination))
+		return;
+
+	fnId(*start, automaton.Start());
+	for (uint32_t i = 0; i < states.size(); i++)
 	{
-		PathsRow rowAdjacent(10, [] (const CNode &node) { return std::hash<std::wstring>()(node.GetLabel()); });
-		Paths paths(pathComparator);
-		paths.emplace(road);
-		rowAdjacent[dest] = paths;
-		m_pathMatrix[source] = std::move(rowAdjacent);
+		_ForEachChild(*states[i].first, [&] (const CEdge *edge) -> bool
+		{
+			if (!filter.Accepts(*edge))
+				return true;
+			auto next = fnStep(states[i].second, *edge);
+			if (next != RegexAutomaton::DEAD)
+				predecessors[fnId(edge->GetDestination(), next)].emplace_back(i);
+			return true;
+		});
 	}
+
+	//live: the states from which an accepting state at destination can still be reached
+	std::vector<bool> live(states.size(), false);
+	std::vector<uint32_t> pending;
+	for (uint32_t i = 0; i < states.size(); i++)
+		if (states[i].first->GetLabelId() == destination.GetLabelId() && automaton.IsAccepting(states[i].second))
+		{
+			live[i] = true;
+			pending.emplace_back(i);
+		}
+	while (!pending.empty())
+	{
+		auto state = pending.back();
+		pending.pop_back();
+		for (auto previous : predecessors[state])
+			if (!live[previous])
+			{
+				live[previous] = true;
+				pending.emplace_back(previous);
+			}
+	}
+
+	if (!live[0])
+		return;
+
+	//trails over the live states only, every step of the walk can still end in a match
+	std::unordered_set<uint64_t> usedArcs;
+	std::vector<const CEdge *> path;
+	std::function<void(uint32_t)> walkFn = [&] (uint32_t current)
+	{
+		const auto &node = *states[current].first;
+		if (!path.empty() && node.GetLabelId() == destination.GetLabelId() && automaton.IsAccepting(states[current].second))
+			fn(path);
+
+		_ForEachChild(node, [&] (const CEdge *edge) -> bool
+		{
+			if (!filter.Accepts(*edge))
+				return true;
+			auto next = fnStep(states[current].second, *edge);
+			if (next == RegexAutomaton::DEAD)
+				return true;
+			auto found = ids.find(MakeLabelNodeKey(edge->GetDestination().GetLabelId(), next));
+			if (found == ids.end() || !live[found->second])
+				return true;
+			auto arc = MakeLabelNodeKey(node.GetLabelId(), edge->GetDestination().GetLabelId());
+			if (!usedArcs.emplace(arc).second)
+				return true;
+
+			path.emplace_back(edge);
+			walkFn(found->second);
+			path.pop_back();
+			usedArcs.erase(arc);
+			return true;
+		});
+	};
+
+	walkFn(0);
+}
+
+template <typename Policy>
+auto BasicContextGraph<Policy>::FindMaxOriginalPathMatchedByRegex(/* in */ const std::wstring &regex,
+																   /* in */ const CNode &source,
+																   /* in */ const CNode &destination,
+																   /* in_opt */ const EdgeFilter &filter) -> std::vector<const CEdge *>
+{
+	Paths roads([] (const std::vector<CNode const *> &l1, const std::vector<CNode const *> &l2) { return l1.size() > l2.size(); });
+	auto solution = _FindMaxPathMatchedByRegex(regex, source, destination, filter, &roads);
+
+	//a precomputed cache already holds the roads the boost fallback walked, and is kept by the graph itself
+	if (!roads.empty() && !m_bPathsComplete)
+		_AddCurrentPathsToCache(source, destination, roads);
+
+	return solution;
 }
 
-std::vector<const CEdge *> ContextGraph::FindMaxOriginalPathMatchedByRegex(/* in */ const std::wstring &regex, /* in */ const CNode &source, /* in */ const CNode &destination)
+template <typename Policy>
+auto BasicContextGraph<Policy>::_FindMaxPathMatchedByRegex(/* in */ const std::wstring &regex,
+															/* in */ const CNode &source,
+															/* in */ const CNode &destination,
+															/* in */ const EdgeFilter &filter,
+															/* out_opt */ Paths *roads) const -> std::vector<const CEdge *>
 {
+	RegexAutomaton automaton;
+	if (!automaton.Compile(regex))
+	{
+		Paths walked([] (const std::vector<CNode const *> &l1, const std::vector<CNode const *> &l2) { return l1.size() > l2.size(); });
+		return _FindMaxPathMatchedByBoostRegex(regex, source, destination, filter, roads ? *roads : walked);
+	}
+
 	std::vector<const CEdge *> solution;
+	_ForEachPathMatchedByAutomaton(automaton, source, destination, filter, [&solution] (const std::vector<const CEdge *> &path)
+	{
+		if (path.size() > solution.size())
+			solution = path;
+	});
+
+	return solution;
+}
+
+template <typename Policy>
+auto BasicContextGraph<Policy>::FindAllOriginalPathsMatchedByRegex(const std::wstring &regex, const CNode &source, const CNode &destination) -> PointerEdgePaths
+{
+	RegexAutomaton automaton;
+	if (!automaton.Compile(regex))
+		return _FindAllPathsMatchedByBoostRegex(regex, source, destination);
 
-	Paths roads([] (const std::vector<CNode const *> &l1, const std::vector<CNode const *> &l2)
-	{ return l1.size() > l2.size(); 
+	PointerEdgePaths solutions([] (const std::vector<const CEdge *> &l1, const std::vector<const CEdge *> &l2) { return &l1 < &l2; });
+	auto hint = solutions.cend();
+	_ForEachPathMatchedByAutomaton(automaton, source, destination, EdgeFilter(), [&] (const std::vector<const CEdge *> &path)
+	{
+		hint = solutions.emplace_hint(hint, path);
 	});
+
+	return solutions;
+}
+
+//the regexes the automaton can't do: every node path, then every edge combination along it, matched whole by boost
+template <typename Policy>
+auto BasicContextGraph<Policy>::_FindMaxPathMatchedByBoostRegex(/* in */ const std::wstring &regex,
+																 /* in */ const CNode &source,
+																 /* in */ const CNode &destination,
+																 /* in */ const EdgeFilter &filter,
+																 /* out */ Paths &roads) const -> std::vector<const CEdge *>
+{
+	std::vector<const CEdge *> solution;
+
 	GetPathBetweenNodes(source, destination, roads);
 
-	boost::wregex regexpr(regex);
+	auto regexpr = CompiledRegexCache::Instance().Get(regex);
 
-	std::function<bool(const Paths::value_type &, std::wstring, std::vector<const CEdge *> &, int)> stepperFn = 
-		[&] (const Paths::value_type &path, std::wstring partialPath, std::vector<const CEdge *> &stackList, int i) -> bool
+	std::function<bool(const typename Paths::value_type &, std::wstring, std::vector<const CEdge *> &, int)> stepperFn = 
+		[&] (const typename Paths::value_type &path, std::wstring partialPath, std::vector<const CEdge *> &stackList, int i) -> bool
 	{
 		if (static_cast<size_t>(i) == path.size())
 		{
-			bool bRet = _IsRegexMatch(regexpr, partialPath);
+			bool bRet = _IsRegexMatch(*regexpr, partialPath);
 			if (bRet)
 			{
 				solution.assign(stackList.cbegin(), stackList.cend());
@@ -239,19 +788,21 @@ std::vector<const CEdge *> ContextGraph::FindMaxOriginalPathMatchedByRegex(/* in
 			return bRet;
 		}
 
-		const auto &edges = m_matrix[*path[i - 1]][*path[i]];
 		bool bRet = false;
-		for (auto &&it : edges)
+		_ForEachEdgeBetween(*path[i - 1], *path[i], [&] (const CEdge *it) -> bool
 		{
+			//the node paths are cached for the whole graph, the rejected edges are skipped here
+			if (!filter.Accepts(*it))
+				return true;
+
 			std::wstring newPath;
 			newPath.assign(partialPath);
 			newPath.append(it->GetLabel());
 			stackList.emplace_back(it);
 			bRet = stepperFn(path, newPath, stackList, i + 1);
 			stackList.pop_back();
-			if (bRet)
-				break;
-		}
+			return !bRet;
+		});
 
 		return bRet;
 	};
@@ -265,26 +816,25 @@ std::vector<const CEdge *> ContextGraph::FindMaxOriginalPathMatchedByRegex(/* in
 		}
 	}
 
-	_AddCurrentPathsToCache(source, destination, roads);
-
 	return solution;
 }
 
-IContextGraph::PointerEdgePaths ContextGraph::FindAllOriginalPathsMatchedByRegex(const std::wstring &regex, const CNode &source, const CNode &destination)
+template <typename Policy>
+auto BasicContextGraph<Policy>::_FindAllPathsMatchedByBoostRegex(const std::wstring &regex, const CNode &source, const CNode &destination) -> PointerEdgePaths
 {
 	PointerEdgePaths solutions([] (const std::vector<const CEdge *> &l1, const std::vector<const CEdge *> &l2) { return &l1 < &l2; });
 	auto hint = solutions.cend();
 
 	Paths roads([] (const std::vector<CNode const *> &l1, const std::vector<CNode const *> &l2) { return l1.size() > l2.size(); });
 	GetPathBetweenNodes(source, destination, roads);
-	boost::wregex regexpr(regex);
+	auto regexpr = CompiledRegexCache::Instance().Get(regex);
 
-	std::function<void(const Paths::value_type &, std::wstring, std::vector<const CEdge *> &, int)> stepperFn = 
-		[&] (const Paths::value_type &path, std::wstring partialPath, std::vector<const CEdge *> &stackList, int i)
+	std::function<void(const typename Paths::value_type &, std::wstring, std::vector<const CEdge *> &, int)> stepperFn = 
+		[&] (const typename Paths::value_type &path, std::wstring partialPath, std::vector<const CEdge *> &stackList, int i)
 	{
 		if (static_cast<size_t>(i) == path.size())
 		{
-			bool bRet = _IsRegexMatch(regexpr, partialPath);
+			bool bRet = _IsRegexMatch(*regexpr, partialPath);
 			if (bRet)
 			{
 				std::vector<const CEdge *> solution;
@@ -298,8 +848,7 @@ IContextGraph::PointerEdgePaths ContextGraph::FindAllOriginalPathsMatchedByRegex
 			return;
 		}
 
-		const auto &edges = m_matrix[*path[i - 1]][*path[i]];
-		for (auto &&it : edges)
+		_ForEachEdgeBetween(*path[i - 1], *path[i], [&] (const CEdge *it) -> bool
 		{
 			std::wstring newPath;
 			newPath.assign(partialPath);
@@ -307,7 +856,8 @@ IContextGraph::PointerEdgePaths ContextGraph::FindAllOriginalPathsMatchedByRegex
 			stackList.emplace_back(it);
 			stepperFn(path, newPath, stackList, i + 1);
 			stackList.pop_back();
-		}
+			return true;
+		});
 	};
 
 	for (auto &&path : roads)
@@ -316,12 +866,15 @@ IContextGraph::PointerEdgePaths ContextGraph::FindAllOriginalPathsMatchedByRegex
 		stepperFn(path, L"", stackList, 1);
 	}
 
-	_AddCurrentPathsToCache(source, destination, roads);
+	//a precomputed cache already holds these and is kept by the graph itself
+	if (!m_bPathsComplete)
+		_AddCurrentPathsToCache(source, destination, roads);
 
 	return solutions;
 }
 
-std::set<const CNode *> ContextGraph::GetLabeledNodes(void) const
+template <typename Policy>
+auto BasicContextGraph<Policy>::GetLabeledNodes(void) const -> std::set<const CNode *>
 {
 	std::set<const CNode *> labeledNodes;
 	auto hint = labeledNodes.cend();
@@ -334,11 +887,14 @@ std::set<const CNode *> ContextGraph::GetLabeledNodes(void) const
 	return labeledNodes;
 }
 
-IContextGraph::TN ContextGraph::_GetPossibleUnknownNodes(/* in */ const ContextGraph patternGraph) const
+template <typename Policy>
+auto BasicContextGraph<Policy>::_GetPossibleUnknownNodes(/* in */ const BasicContextGraph &patternGraph, /* in_opt */ bool bArchive) const -> TN
 {
 	std::set<const CNode *> patternLabeledNodes = patternGraph.GetLabeledNodes();
 	
-	auto nodes = m_nodes;
+	TN nodes(m_nodes.cbegin(), m_nodes.cend());
+	if (bArchive)
+		m_archive.ForEachNode([&nodes] (const CNode &node) { nodes.insert(node); });
 	for (auto &&it : patternLabeledNodes)
 	{
 		nodes.erase(*it);
@@ -347,56 +903,112 @@ IContextGraph::TN ContextGraph::_GetPossibleUnknownNodes(/* in */ const ContextG
 	return nodes;
 }
 
-std::vector<const CEdge *> ContextGraph::GetCorrespondingConcreteEdges(const CEdge &edge, const TN &unkNodes) const
+template <typename Policy>
+auto BasicContextGraph<Policy>::GetEdgesValidDuring(/* in */ Duration interval) const -> std::vector<const CEdge *>
+{
+	AdjacentEdges edges;
+	_CollectEdgesValidDuring(interval, std::numeric_limits<size_t>::max(), edges);
+	return edges;
+}
+
+template <typename Policy>
+bool BasicContextGraph<Policy>::_CollectEdgesValidDuring(/* in */ Duration interval, /* in */ size_t maxEdges, /* out */ AdjacentEdges &edges) const
+{
+	bool bComplete = true;
+	m_validity.ForEachOverlapping(interval.first, interval.second, [&] (SlotIndex slot) -> bool
+	{
+		if (edges.size() == maxEdges)
+			return bComplete = false;
+		edges.emplace_back(&m_edges[slot]);
+		return true;
+	});
+
+	return bComplete;
+}
+
+template <typename Policy>
+auto BasicContextGraph<Policy>::GetCorrespondingConcreteEdges(/* in */ const CEdge &edge, /* in */ const TN &unkNodes, /* in_opt */ const EdgeFilter &filter) const -> std::vector<const CEdge *>
+{
+	return _GetCorrespondingConcreteEdges(edge, [&unkNodes] (const CNode &node) { return unkNodes.find(node) != unkNodes.cend(); }, filter, nullptr);
+}
+
+template <typename Policy>
+template <typename UnknownFn>
+auto BasicContextGraph<Policy>::_GetCorrespondingConcreteEdges(const CEdge &edge, const UnknownFn &fnUnknown, const EdgeFilter &filter, const AdjacentEdges *validEdges) const -> std::vector<const CEdge *>
 {
 	std::vector<const CEdge *> correspondingEdges;
 
-	const auto edges = GetEdgesByName(edge.GetLabel());
 	const auto &source = edge.GetSource();
 	const auto &destination = edge.GetDestination();
 	bool sourceUnknown = source.IsUnknown();
 	bool destinationUnknown = destination.IsUnknown();
 
+	//start from the narrowest index the plain endpoints allow, the conditions below still filter the rest
+	bool bSourceFixed = !sourceUnknown && !source.IsRegex();
+	bool bDestinationFixed = !destinationUnknown && !destination.IsRegex();
+	EdgeRange edges;
+	if (bSourceFixed && bDestinationFixed)
+		edges = GetEdgesBetween(edge.GetLabelId(), source, destination);
+	else if (bSourceFixed)
+		edges = GetEdgesByLabelAndSource(edge.GetLabelId(), source);
+	else if (bDestinationFixed)
+		edges = GetEdgesByLabelAndDestination(edge.GetLabelId(), destination);
+	else
+		edges = GetEdgesByName(edge);
+	//the edges of a narrow validity window may be fewer still, they are checked for the label below
+	auto labelId = edge.GetLabelId();
+	if (validEdges && validEdges->size() < static_cast<size_t>(std::distance(edges.first, edges.second)))
+		edges = std::make_pair(validEdges->cbegin(), validEdges->cend());
+
+	//the archive only opens the segments of the filter window holding the label
+	auto fnAddArchivedEdges = [&] (/* in */ const std::function<bool(const CEdge &)> &conditionFn)
+	{
+		if (!filter.IsArchiveIncluded())
+			return;
+
+		m_archive.ForEachByLabel(edge.GetLabelId(), filter.GetArchiveFrom(), filter.GetArchiveTo(), [&] (const CEdge &archived)
+		{
+			if (filter.Accepts(archived) && conditionFn(archived))
+				correspondingEdges.emplace_back(&archived);
+		});
+	};
+
 	if (sourceUnknown && destinationUnknown)
 	{
-		for (auto edge = edges.first; edge != edges.second; edge++)
+		auto bothUnknownFn = [&] (const CEdge &e) -> bool
 		{
-			auto &otherSource = edge->GetSource();
-			auto &otherDest = edge->GetDestination();
-			if (unkNodes.find(otherSource) == unkNodes.cend() || unkNodes.find(otherDest) == unkNodes.cend())
-				continue;
+			return fnUnknown(e.GetSource()) && fnUnknown(e.GetDestination());
+		};
 
-			correspondingEdges.emplace_back(&*edge);
+		for (auto edge = edges.first; edge != edges.second; edge++)
+		{
+			if ((*edge)->GetLabelId() == labelId && filter.Accepts(**edge) && bothUnknownFn(**edge))
+				correspondingEdges.emplace_back(*edge);
 		}
+		fnAddArchivedEdges(bothUnknownFn);
 	}
 	else
 	{
-		using namespace std::placeholders;
-		
-		boost::wregex sourceRegex;
+		//the regexes run once per distinct label, not once per edge
+		GraphLabelDictionary::BitmapPtr sourceLabels, destinationLabels;
 		if (source.IsRegex())
-			sourceRegex.assign(source.GetLabel());
-		boost::wregex destinationRegex(L"", std::regex_constants::extended);
+			sourceLabels = m_labelDictionary.Match(source.GetLabel());
 		if (destination.IsRegex())
-			destinationRegex.assign(destination.GetLabel());
-		auto sourceMatchRegex = std::bind(static_cast<bool(ContextGraph::*)(const boost::wregex &, const std::wstring &) const>(&ContextGraph::_IsRegexMatch),
-										  this, std::cref(sourceRegex), _1);
-		auto destinationMatchRegex = std::bind(static_cast<bool(ContextGraph::*)(const boost::wregex &, const std::wstring &) const>(&ContextGraph::_IsRegexMatch),
-											   this, std::cref(destinationRegex), _1);
+			destinationLabels = m_labelDictionary.Match(destination.GetLabel());
 
 		auto copyConditionFn = [&] (const CEdge &e) -> bool
 		{
 			const auto &otherSource = e.GetSource();
 			const auto &otherDestination = e.GetDestination();
 
-			if ((sourceUnknown && unkNodes.find(otherSource) == unkNodes.cend()) || (destinationUnknown && unkNodes.find(otherDestination) == unkNodes.cend()))
+			if ((sourceUnknown && !fnUnknown(otherSource)) || (destinationUnknown && !fnUnknown(otherDestination)))
 				return false;
 
 			bool bSourceMatch = false;
 			bool bDestinationMatch = false;
 
-			bSourceMatch = !source.IsRegex()? source == otherSource : sourceMatchRegex(otherSource.GetLabel());
-			bDestinationMatch = !destination.IsRegex()? destination == otherDestination : destinationMatchRegex(otherDestination.GetLabel());
+			bSourceMatch = !source.IsRegex()? source == otherSource : m_labelDictionary.Test(*sourceLabels, otherSource.GetLabelId());
+			bDestinationMatch = !destination.IsRegex()? destination == otherDestination : m_labelDictionary.Test(*destinationLabels, otherDestination.GetLabelId());
 
 			return (sourceUnknown && bDestinationMatch) ||
 				   (destinationUnknown && bSourceMatch) ||
@@ -405,345 +1017,611 @@ std::vector<const CEdge *> ContextGraph::GetCorrespondingConcreteEdges(const CEd
 
 		for (auto edge = edges.first; edge != edges.second; edge++)
 		{
-			if (copyConditionFn(*edge))
+			if ((*edge)->GetLabelId() == labelId && filter.Accepts(**edge) && copyConditionFn(**edge))
 			{
-				correspondingEdges.emplace_back(&*edge);
+				correspondingEdges.emplace_back(*edge);
 			}
 		}
+		fnAddArchivedEdges(copyConditionFn);
 	}
 
 	return correspondingEdges;
 }
 
-std::set<std::set<const CEdge *>> ContextGraph::GetMaximumMatch(/* in */ const ContextGraph &patternGraph, bool bRealTime, bool bMatchInThePast)
+template <typename Policy>
+auto BasicContextGraph<Policy>::GetMaximumMatch(/* in */ const BasicContextGraph &patternGraph, bool bRealTime, bool bMatchInThePast) -> std::set<std::set<const CEdge *>>
+{
+	if (!bRealTime)
+		return GetMaximumMatch(patternGraph, EdgeFilter());
+
+	RefreshGraphConsistency();
+
+	EdgeFilter filter;
+	filter.SetValidityInterval(patternGraph.GetValidityInterval());
+	if (patternGraph.GetTimeLeft<std::chrono::microseconds>() > 0)
+		filter.SetMinimumExpireTime(patternGraph.GetExpireTime());
+	else if (bMatchInThePast)
+		filter.IncludeArchive();
+	else
+		return std::set<std::set<const CEdge *>>(); //no match performed
+
+	return GetMaximumMatch(patternGraph, filter);
+}
+
+template <typename Policy>
+auto BasicContextGraph<Policy>::GetMaximumMatch(/* in */ const BasicContextGraph &patternGraph, /* in */ const EdgeFilter &filter, /* in_opt */ unsigned int threads) -> std::set<std::set<const CEdge *>>
+{
+	//regex nodes are looked up through the label index
+	if (!m_labelIndex.IsBuilt() && std::any_of(patternGraph.GetNodes().begin(), patternGraph.GetNodes().end(), [] (const CNode &node) { return node.IsRegex(); }))
+		BuildNodeLabelIndex();
+
+	//a regex edge only looks for paths between nodes the index says are connected
+	if (!m_reachability.IsBuilt() && std::any_of(patternGraph.GetEdges().begin(), patternGraph.GetEdges().end(), [] (const CEdge &edge) { return edge.IsRegex(); }))
+		BuildReachabilityIndex();
+
+	return static_cast<const BasicContextGraph &>(*this).GetMaximumMatch(patternGraph, filter, threads);
+}
+
+template <typename Policy>
+auto BasicContextGraph<Policy>::GetMaximumMatch(/* in */ const BasicContextGraph &patternGraph, /* in */ const EdgeFilter &filter, /* in_opt */ unsigned int threads) const -> std::set<std::set<const CEdge *>>
 {
 	std::set<std::set<const CEdge *>> bestSolutions;
 
-	if (bRealTime)
+	bool bArchive = filter.IsArchiveIncluded();
+	if (bArchive && std::any_of(patternGraph.GetEdges().begin(), patternGraph.GetEdges().end(), [] (const CEdge &edge) { return edge.IsRegex(); }))
 	{
-		ContextGraph cg;
-		RefreshGraphConsistency();
-		auto patternTime = patternGraph.GetExpireTime();
-		auto validityInterval = patternGraph.GetValidityInterval();
-
-		if (patternGraph.GetTimeLeft<std::chrono::microseconds>() <= 0)
+		//regex paths are only searched over the live edges, so this (rare) case still matches on a merged copy
+		//the copy allows duplicates, so its edge slots follow the order of origins
+		BasicContextGraph cg;
+		std::vector<const CEdge *> origins;
+		auto fnAddAcceptedEdge = [&] (/* in */ const CEdge &edge)
 		{
-			if (bMatchInThePast)
-			{
-				auto fnAddValidEdgesToTheNewGraph = [&cg, validityInterval](const TE &container) -> void 
-				{
-					for (auto &edge : container)
-					{
-						if (ContextGraph::IntervalIntersection(validityInterval, edge.GetDuration()))
-						{
-							cg.AddEdge(edge.GetLabel(), edge.GetSource().GetLabel(), edge.GetDestination().GetLabel());
-						}
-					}
-				};
+			if (!filter.Accepts(edge))
+				return;
+			cg.AddEdge(edge.CopyWithNodes(edge.GetSource(), edge.GetDestination()));
+			origins.emplace_back(&edge);
+		};
+		for (auto &edge : m_edges)
+			fnAddAcceptedEdge(edge);
+		m_archive.ForEachBetween(filter.GetArchiveFrom(), filter.GetArchiveTo(), fnAddAcceptedEdge);
 
-				fnAddValidEdgesToTheNewGraph(m_edges);
-				fnAddValidEdgesToTheNewGraph(m_oldEdges);
-			}
-			else 
-				return bestSolutions; //no match performed
-		}
-		else
+		for (auto &match : cg.GetMaximumMatch(patternGraph, EdgeFilter(), threads))
 		{
-			for (auto &edge : m_edges)
-			{
-				if (patternTime <= edge.GetLastExpirationTime() && IntervalIntersection(validityInterval, edge.GetDuration()))
-				{
-					cg.AddEdge(edge.GetLabel(), edge.GetSource().GetLabel(), edge.GetDestination().GetLabel());
-				}
-			}
+			std::set<const CEdge *> solution;
+			for (auto edge : match)
+				solution.emplace(origins[edge->GetIndex()]);
+			bestSolutions.emplace(std::move(solution));
 		}
 
-		return cg.GetMaximumMatch(patternGraph);
+		return bestSolutions;
 	}
 
-	auto unkNodes = _GetPossibleUnknownNodes(patternGraph);
+	//archived edges point to archived nodes, the matcher assigns the live node with the same label instead
+	auto fnNode = [&] (/* in */ const CNode &node) -> const CNode & { return bArchive ? _CanonicalNode(node) : node; };
+
+	//filtered regex paths don't go to the graph cache
+	RegexCache filteredRegexCache;
+	auto &regexCache = filter.IsEmpty() ? m_regexCache : filteredRegexCache;
+
+	//what the search assigned so far lives here, the graph and the pattern are only read
+	MatchState state(*this, patternGraph);
+
+	//an unknown pattern node takes the nodes whose label the pattern doesn't name, asked by label rather than copied
+	std::unordered_set<LabelId> labeledLabels;
+	for (auto node : patternGraph.GetLabeledNodes())
+		labeledLabels.emplace(node->GetLabelId());
+	auto fnUnknown = [&labeledLabels] (/* in */ const CNode &node) { return labeledLabels.find(node.GetLabelId()) == labeledLabels.end(); };
+
+	//a narrow validity window gets its edges from the interval index, a wide one isn't worth collecting
+	AdjacentEdges validEdges;
+	const AdjacentEdges *pValidEdges = nullptr;
+	if (filter.HasValidityInterval() && filter.GetValidityInterval() != PERMANENT_DURATION &&
+		_CollectEdgesValidDuring(filter.GetValidityInterval(), m_edges.size() / 4, validEdges))
+		pValidEdges = &validEdges;
 
 	auto &patternEdges = patternGraph.GetEdges();
 
 	std::vector<const CEdge * > solution;
-	size_t maxSize = 0;
 	std::vector<CEdge> edges;
 	std::vector<std::pair<CEdge, int>> unsortedEdges;
 
-	for (auto &edge : patternEdges) 
+	for (auto &edge : patternEdges) 
+	{
+		auto &src = edge.GetSource();
+		auto &dst = edge.GetDestination();
+
+		if (edge.IsRegex() || src.IsRegex() || dst.IsRegex() || src.IsUnknown() || dst.IsUnknown())
+		{
+			unsortedEdges.emplace_back(edge, 0);
+			continue;
+		}
+		auto possibleMatches = _GetCorrespondingConcreteEdges(edge, fnUnknown, filter, pValidEdges);
+
+		auto size = possibleMatches.size();
+		if (size == 1)
+		{
+			auto match = possibleMatches[0];
+			auto &src = fnNode(match->GetSource());
+			auto &dest = fnNode(match->GetDestination());
+			state.SetAssigned(src, true);
+			state.SetAssigned(dest, true);
+			state.SetCorrespondent(edge.GetSource(), &src);
+			state.SetCorrespondent(edge.GetDestination(), &dest);
+			solution.emplace_back(possibleMatches[0]);
+		}
+		else
+		{
+			unsortedEdges.emplace_back(edge, static_cast<int>(size));
+		}
+	}
+
+	std::sort(unsortedEdges.begin(), unsortedEdges.end(), [&] (/* in */ const std::pair<const CEdge, int> &edge1, /* in */ const std::pair<const CEdge, int> &edge2)
+	{
+		return edge1.second < edge2.second;
+	});
+	for (auto &e : unsortedEdges)
+	{
+		edges.emplace_back(e.first);
+	}
+
+	typedef std::unordered_map<const CEdge *, std::vector<const CEdge *>, std::function<size_t(const CEdge *)>> CachedEdges;
+	CachedEdges edgeMatchSugestions(10, [](const CEdge *e) { return std::hash<const CEdge *>() (e); });
+	for (auto &edge : edges)
+	{
+		if (!edge.IsRegex())
+		{
+			edgeMatchSugestions[&edge] = _GetCorrespondingConcreteEdges(edge, fnUnknown, filter, pValidEdges);
+		}
+	}
+
+	//the archive only goes along without regex edges (see above), so the ends of a regex edge are all stored nodes
+	auto fnFindPossibleNodesThatMatchNode = [&] (/* in */ const CNode &node) -> std::vector<const CNode *>
+	{
+		std::vector<const CNode*> matchedNodes;
+		if (node.IsUnknown())
+		{
+			for (auto &candidate : m_nodes)
+				if (fnUnknown(candidate))
+					matchedNodes.emplace_back(&candidate);
+		}
+		else
+			matchedNodes = FindNodesMatchingNodeName(node);
+
+		return matchedNodes;
+	};
+
+	//the domains of the ends of a regex edge, over node slots: an edge the filter accepts has to leave the source with a
+	//label the regex can start with, and one has to enter the destination, else no path joins them; the candidates are
+	//the nodes of the domain the pattern node matches, an end the search assigned is tested against the domain instead
+	struct RegexEnds
+	{
+		NodeBitset sources;
+		NodeBitset destinations;
+		std::vector<const CNode *> sourceCandidates;
+		std::vector<const CNode *> destinationCandidates;
+	};
+	std::vector<RegexEnds> regexEnds(edges.size());
+	for (size_t level = 0; level < edges.size(); level++)
+	{
+		auto &edge = edges[level];
+		if (!edge.IsRegex())
+			continue;
+
+		auto &ends = regexEnds[level];
+		ends.sources = NodeBitset(m_nodes.GetEndIndex());
+		ends.destinations = NodeBitset(m_nodes.GetEndIndex());
+		RegexAutomaton automaton;
+		bool bAutomaton = automaton.Compile(edge.GetLabel());
+		std::unordered_map<LabelId, bool> startsMatch;
+		for (auto &candidate : m_edges)
+		{
+			if (!filter.Accepts(candidate))
+				continue;
+
+			auto found = startsMatch.find(candidate.GetLabelId());
+			if (found == startsMatch.end())
+				found = startsMatch.emplace(candidate.GetLabelId(), !bAutomaton || automaton.Step(automaton.Start(), candidate.GetLabel()) != RegexAutomaton::DEAD).first;
+			if (found->second)
+				ends.sources.Set(candidate.GetSource().GetIndex());
+			ends.destinations.Set(candidate.GetDestination().GetIndex());
+		}
+
+		for (auto node : fnFindPossibleNodesThatMatchNode(edge.GetSource()))
+			if (ends.sources.Test(node->GetIndex()))
+				ends.sourceCandidates.emplace_back(node);
+		for (auto node : fnFindPossibleNodesThatMatchNode(edge.GetDestination()))
+			if (ends.destinations.Test(node->GetIndex()))
+				ends.destinationCandidates.emplace_back(node);
+	}
+
+	auto filterOnChosenPairOfNodes = [&] (const MatchState &state, const CNode &patternSource, const CNode &patternDest, const CNode &labeledSource, const CNode &labeledDest) -> bool
+	{
+		bool bSourceAssignment = state.IsAssigned(labeledSource);
+		bool bDestAssignment = state.IsAssigned(labeledDest);
+		auto sourceCorrespondent = state.GetCorrespondent(patternSource);
+		auto destCorrespondent = state.GetCorrespondent(patternDest);
+		
+		if (sourceCorrespondent && sourceCorrespondent != &labeledSource)
+			return false;
+		if (destCorrespondent && destCorrespondent != &labeledDest)
+			return false;
+		if ((bSourceAssignment && !sourceCorrespondent) || (bDestAssignment && !destCorrespondent))
+			return false;
+
+		return true;
+	};
+
+	auto filterOnChosenEdgesFn = [&] (const MatchState &state, const CEdge &patternEdge, const CEdge &labeledEdge)
+	{
+		return !state.IsUsed(labeledEdge) &&
+			   filterOnChosenPairOfNodes(state, patternEdge.GetSource(), patternEdge.GetDestination(), fnNode(labeledEdge.GetSource()), fnNode(labeledEdge.GetDestination()));		
+	};
+
+	//assigns node to patternNode unless it already is, undone by the returned flags
+	auto fnAssign = [&] (/* inout */ MatchState &state, /* in */ const CNode &patternNode, /* in */ const CNode &node) -> std::pair<bool, bool>
+	{
+		std::pair<bool, bool> assigned(!state.IsAssigned(node), state.GetCorrespondent(patternNode) == nullptr);
+		if (assigned.first)
+			state.SetAssigned(node, true);
+		if (assigned.second)
+			state.SetCorrespondent(patternNode, &node);
+		return assigned;
+	};
+	auto fnUnassign = [&] (/* inout */ MatchState &state, /* in */ const CNode &patternNode, /* in */ const CNode &node, /* in */ std::pair<bool, bool> assigned)
+	{
+		if (assigned.first)
+			state.SetAssigned(node, false);
+		if (assigned.second)
+			state.SetCorrespondent(patternNode, nullptr);
+	};
+
+	//how the pattern edge of one level of the search tree was matched: skipped (nothing set), to a concrete edge, or (a
+	//regex edge) to the path between source and destination
+	struct Step
 	{
-		auto &src = edge.GetSource();
-		auto &dst = edge.GetDestination();
+		Step() : edge(nullptr), source(nullptr), destination(nullptr) { }
 
-		if (edge.IsRegex() || src.IsRegex() || dst.IsRegex() || src.IsUnknown() || dst.IsUnknown())
+		const CEdge *edge;
+		const CNode *source;
+		const CNode *destination;
+		std::vector<const CEdge *> path;
+	};
+	//a task is the subtree under its steps, one per level from the first
+	typedef std::vector<Step> Task;
+	typedef WorkStealingPool<Task> Pool;
+
+	typedef std::vector<std::vector<const CEdge *>> Domains;
+
+	//what one worker searches with, its best solutions are merged with the others at the end
+	//forward checking keeps the candidates of every level still feasible under the assignments so far in front of its
+	//domain: a step moves those it rules out past feasible[level], and the trail puts the old ends back
+	struct Searcher
+	{
+		Searcher(/* in */ const MatchState &state, /* in */ const std::vector<const CEdge *> &solution, /* in */ const Domains &domains) :
+			state(state),
+			solution(solution),
+			domains(domains),
+			maxSize(0),
+			push(nullptr)
 		{
-			unsortedEdges.emplace_back(edge, 0);
-			continue;
+			for (auto &domain : domains)
+				feasible.emplace_back(domain.size());
 		}
-		auto possibleMatches = GetCorrespondingConcreteEdges(edge, unkNodes);
 
-		auto size = possibleMatches.size();
-		if (size == 1)
+		MatchState state;
+		std::vector<const CEdge *> solution;
+		Domains domains;
+		std::vector<size_t> feasible;
+		std::vector<std::pair<size_t, size_t>> trail;
+		std::vector<const CEdge *> scratch;
+		Task prefix;
+		std::set<std::set<const CEdge *>> bestSolutions;
+		size_t maxSize;
+		const typename Pool::Push *push;
+	};
+
+	typedef std::pair<std::pair<bool, bool>, std::pair<bool, bool>> Assigned;
+	auto fnApply = [&] (/* inout */ Searcher &searcher, /* in */ const CEdge &patternEdge, /* in */ const Step &step) -> Assigned
+	{
+		Assigned assigned;
+		if (step.edge)
 		{
-			auto match = possibleMatches[0];
-			auto &src = match->GetSource();
-			auto &dest = match->GetDestination();
-			auto &patternSrc = edge.GetSource();
-			auto &patternDest = edge.GetDestination();
-			const_cast<CNode &>(src).SetAssignment(true);
-			const_cast<CNode &>(dest).SetAssignment(true);
-			const_cast<CNode &>(patternSrc).SetCorespondent(true, &src);
-			const_cast<CNode &>(patternDest).SetCorespondent(true, &dest);
-			solution.emplace_back(possibleMatches[0]);
+			searcher.solution.emplace_back(step.edge);
+			searcher.state.SetUsed(*step.edge, true);
 		}
 		else
+			searcher.solution.insert(searcher.solution.end(), step.path.begin(), step.path.end());
+		if (step.source)
 		{
-			unsortedEdges.emplace_back(edge, static_cast<int>(size));
+			assigned.first = fnAssign(searcher.state, patternEdge.GetSource(), *step.source);
+			assigned.second = fnAssign(searcher.state, patternEdge.GetDestination(), *step.destination);
 		}
-	}
-
-	std::sort(unsortedEdges.begin(), unsortedEdges.end(), [&] (/* in */ const std::pair<const CEdge, int> &edge1, /* in */ const std::pair<const CEdge, int> &edge2)
-	{
-		return edge1.second < edge2.second;
-	});
-	for (auto &e : unsortedEdges)
+		return assigned;
+	};
+	auto fnUndo = [&] (/* inout */ Searcher &searcher, /* in */ const CEdge &patternEdge, /* in */ const Step &step, /* in */ Assigned assigned)
 	{
-		edges.emplace_back(e.first);
-	}
+		if (step.source)
+		{
+			fnUnassign(searcher.state, patternEdge.GetDestination(), *step.destination, assigned.second);
+			fnUnassign(searcher.state, patternEdge.GetSource(), *step.source, assigned.first);
+		}
+		if (step.edge)
+		{
+			searcher.state.SetUsed(*step.edge, false);
+			searcher.solution.pop_back();
+		}
+		else
+			searcher.solution.resize(searcher.solution.size() - step.path.size());
+	};
 
-	typedef std::unordered_map<const CEdge *, std::vector<const CEdge *>, std::function<size_t(const CEdge *)>> CachedEdges;
-	CachedEdges edgeMatchSugestions(10, [](const CEdge *e) { return std::hash<int>() (reinterpret_cast<int>(e)); });
-	for (auto &edge : edges)
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	//the levels above splitLevel are handed out as tasks, enough of them to keep every worker busy
+	size_t splitLevel = 0;
+	if (threads > 1)
 	{
-		if (!edge.IsRegex())
+		for (double leaves = 1; splitLevel < edges.size() && leaves < threads * 16.0; splitLevel++)
 		{
-			edgeMatchSugestions[&edge] = GetCorrespondingConcreteEdges(edge, unkNodes);
+			auto &edge = edges[splitLevel];
+			auto &ends = regexEnds[splitLevel];
+			leaves *= 1.0 + (edge.IsRegex() ? ends.sourceCandidates.size() * ends.destinationCandidates.size() : edgeMatchSugestions[&edge].size());
 		}
 	}
 
-	auto firstEdge = edges.begin();
-
-	auto fnFindPossibleNodesThatMatchNode = [&] (/* in */ const CNode &node) -> std::vector<const CNode *>
-	{
-		std::vector<const CNode*> matchedNodes;
-		if (node.IsUnknown())
-			for (auto &node : unkNodes)
-				matchedNodes.emplace_back(&*m_nodes.find(node));
-		else
-			matchedNodes = FindNodesMatchingNodeName(node);
+	//the largest solution any worker found so far: a subtree that can't reach it isn't searched, one that can only tie
+	//with it still is, so which worker gets there first doesn't change the result
+	std::atomic<size_t> maxSize(0);
 
-		return matchedNodes;
-	};
+	//the candidates of each level, a regex edge has none
+	Domains domains(edges.size());
+	for (size_t level = 0; level < edges.size(); level++)
+		if (!edges[level].IsRegex())
+			domains[level] = edgeMatchSugestions.find(&edges[level])->second;
 
-	typedef std::unordered_map<const CNode *, std::vector<const CNode *>, std::function<size_t(const CNode *)>> CachedNodes;
-	CachedNodes nodeMatchSugestions(10, [](const CNode *n) { return std::hash<int>() (reinterpret_cast<int>(n)); });
-	for (auto &node : patternGraph.GetNodes())
+	//pattern edges between the same two pattern nodes need as many distinct context edges between their correspondents
+	std::vector<std::vector<size_t>> pairGroups;
+	std::vector<bool> bGrouped(edges.size(), false);
 	{
-		nodeMatchSugestions.emplace(&node, fnFindPossibleNodesThatMatchNode(node));
+		std::map<std::pair<const CNode *, const CNode *>, std::vector<size_t>> pairs;
+		for (size_t level = 0; level < edges.size(); level++)
+			if (!edges[level].IsRegex())
+				pairs[std::make_pair(&edges[level].GetSource(), &edges[level].GetDestination())].emplace_back(level);
+		for (auto &pair : pairs)
+			if (pair.second.size() > 1)
+			{
+				for (auto level : pair.second)
+					bGrouped[level] = true;
+				pairGroups.emplace_back(std::move(pair.second));
+			}
 	}
 
-	auto filterOnChosenPairOfNodes = [&] (const CNode &patternSource, const CNode &patternDest, const CNode &labeledSource, const CNode &labeledDest) -> bool
+	//drops from the levels from level on the candidates the current assignments rule out, fnRestore(mark) takes it back
+	auto fnNarrow = [&] (/* inout */ Searcher &searcher, /* in */ size_t level) -> size_t
 	{
-		bool bSourceAssignment = labeledSource.HasAssignment();
-		bool bDestAssignment = labeledDest.HasAssignment();
-		bool bSourceCorrespondent = patternSource.HasCorrespondent();
-		bool bDestCorrespondent = patternDest.HasCorrespondent();
-		
-		if (bSourceCorrespondent && &patternSource.GetCorrespondent() != &labeledSource)
-			return false;
-		if (bDestCorrespondent && &patternDest.GetCorrespondent() != &labeledDest)
-			return false;
-		if ((bSourceAssignment && !bSourceCorrespondent) || (bDestAssignment && !bDestCorrespondent))
-			return false;
-
-		return true;
+		auto mark = searcher.trail.size();
+		for (auto l = level; l < edges.size(); l++)
+		{
+			auto &domain = searcher.domains[l];
+			auto end = std::partition(domain.begin(), domain.begin() + searcher.feasible[l],
+									  [&] (const CEdge *edge) { return filterOnChosenEdgesFn(searcher.state, edges[l], *edge); });
+			auto feasible = static_cast<size_t>(end - domain.begin());
+			if (feasible < searcher.feasible[l])
+			{
+				searcher.trail.emplace_back(l, searcher.feasible[l]);
+				searcher.feasible[l] = feasible;
+			}
+		}
+		return mark;
 	};
-
-	auto filterOnChosenEdgesFn = [&] (const CEdge &patternEdge, const CEdge &labeledEdge)
+	auto fnRestore = [&] (/* inout */ Searcher &searcher, /* in */ size_t mark)
 	{
-		return !labeledEdge.IsAlreadyUsed() &&
-			   filterOnChosenPairOfNodes(patternEdge.GetSource(), patternEdge.GetDestination(), labeledEdge.GetSource(), labeledEdge.GetDestination());		
+		for (; searcher.trail.size() > mark; searcher.trail.pop_back())
+			searcher.feasible[searcher.trail.back().first] = searcher.trail.back().second;
 	};
 
-	auto findTheMatchedPathByRegexInCacheFn = [&](/* in */ const std::wstring &regex, 
-                /* in */ const CNode *source,
-                /* in */ const CNode *dest,
-                /* out */ std::vector<const CEdge *> &maxPath) -> bool
+	//a regex edge can still add a path while each end is either free with candidates left or assigned inside its domain
+	//(a free end is only ever assigned a node it matches, so one without candidates has none later either)
+	auto fnRegexFeasible = [&] (/* in */ const Searcher &searcher, /* in */ size_t level) -> bool
 	{
-		auto found = m_regexCache.equal_range(regex);
+		auto fnEnd = [&] (/* in */ const CNode &patternNode, /* in */ const NodeBitset &domain, /* in */ const std::vector<const CNode *> &candidates)
+		{
+			auto correspondent = searcher.state.GetCorrespondent(patternNode);
+			return correspondent ? domain.Test(correspondent->GetIndex()) : !candidates.empty();
+		};
+		auto &ends = regexEnds[level];
+		return fnEnd(edges[level].GetSource(), ends.sources, ends.sourceCandidates) &&
+			   fnEnd(edges[level].GetDestination(), ends.destinations, ends.destinationCandidates);
+	};
 
-		for (auto it = found.first; it != found.second; it++)
+	//the most edges the levels from level on can still add: one per edge with a feasible candidate, no more per pair of
+	//pattern nodes than there are distinct feasible candidates for it, and a whole trail per feasible regex edge
+	auto fnBound = [&] (/* inout */ Searcher &searcher, /* in */ size_t level) -> size_t
+	{
+		size_t bound = 0;
+		for (auto l = level; l < edges.size(); l++)
+			if (edges[l].IsRegex())
+				bound += fnRegexFeasible(searcher, l) ? m_edges.size() : 0;
+			else if (!bGrouped[l] && searcher.feasible[l] > 0)
+				bound++;
+
+		for (auto &group : pairGroups)
 		{
-			auto matchedTuple = it->second;
-			if (std::get<0>(matchedTuple) == source && std::get<1>(matchedTuple) == dest)
+			size_t matchable = 0;
+			auto &candidates = searcher.scratch;
+			candidates.clear();
+			for (auto l : group)
+				if (l >= level && searcher.feasible[l] > 0)
+				{
+					matchable++;
+					candidates.insert(candidates.end(), searcher.domains[l].begin(), searcher.domains[l].begin() + searcher.feasible[l]);
+				}
+			if (matchable > 1)
 			{
-				maxPath = std::get<2>(matchedTuple);
-				return true;
+				std::sort(candidates.begin(), candidates.end());
+				matchable = std::min<size_t>(matchable, std::unique(candidates.begin(), candidates.end()) - candidates.begin());
 			}
+			bound += matchable;
 		}
+		return bound;
+	};
 
-		maxPath = std::vector<const CEdge *>();
-		return false;
+	auto fnSolutionFound = [&] (/* inout */ Searcher &searcher)
+	{
+		auto size = searcher.solution.size();
+		if (size < maxSize || size < searcher.maxSize)
+			return;
+
+		if (size > searcher.maxSize)
+		{
+			searcher.maxSize = size;
+			searcher.bestSolutions.clear();
+		}
+		searcher.bestSolutions.emplace(std::set<const CEdge *>(searcher.solution.cbegin(), searcher.solution.cend()));
+		for (auto seen = maxSize.load(); seen < size && !maxSize.compare_exchange_weak(seen, size); )
+			;
 	};
 
-	std::function<void(/* in */ decltype(firstEdge) &currentEdge)> fnMatchFind = [&](/* inout */ decltype(firstEdge) &currentEdge) -> void
+	std::function<void(/* inout */ Searcher &searcher, /* in */ size_t level)> fnMatchFind;
+
+	//searches the subtree under step, or hands it out when it is above the split
+	auto fnDescend = [&] (/* inout */ Searcher &searcher, /* in */ size_t level, /* in */ Step &&step)
 	{
-		if (currentEdge == edges.cend())
+		if (level < splitLevel)
 		{
-			auto size = solution.size();
-			if (size == maxSize)
-			{
-				bestSolutions.emplace(std::set<const CEdge *>(solution.cbegin(), solution.cend()));
-			}
-			else
-				if (size > maxSize)
-				{
-					maxSize = size;
-					bestSolutions.clear();
-					bestSolutions.emplace(std::set<const CEdge *>(solution.cbegin(), solution.cend()));
-				}
+			Task task(searcher.prefix);
+			task.emplace_back(std::move(step));
+			(*searcher.push)(std::move(task));
+			return;
+		}
+
+		auto assigned = fnApply(searcher, edges[level], step);
+		auto mark = step.edge || step.source ? fnNarrow(searcher, level + 1) : searcher.trail.size();
+		fnMatchFind(searcher, level + 1);
+		fnRestore(searcher, mark);
+		fnUndo(searcher, edges[level], step, assigned);
+	};
 
+	fnMatchFind = [&] (/* inout */ Searcher &searcher, /* in */ size_t level) -> void
+	{
+		if (level == edges.size())
+		{
+			fnSolutionFound(searcher);
 			return;
 		}
+		//ties with the best size so far still go on
+		if (searcher.solution.size() + fnBound(searcher, level) < maxSize)
+			return;
 
-		if (!currentEdge->IsRegex())
+		auto &currentEdge = edges[level];
+		if (!currentEdge.IsRegex())
 		{
-			const auto &possibleEdges = edgeMatchSugestions[&*currentEdge];
-			for(auto &edge : possibleEdges)
+			//the domain only holds candidates feasible here, the levels below don't touch it
+			for (size_t i = 0; i < searcher.feasible[level]; i++)
 			{
-				if (!filterOnChosenEdgesFn(*currentEdge, *edge))
-					continue;
-
-				solution.emplace_back(edge);
-				auto source = &edge->GetSource();
-				auto dest = &edge->GetDestination();
-				
-				const_cast<CEdge *>(edge)->SetAlreayUsed(true);
-				bool bPreviousSourceAssignment = source->HasAssignment();
-				bool bPreviousDestAssignment = dest->HasAssignment();
-				bool bPreviousSourceCorrespondent = currentEdge->GetSource().HasCorrespondent();
-				bool bPreviousDestCorrespondent = currentEdge->GetDestination().HasCorrespondent();
-				if (!bPreviousSourceAssignment)
-					const_cast<CNode *>(source)->SetAssignment(true);
-				if (!bPreviousDestAssignment)
-					const_cast<CNode *>(dest)->SetAssignment(true);
-				if (!bPreviousSourceCorrespondent)
-					const_cast<CNode *>(&currentEdge->GetSource())->SetCorespondent(true, source);
-				if (!bPreviousDestCorrespondent)
-					const_cast<CNode *>(&currentEdge->GetDestination())->SetCorespondent(true, dest);
-
-				fnMatchFind(++currentEdge);
-
-				currentEdge--;
-				solution.pop_back();
-				
-				if (!bPreviousSourceAssignment)
-					const_cast<CNode *>(source)->SetAssignment(false);
-				if (!bPreviousDestAssignment)
-					const_cast<CNode *>(dest)->SetAssignment(false);
-				if (!bPreviousSourceCorrespondent)
-					const_cast<CNode *>(&currentEdge->GetSource())->SetCorespondent(false);
-				if (!bPreviousDestCorrespondent)
-					const_cast<CNode *>(&currentEdge->GetDestination())->SetCorespondent(false);
-				const_cast<CEdge *>(edge)->SetAlreayUsed(false);
+				auto edge = searcher.domains[level][i];
+				Step step;
+				step.edge = edge;
+				step.source = &fnNode(edge->GetSource());
+				step.destination = &fnNode(edge->GetDestination());
+				fnDescend(searcher, level, std::move(step));
 			}
 		}
 		else
 		{
-			auto &source = currentEdge->GetSource();
-			auto &dest = currentEdge->GetDestination();
-
-			std::vector<const CNode*> matchedSources, matchedDestinations;
-			if (source.HasCorrespondent())
-				matchedSources.emplace_back(&source.GetCorrespondent());
-			else 
-				matchedSources = nodeMatchSugestions[&source];
+			auto &source = currentEdge.GetSource();
+			auto &dest = currentEdge.GetDestination();
 
-			if (dest.HasCorrespondent())
-				matchedDestinations.emplace_back(&dest.GetCorrespondent());
-			else 
-				matchedDestinations = nodeMatchSugestions[&dest];
+			//an assigned end is the only candidate, a free one takes those of its domain
+			std::vector<const CNode *> sourceCorrespondent, destinationCorrespondent;
+			auto fnCandidates = [&] (/* in */ const CNode &patternNode, /* in */ const std::vector<const CNode *> &candidates,
+									 /* out */ std::vector<const CNode *> &correspondent) -> const std::vector<const CNode *> &
+			{
+				auto node = searcher.state.GetCorrespondent(patternNode);
+				if (!node)
+					return candidates;
+				correspondent.emplace_back(node);
+				return correspondent;
+			};
+			auto &ends = regexEnds[level];
+			auto &matchedSources = fnCandidates(source, ends.sourceCandidates, sourceCorrespondent);
+			auto &matchedDestinations = fnCandidates(dest, ends.destinationCandidates, destinationCorrespondent);
 
 			for (auto matchSource : matchedSources)
 			{
-				bool bPreviousSourceAssignment = matchSource->HasAssignment();
-				bool bPreviousSourceCorrespondent = currentEdge->GetSource().HasCorrespondent();
-				if (!bPreviousSourceAssignment)
-					const_cast<CNode *>(matchSource)->SetAssignment(true);
-				if (!bPreviousSourceCorrespondent)
-					const_cast<CNode *>(&source)->SetCorespondent(true, matchSource);
+				auto sourceAssigned = fnAssign(searcher.state, source, *matchSource);
 				
 				for (auto matchDest : matchedDestinations)
 				{
-					if (!filterOnChosenPairOfNodes(source, dest, *matchSource, *matchDest))
+					if (!filterOnChosenPairOfNodes(searcher.state, source, dest, *matchSource, *matchDest))
 						continue;
 
-					if (&*matchSource != &*matchDest || source == dest)
+					if ((&*matchSource != &*matchDest || source == dest) && (!m_reachability.IsBuilt() || IsReachable(*matchSource, *matchDest)))
 					{
 						std::vector<const CEdge *> maxPath;
-						const auto &regexLabel = currentEdge->GetLabel();
-						bool bRet = findTheMatchedPathByRegexInCacheFn(regexLabel, matchSource, matchDest, maxPath);
-						if (!bRet)
+						const auto &regexLabel = currentEdge.GetLabel();
+						if (!regexCache.Find(m_generation, regexLabel, matchSource, matchDest, maxPath))
 						{
-							maxPath = FindMaxOriginalPathMatchedByRegex(regexLabel, *matchSource, *matchDest);
-							m_regexCache.emplace(regexLabel, std::make_tuple(matchSource, matchDest, maxPath));
+							maxPath = _FindMaxPathMatchedByRegex(regexLabel, *matchSource, *matchDest, filter);
+							regexCache.Insert(m_generation, regexLabel, matchSource, matchDest, maxPath);
 						}
 						if (!maxPath.empty())
 						{
-							for (const auto e : maxPath)
-								solution.emplace_back(e);
-							bool bPreviousDestAssignment = matchDest->HasAssignment();
-							bool bPreviousDestCorrespondent = currentEdge->GetDestination().HasAssignment();
-							if (!bPreviousDestAssignment)
-								const_cast<CNode *>(matchDest)->SetAssignment(true);
-							if (!bPreviousDestCorrespondent)
-							const_cast<CNode *>(&dest)->SetCorespondent(true, matchDest);
-
-							fnMatchFind(++currentEdge);
-
-							currentEdge--;
-							if (!bPreviousDestAssignment)
-								const_cast<CNode *>(matchDest)->SetAssignment(false);
-							if (!bPreviousDestCorrespondent)
-								const_cast<CNode *>(&dest)->SetCorespondent(false);
-
-							solution.erase(solution.end() - maxPath.size(), solution.end());
+							//the source is assigned already, applying the step again leaves it be
+							Step step;
+							step.source = matchSource;
+							step.destination = matchDest;
+							step.path = std::move(maxPath);
+							fnDescend(searcher, level, std::move(step));
 						}
 					}
 				}
-				if (!bPreviousSourceAssignment)
-					const_cast<CNode *>(matchSource)->SetAssignment(false);
-				if (!bPreviousSourceCorrespondent)
-					const_cast<CNode *>(&source)->SetCorespondent(false);
+				fnUnassign(searcher.state, source, *matchSource, sourceAssigned);
 			}
 		}
 
-		if (std::distance(currentEdge, edges.end()) + solution.size() > maxSize)
-		{
-			fnMatchFind(++currentEdge);
-			currentEdge--;
-		}
+		fnDescend(searcher, level, Step());
 	};
 
-	fnMatchFind(firstEdge);
-
-	for (auto &edge : solution)
+	//a task replays its steps over the assignments of the edges matched up front, searches, and takes them back
+	std::vector<Searcher> searchers(threads, Searcher(state, solution, domains));
+	Pool::Run(threads, Task(), [&] (/* in */ unsigned int worker, /* in */ Task &task, /* in */ const typename Pool::Push &push)
 	{
-		auto &src = edge->GetSource();
-		auto &dest = edge->GetDestination();
-		const_cast<CNode &>(src).SetAssignment(false);
-		const_cast<CNode &>(dest).SetAssignment(false);
-	}
+		auto &searcher = searchers[worker];
+		searcher.push = &push;
+		searcher.prefix = std::move(task);
+
+		std::vector<Assigned> assigned;
+		for (size_t level = 0; level < searcher.prefix.size(); level++)
+			assigned.emplace_back(fnApply(searcher, edges[level], searcher.prefix[level]));
+		auto mark = fnNarrow(searcher, searcher.prefix.size());
+		fnMatchFind(searcher, searcher.prefix.size());
+		fnRestore(searcher, mark);
+		for (auto level = searcher.prefix.size(); level-- > 0; )
+			fnUndo(searcher, edges[level], searcher.prefix[level], assigned[level]);
+	});
+
+	size_t bestSize = 0;
+	for (auto &searcher : searchers)
+		if (!searcher.bestSolutions.empty())
+			bestSize = std::max(bestSize, searcher.maxSize);
+	for (auto &searcher : searchers)
+		if (searcher.maxSize == bestSize)
+			bestSolutions.insert(searcher.bestSolutions.begin(), searcher.bestSolutions.end());
 
 	return bestSolutions;
 }
 
-std::vector<std::vector<const CEdge *>> ContextGraph::ComputeConnexComponents(void) const
+template <typename Policy>
+auto BasicContextGraph<Policy>::ComputeConnexComponents(void) const -> std::vector<std::vector<const CEdge *>>
 {
+	if (m_bFrozen)
+		return m_frozen.ComputeConnexComponents();
+
 	std::unordered_set<CNodePtr> visitedNodes;
 	std::vector<std::vector<const CEdge *>> connexComponents;
 
-	typedef std::pair<T::const_iterator, T::const_iterator> children_type;
+	typedef std::pair<typename T::const_iterator, typename T::const_iterator> children_type;
 
 	for (auto &&it : m_nodes)
 	{
@@ -798,7 +1676,8 @@ std::vector<std::vector<const CEdge *>> ContextGraph::ComputeConnexComponents(vo
 	return connexComponents;
 }
 
-void ContextGraph::_ExtractEdge(/* in */ const std::wstring &edge)
+template <typename Policy>
+void BasicContextGraph<Policy>::_ExtractEdge(/* in */ const std::wstring &edge)
 {
 	size_t size = edge.size();
 	std::locale loc;
@@ -806,14 +1685,14 @@ void ContextGraph::_ExtractEdge(/* in */ const std::wstring &edge)
 	size_t i = 0;
 	for (; i < size && std::isspace((char)edge[i], loc); i++) { }
 
-	boost::wregex regex(LR"r((".*?[^\\]"|.*?)\s*->\s*(".*?[^\\]"|.*?)\s*(?=\[|$))r");
+	auto regex = CompiledRegexCache::Instance().Get(LR"r((".*?[^\\]"|.*?)\s*->\s*(".*?[^\\]"|.*?)\s*(?=\[|$))r");
 
 	boost::wsmatch matches;
-	bool bRet = boost::regex_search(edge.begin() + i, edge.end(), matches, regex);
+	bool bRet = boost::regex_search(edge.begin() + i, edge.end(), matches, *regex);
 	if (!bRet)
 		return;
 	
-	boost::wregex edgeRegex(LR"r(\s*(\w+)\s*=\s*(".*?[^\\]"|.*?)\s*)r");
+	auto edgeRegex = CompiledRegexCache::Instance().Get(LR"r(\s*(\w+)\s*=\s*(".*?[^\\]"|.*?)\s*)r");
 	std::wstring edgeName(L"");
 	time_t expireTime = 0;
 	bool bExpireTimeAvailable = false;
@@ -823,7 +1702,7 @@ void ContextGraph::_ExtractEdge(/* in */ const std::wstring &edge)
 	if (matches.suffix().length() > 0)
 	{
 		std::wstring edgeInfo = matches.suffix().str();
-		while (boost::regex_search(edgeInfo, edgeMatches, edgeRegex))
+		while (boost::regex_search(edgeInfo, edgeMatches, *edgeRegex))
 		{
 			std::wstring s1 = edgeMatches[0];
 			std::wstring s2 = edgeMatches[1];
@@ -859,25 +1738,26 @@ void ContextGraph::_ExtractEdge(/* in */ const std::wstring &edge)
 	const std::wstring &source = matches[1].str();
 	const std::wstring &dest = matches[2].str();
 
-	AddEdge(edgeName.front() == L'\"' ? std::wstring(edgeName.cbegin() + 1, edgeName.cend() - 1) : edgeName,
+	_AddEdgeFromText(edgeName.front() == L'\"' ? std::wstring(edgeName.cbegin() + 1, edgeName.cend() - 1) : edgeName,
 			source.front() == L'\"' ? std::wstring(source.cbegin() + 1, source.cend() - 1) : source,
 			dest.front() == L'\"' ? std::wstring(dest.cbegin() + 1, dest.cend() - 1) : dest,
 			bExpireTimeAvailable? std::chrono::system_clock::from_time_t(expireTime): NEVER_EXPIRE,
 			withinInterval);
 }
 
-void ContextGraph::_ReadGraphFromDotFormat(const std::wstring &dot)
+template <typename Policy>
+void BasicContextGraph<Policy>::_ReadGraphFromDotFormat(const std::wstring &dot)
 {
 	auto ffind = dot.find_first_of(L'{');
 	auto lfind = dot.find_last_of(L"}");
 
-	boost::wregex regex(LR"r(\s*;*\s*$)r");
+	auto regex = CompiledRegexCache::Instance().Get(LR"r(\s*;*\s*$)r");
 
 	boost::wsmatch matches;
 	const auto & substr = dot.substr(ffind + 1, lfind - ffind - 1);
 
 	boost::wsregex_token_iterator endOfSeq;
-	boost::wsregex_token_iterator iterator(substr.cbegin(), substr.cend(), regex);
+	boost::wsregex_token_iterator iterator(substr.cbegin(), substr.cend(), *regex);
 
 	while (iterator != endOfSeq)
 	{
@@ -886,7 +1766,8 @@ void ContextGraph::_ReadGraphFromDotFormat(const std::wstring &dot)
 	}
 }
 
-void ContextGraph::_ReadGraphFromDotFormatNoRegex(const std::wstring &dot)
+template <typename Policy>
+void BasicContextGraph<Policy>::_ReadGraphFromDotFormatNoRegex(const std::wstring &dot)
 {
 	auto ffind = dot.find_first_of(L'{');
 	while (std::isspace(dot[ffind + 1]))
@@ -922,7 +1803,8 @@ void ContextGraph::_ReadGraphFromDotFormatNoRegex(const std::wstring &dot)
 	}	
 }
 
-bool ContextGraph::WriteGraphToDotFile(/* in */ const std::wstring &fileName, /* in */ const std::wstring &graphName) const
+template <typename Policy>
+bool BasicContextGraph<Policy>::WriteGraphToDotFile(/* in */ const std::wstring &fileName, /* in */ const std::wstring &graphName) const
 {
 	std::wofstream file(std::string(fileName.cbegin(), fileName.cend()));
 	if (!file)
@@ -943,7 +1825,8 @@ bool ContextGraph::WriteGraphToDotFile(/* in */ const std::wstring &fileName, /*
 	return true;
 }
 
-bool ContextGraph::BuildFromDotFile(/* in */ const std::wstring &fileName, /* in_opt */ bool bClearPrecedent)
+template <typename Policy>
+bool BasicContextGraph<Policy>::BuildFromDotFile(/* in */ const std::wstring &fileName, /* in_opt */ bool bClearPrecedent)
 {
 	if (bClearPrecedent)
 	{
@@ -964,40 +1847,246 @@ bool ContextGraph::BuildFromDotFile(/* in */ const std::wstring &fileName, /* in
 	return true;
 }
 
-void ContextGraph::Clear()
+template <typename Policy>
+void BasicContextGraph<Policy>::Clear()
 {
+	_Thaw();
 	m_matrix.clear();
-	m_nodes.clear();
-	m_edges.clear();
-	m_oldNodes.clear();
-	m_oldEdges.clear();
+	m_adjacency.Clear();
+	m_expirations.Clear();
+	m_validity.Clear();
+	m_reachability.Clear();
+	m_labelIndex.Clear();
+	m_labelDictionary.Clear();
+	m_bAdjacencyIndexComplete = true;
+	m_nodes.Clear();
+	m_nodeIndex.clear();
+	m_edges.Clear();
+	m_edgesByLabel.clear();
+	m_edgesByLabelAndSource.clear();
+	m_edgesByLabelAndDestination.clear();
+	m_edgesByKey.clear();
+	m_archive.Clear();
 	m_graph.clear();
 	m_tGraph.clear();
-	m_pathMatrix.clear();
+	m_regexCache.Clear();
+	_ClearPaths();
+	m_bPathsComplete = false;
+}
+
+template <typename Policy>
+void BasicContextGraph<Policy>::Swap(/* inout */ BasicContextGraph &other)
+{
+	using std::swap;
+
+	swap(m_bAllowDuplicateEdges, other.m_bAllowDuplicateEdges);
+	swap(m_bFixedExpireTime, other.m_bFixedExpireTime);
+	swap(m_bFixedValidityInterval, other.m_bFixedValidityInterval);
+	swap(m_bQuickMatch, other.m_bQuickMatch);
+	swap(m_bFrozen, other.m_bFrozen);
+	swap(m_bAdjacencyIndexComplete, other.m_bAdjacencyIndexComplete);
+	swap(m_bPathsComplete, other.m_bPathsComplete);
+	swap(m_graph, other.m_graph);
+	swap(m_tGraph, other.m_tGraph);
+	m_edges.Swap(other.m_edges);
+	swap(m_edgesByLabel, other.m_edgesByLabel);
+	swap(m_edgesByLabelAndSource, other.m_edgesByLabelAndSource);
+	swap(m_edgesByLabelAndDestination, other.m_edgesByLabelAndDestination);
+	swap(m_edgesByKey, other.m_edgesByKey);
+	m_nodes.Swap(other.m_nodes);
+	swap(m_nodeIndex, other.m_nodeIndex);
+	swap(m_archive, other.m_archive);
+	swap(m_matrix, other.m_matrix);
+	swap(m_adjacency, other.m_adjacency);
+	swap(m_expirations, other.m_expirations);
+	swap(m_validity, other.m_validity);
+	swap(m_pathMatrix, other.m_pathMatrix);
+	swap(m_pathSources, other.m_pathSources);
+	swap(m_pathsByArc, other.m_pathsByArc);
+	swap(m_reachability, other.m_reachability);
+	swap(m_labelIndex, other.m_labelIndex);
+	swap(m_labelDictionary, other.m_labelDictionary);
+	swap(m_generation, other.m_generation);
+	swap(m_regexCache, other.m_regexCache);
+	swap(m_valability, other.m_valability);
+	swap(m_validityInterval, other.m_validityInterval);
+	swap(m_frozen, other.m_frozen);
+}
+
+template <typename Policy>
+void BasicContextGraph<Policy>::Freeze(void)
+{
+	m_frozen.Build(m_nodes, m_edges);
+	m_bFrozen = true;
 }
 
-const CEdge * ContextGraph::FindEdge(/* in */ const std::wstring &strLabel, /* in */ const CNode &source, /* in */ const CNode &destiation) const
+template <typename Policy>
+void BasicContextGraph<Policy>::_CopyFrom(/* in */ const BasicContextGraph &other)
 {
-	auto edges = GetEdgesByName(strLabel);
-	for (auto &&it = edges.first; it != edges.second; it++)
+	m_bAllowDuplicateEdges = other.m_bAllowDuplicateEdges;
+	m_bFixedExpireTime = other.m_bFixedExpireTime;
+	m_bFixedValidityInterval = other.m_bFixedValidityInterval;
+	m_bQuickMatch = other.m_bQuickMatch;
+	m_bAdjacencyIndexComplete = other.m_bAdjacencyIndexComplete;
+	m_valability = other.m_valability;
+	m_validityInterval = other.m_validityInterval;
+
+	//the pools keep the slots, so every record is remapped through its index
+	m_nodes = other.m_nodes;
+	m_edges = other.m_edges;
+	m_archive = other.m_archive;
+	m_adjacency = other.m_adjacency;
+	m_expirations = other.m_expirations;
+	m_validity = other.m_validity;
+
+	//nodes the other graph doesn't store (edges added with outside nodes) are shared, like in the other graph
+	auto fnNode = [&] (/* in */ const CNode *node) -> const CNode *
+	{
+		auto index = node->GetIndex();
+		if (other.m_nodes.IsLive(index) && &other.m_nodes[index] == node)
+			return &m_nodes[index];
+		return node;
+	};
+	auto fnEdge = [&] (/* in */ const CEdge *edge) -> const CEdge * { return &m_edges[edge->GetIndex()]; };
+	auto fnEdges = [&] (/* inout */ AdjacentEdges &edges)
+	{
+		for (auto &edge : edges)
+			edge = fnEdge(edge);
+	};
+
+	for (SlotIndex index = 0; index < m_edges.GetEndIndex(); index++)
+	{
+		if (!m_edges.IsLive(index))
+			continue;
+		auto &edge = m_edges[index];
+		edge.SetNodes(*fnNode(&edge.GetSource()), *fnNode(&edge.GetDestination()));
+	}
+
+	m_nodeIndex.reserve(other.m_nodeIndex.size());
+	for (auto &node : other.m_nodeIndex)
+		m_nodeIndex.emplace(node.first, fnNode(node.second));
+
+	m_graph.reserve(other.m_graph.size());
+	for (auto &child : other.m_graph)
+		m_graph.emplace(child.first, fnEdge(child.second));
+	m_tGraph.reserve(other.m_tGraph.size());
+	for (auto &parent : other.m_tGraph)
+		m_tGraph.emplace(parent.first, fnEdge(parent.second));
+
+	m_edgesByLabel = other.m_edgesByLabel;
+	for (auto &bucket : m_edgesByLabel)
+		fnEdges(bucket.second);
+	m_edgesByLabelAndSource = other.m_edgesByLabelAndSource;
+	for (auto &bucket : m_edgesByLabelAndSource)
+		fnEdges(bucket.second);
+	m_edgesByLabelAndDestination = other.m_edgesByLabelAndDestination;
+	for (auto &bucket : m_edgesByLabelAndDestination)
+		fnEdges(bucket.second);
+	m_edgesByKey = other.m_edgesByKey;
+	for (auto &bucket : m_edgesByKey)
+		fnEdges(bucket.second);
+
+	m_matrix = other.m_matrix;
+	for (auto &row : m_matrix)
+		for (auto &cell : row.second)
+			fnEdges(cell.second);
+
+	for (auto &row : other.m_pathMatrix)
 	{
-		if (it->FullEqual(strLabel, source, destiation))
+		auto &newRow = m_pathMatrix[row.first];
+		for (auto &cell : row.second)
 		{
-			return &*it;
+			Paths paths(cell.second.key_comp());
+			for (auto path : cell.second)
+			{
+				for (auto &node : path)
+					node = fnNode(node);
+				paths.emplace_hint(paths.cend(), std::move(path));
+			}
+			newRow.emplace(cell.first, std::move(paths));
 		}
 	}
 
-	return nullptr;
+	m_pathSources = other.m_pathSources;
+	m_pathsByArc = other.m_pathsByArc;
+	m_reachability = other.m_reachability;
+	m_labelIndex = other.m_labelIndex;
+	m_labelDictionary = other.m_labelDictionary;
+	m_bPathsComplete = other.m_bPathsComplete;
+
+	m_generation = other.m_generation;
+	m_regexCache.Clear();
+	m_regexCache.SetCapacity(other.m_regexCache.GetCapacity());
+	if (other.m_regexCache.GetGeneration() == other.m_generation)
+	{
+		m_regexCache.SetGeneration(m_generation);
+		other.m_regexCache.ForEach([&] (const std::wstring &regex, const CNode *source, const CNode *destination, AdjacentEdges path)
+		{
+			fnEdges(path);
+			m_regexCache.Insert(m_generation, regex, fnNode(source), fnNode(destination), std::move(path));
+		});
+	}
+
+	if (other.m_bFrozen)
+		Freeze();
+}
+
+template <typename Policy>
+auto BasicContextGraph<Policy>::_CanonicalNode(/* in */ const CNode &node) const -> const CNode &
+{
+	auto index = node.GetIndex();
+	if (m_nodes.IsLive(index) && &m_nodes[index] == &node)
+		return node;
+
+	auto found = m_nodeIndex.find(node.GetLabelId());
+	if (found != m_nodeIndex.cend())
+		return *found->second;
+
+	//only known by the archived edges
+	auto archived = m_archive.FindNode(node);
+	return archived ? *archived : node;
+}
+
+template <typename Policy>
+void BasicContextGraph<Policy>::_Thaw(void)
+{
+	//every change goes through here
+	m_generation++;
+	if (!m_bFrozen)
+		return;
+
+	m_bFrozen = false;
+	m_frozen.Clear();
+}
+
+template <typename Policy>
+auto BasicContextGraph<Policy>::FindEdge(/* in */ const Label &strLabel, /* in */ const CNode &source, /* in */ const CNode &destiation) const -> const CEdge *
+{
+	LabelId id;
+	if (!Policy::Find(strLabel, id))
+		return nullptr;
+
+	return FindEdge(CEdge(strLabel, source, destiation));
+}
+
+template <typename Policy>
+auto BasicContextGraph<Policy>::FindEdge(/* in */ const CEdge &edge) const -> const CEdge *
+{
+	auto edges = GetEdgesBetween(edge.GetLabelId(), edge.GetSource(), edge.GetDestination());
+	if (edges.first == edges.second)
+		return nullptr;
+
+	return *edges.first;
 }
 
-std::vector<const CNode *> ContextGraph::FindNodesMatchingNodeName(/* in */ const CNode &node) const
+template <typename Policy>
+auto BasicContextGraph<Policy>::FindNodesMatchingNodeName(/* in */ const CNode &node) const -> std::vector<const CNode *>
 {
-	const auto label = node.GetLabel();
 	std::vector<const CNode *> foundNodes;
 	if (!node.IsRegex())
 	{
 		const CNode *foundNode = nullptr;
-		bool bFound = FindNodeByName(label, foundNode);
+		bool bFound = FindNodeById(node.GetLabelId(), foundNode);
 		if (bFound)
 		{
 			foundNodes.emplace_back(foundNode);
@@ -1005,35 +2094,48 @@ std::vector<const CNode *> ContextGraph::FindNodesMatchingNodeName(/* in */ cons
 	}
 	else
 	{
-		boost::wregex regex(label);
-		auto found = std::find_if(m_nodes.cbegin(), m_nodes.cend(), [&] (const CNode &n) { return _IsRegexMatch(regex, n.GetLabel()); });
-		while (found != m_nodes.cend())
+		std::vector<SlotIndex> candidates;
+		if (m_labelIndex.FindCandidates(node.GetLabel(), candidates))
 		{
-			foundNodes.emplace_back(&*found);
-			found = std::find_if(++found, m_nodes.cend(), [&] (const CNode &n) { return _IsRegexMatch(regex, n.GetLabel()); });
+			auto regex = CompiledRegexCache::Instance().Get(node.GetLabel());
+			for (auto slot : candidates)
+				if (m_nodes.IsLive(slot) && _IsRegexMatch(*regex, m_nodes[slot].GetLabel()))
+					foundNodes.emplace_back(&m_nodes[slot]);
+			return foundNodes;
 		}
+
+		//the dictionary runs the regex on the labels it hasn't seen it against yet, in slot order like a scan
+		auto labels = m_labelDictionary.Match(node.GetLabel());
+		m_labelDictionary.ForEach(*labels, [&] (LabelId id)
+		{
+			const CNode *found = nullptr;
+			if (FindNodeById(id, found))
+				foundNodes.emplace_back(found);
+		});
+		std::sort(foundNodes.begin(), foundNodes.end(), [] (const CNode *l, const CNode *r) { return l->GetIndex() < r->GetIndex(); });
 	}
 
 	return foundNodes;
 }
 
+template <typename Policy>
 template <typename CM, typename CE>
-std::set<const CNode *> ContextGraph::GetNeighbours(/* in */ const CNode &node, /* in_opt */ const CM &memberNodes, /* in_opt */ const CE &excludedNodes) const
+auto BasicContextGraph<Policy>::GetNeighbours(/* in */ const CNode &node, /* in_opt */ const CM &memberNodes, /* in_opt */ const CE &excludedNodes) const -> std::set<const CNode *>
 {
 	std::set<const CNode *> neighs;
-	auto children = GetChildren(node);
-	auto parents = GetParents(node);
 
 	auto hint = neighs.cbegin();
-	for (auto child = children.first; child != children.second; child++)
+	_ForEachChild(node, [&] (const CEdge *child) -> bool
 	{
-		hint = neighs.emplace_hint(hint, &child->second->GetDestination());
-	}
+		hint = neighs.emplace_hint(hint, &child->GetDestination());
+		return true;
+	});
 
-	for (auto parent = parents.first; parent != parents.second; parent++)
+	_ForEachParent(node, [&] (const CEdge *parent) -> bool
 	{
-		hint = neighs.emplace_hint(hint, &parent->second->GetSource());
-	}
+		hint = neighs.emplace_hint(hint, &parent->GetSource());
+		return true;
+	});
 
 	auto sameNodeNeighbour = std::find(neighs.cbegin(), neighs.cend(), &node);
 	if (sameNodeNeighbour != neighs.cend())
@@ -1049,7 +2151,8 @@ std::set<const CNode *> ContextGraph::GetNeighbours(/* in */ const CNode &node,
 	return filteredNeighs;
 }
 
-std::vector<const CEdge *> ContextGraph::_FindRandomSpanningTree(/* in */ const std::vector<const CNode *> &nodes) const
+template <typename Policy>
+auto BasicContextGraph<Policy>::_FindRandomSpanningTree(/* in */ const std::vector<const CNode *> &nodes) const -> std::vector<const CEdge *>
 {
 	std::vector<const CEdge *> spanningTree;
 	std::set<const CNode *> visited;
@@ -1071,11 +2174,11 @@ std::vector<const CEdge *> ContextGraph::_FindRandomSpanningTree(/* in */ const
 			if (visited.find(newNode) != visited.cend())
 				continue;
 
-			IContextGraph::AdjacentEdges edgesDirected, edgesReverted;
+			AdjacentEdges edgesDirected, edgesReverted;
 			if (IsAdjacent(*currentNode, *newNode))
-				edgesDirected = m_matrix.at(*currentNode).at(*newNode);
+				edgesDirected = m_matrix.at(currentNode->GetLabelId()).at(newNode->GetLabelId());
 			if (IsAdjacent(*newNode, *currentNode))
-				edgesReverted = m_matrix.at(*newNode).at(*currentNode);
+				edgesReverted = m_matrix.at(newNode->GetLabelId()).at(currentNode->GetLabelId());
 
 			edgesDirected.resize(edgesDirected.size() + edgesReverted.size());
 			std::move_backward(edgesReverted.cbegin(), edgesReverted.cend(), edgesDirected.end());
@@ -1097,10 +2200,11 @@ std::vector<const CEdge *> ContextGraph::_FindRandomSpanningTree(/* in */ const
 	return spanningTree;
 }
 
-ContextGraph ContextGraph::GenerateRandomSubgraph(/* in_opt */ unsigned int nodesPercent,
+template <typename Policy>
+auto BasicContextGraph<Policy>::GenerateRandomSubgraph(/* in_opt */ unsigned int nodesPercent,
 												  /* in_opt */ unsigned int edgesPercentOnSubsetOfNodes,
 												  /* in_opt */ unsigned int percentOfUnknownNodes,
-												  /* in_opt */ std::set<std::wstring> mandatoryNodes)
+												  /* in_opt */ std::set<Label> mandatoryNodes) -> BasicContextGraph
 {
 	auto totalNodes = m_nodes.size();
 
@@ -1162,7 +2266,7 @@ ContextGraph ContextGraph::GenerateRandomSubgraph(/* in_opt */ unsigned int node
 			const auto n2 = generatedNodes[j];
 			if (IsAdjacent(*n1, *n2))
 			{
-				auto &edges = m_matrix[*n1][*generatedNodes[j]];
+				auto &edges = m_matrix[n1->GetLabelId()][n2->GetLabelId()];
 				totalSubgraphEdges.insert(totalSubgraphEdges.end(), edges.cbegin(), edges.cend());
 			}
 		}
@@ -1187,20 +2291,20 @@ ContextGraph ContextGraph::GenerateRandomSubgraph(/* in_opt */ unsigned int node
 		totalSubgraphEdges.erase(totalSubgraphEdges.begin() + pickedIndex);
 	}
 
-	ContextGraph cg;
+	BasicContextGraph cg;
 	for (unsigned int i = 0; i < spanningTree.size(); i++)
 	{
 		auto edge = spanningTree[i];
-		cg.AddEdge(edge->GetLabel(), edge->GetSource().GetLabel(), edge->GetDestination().GetLabel());
+		cg.AddEdge(edge->CopyWithNodes(edge->GetSource(), edge->GetDestination()));
 	}
 
 	cg.ConvertNodesToUnknown(percentOfUnknownNodes);
 
-	//drop move constructor to keep pointers integrity
 	return cg;
 }
 
-void ContextGraph::ConvertNodesToUnknown(/* in */ unsigned int percentOfNodes)
+template <typename Policy>
+void BasicContextGraph<Policy>::ConvertNodesToUnknown(/* in */ unsigned int percentOfNodes)
 {
 	auto totalNodes = m_nodes.size();
 	auto unknownNodes = percentOfNodes * totalNodes / 100;
@@ -1218,44 +2322,61 @@ void ContextGraph::ConvertNodesToUnknown(/* in */ unsigned int percentOfNodes)
 	{
 		std::wstring label = L"?";
 		label += std::to_wstring(i);
-		ReplaceNode(nodes[i]->GetLabel(), label);
+		_ReplaceNode(*nodes[i], CNode::FromText(label));
 	}
 }
 
-void ContextGraph::RemoveNode(/* in */ const std::wstring &node)
+template <typename Policy>
+void BasicContextGraph<Policy>::RemoveNode(/* in */ const Label &node)
 {
-	m_graph.erase(node);
-	m_tGraph.erase(node);
+	LabelId id;
+	if (!Policy::Find(node, id))
+		return;
 
-	std::function<bool(T::const_iterator)> deleteConditionFn = [&node] (T::const_iterator it) { return it->second->GetSource() == node || it->second->GetDestination() == node; };
-	_DeleteFromContainer(m_graph, deleteConditionFn);
-	_DeleteFromContainer(m_tGraph, deleteConditionFn);
+	const CNode *removed = nullptr;
+	if (!FindNodeById(id, removed))
+		return;
 
-	m_matrix.erase(node);
-	for (auto &&it : m_matrix)
+	_Thaw();
+
+	//only the incident edges are touched; a loop is both a child and a parent
+	std::vector<const CEdge *> incident;
+	_ForEachChild(*removed, [&] (const CEdge *edge) -> bool { incident.emplace_back(edge); return true; });
+	_ForEachParent(*removed, [&] (const CEdge *edge) -> bool
 	{
-		auto row = it.second;
-		row.erase(node);
-	}
+		if (edge->GetSource().GetLabelId() != id)
+			incident.emplace_back(edge);
+		return true;
+	});
 
-	m_pathMatrix.clear();
+	_UnlinkEdges(incident);
+	for (auto edge : incident)
+		_ReleaseEdge(*edge);
 
-        std::function<bool(TE::const_iterator)> fnDeleteCondition = [&node] (TE::const_iterator it) { return it->GetDestination() == node || it->GetSource() == node; };
-	_DeleteFromContainer(m_edges, fnDeleteCondition);
-	
-	m_nodes.erase(node);
+	//the paths through the node went with its arcs, the ones that start or end there go with it
+	_ReleaseNode(*removed);
 }
 
-void ContextGraph::ReplaceNode(/* in */ const std::wstring &oldNode, /* in */ const std::wstring newNode)
+template <typename Policy>
+void BasicContextGraph<Policy>::ReplaceNode(/* in */ const Label &oldNode, /* in */ const Label newNode)
 {
-	auto found = m_nodes.find(oldNode);
-	if (found == m_nodes.end())
+	const CNode *oldAddress = nullptr;
+	if (!FindNodeByName(oldNode, oldAddress))
 		return;
 
-	auto oldAddress = &*found;
-	auto newAddress = &*m_nodes.emplace(newNode).first;
+	_ReplaceNode(*oldAddress, CNode(newNode));
+}
+
+template <typename Policy>
+void BasicContextGraph<Policy>::_ReplaceNode(/* in */ const CNode &oldNode, /* in */ const CNode &newNode)
+{
+	_Thaw();
+	m_reachability.Clear();
+
+	auto oldAddress = &oldNode;
+	auto newAddress = &_StoreNode(newNode);
 
-	std::function<bool(T::const_iterator)> deleteConditionFn = [&oldNode] (T::const_iterator it) { return it->second->GetSource() == oldNode || it->second->GetDestination() == oldNode; };
+	std::function<bool(typename T::const_iterator)> deleteConditionFn = [oldAddress] (typename T::const_iterator it) { return it->second->GetSource() == *oldAddress || it->second->GetDestination() == *oldAddress; };
 	_DeleteFromContainer(m_graph, deleteConditionFn);
 	_DeleteFromContainer(m_tGraph, deleteConditionFn);
 
@@ -1279,99 +2400,216 @@ void ContextGraph::ReplaceNode(/* in */ const std::wstring &oldNode, /* in */ co
 
 		if (bDelete)
 		{
+			_RemoveEdgeFromAdjacencyMatrix(it);
+			_UnindexEdgeEndpoints(it);
+			m_labelDictionary.Remove(it.GetSource().GetLabelId());
+			m_labelDictionary.Remove(it.GetDestination().GetLabelId());
+			m_labelDictionary.Add(source->GetLabelId(), source->GetLabel());
+			m_labelDictionary.Add(dest->GetLabelId(), dest->GetLabel());
 			const_cast<CEdge &>(it).SetNodes(*source, *dest);
-			m_graph.emplace(*source, &it);
-			m_tGraph.emplace(*dest, &it);
+			_IndexEdgeEndpoints(it);
+			_AddEdgeToAdjacencyMatrix(it);
+			m_graph.emplace(source->GetLabelId(), &it);
+			m_tGraph.emplace(dest->GetLabelId(), &it);
 		}
 	}
 
-	m_nodes.erase(oldNode);
+	_ReleaseNode(*oldAddress);
 }
 
-void ContextGraph::_BeforeEdgeDeletion(/* in */ const CEdge &edge)
+template <typename Policy>
+void BasicContextGraph<Policy>::_ArchiveEdge(/* in */ const CEdge &edge)
 {
-	const auto newSource = m_oldNodes.emplace(edge.GetSource());
-	const auto newDest = m_oldNodes.emplace(edge.GetDestination());
-	CEdge e(edge.GetLabel(), *newSource.first, *newDest.first, NEVER_EXPIRE, edge.GetDuration());
-	m_oldEdges.emplace(e);
+	//an edge that expired is archived at its expiration, a removed one now
+	auto now = std::chrono::system_clock::now();
+	auto expireTime = edge.GetLastExpirationTime();
+	m_archive.Add(edge, expireTime < now ? expireTime : now);
+}
 
-	for (auto it = m_graph.cbegin(); it != m_graph.cend(); it++)
-		if (it->second == &edge)
-		{
-			m_graph.erase(it);
-			break;
-		}
+template <typename Policy>
+void BasicContextGraph<Policy>::_UnlinkEdge(/* in */ const CEdge &edge)
+{
+	auto fnUnlink = [&edge] (/* inout */ T &graph, /* in */ LabelId node)
+	{
+		auto range = graph.equal_range(node);
+		for (auto it = range.first; it != range.second; it++)
+			if (it->second == &edge)
+			{
+				graph.erase(it);
+				break;
+			}
+	};
+	fnUnlink(m_graph, edge.GetSource().GetLabelId());
+	fnUnlink(m_tGraph, edge.GetDestination().GetLabelId());
 
-	for (auto it = m_tGraph.cbegin(); it != m_tGraph.cend(); it++)
-		if (it->second == &edge)
-		{
-			m_tGraph.erase(it);
-			break;
-		}
+	_UnindexEdgeEndpoints(edge);
+	_RemoveEdgeFromAdjacencyMatrix(edge);
+}
+
+template <typename Policy>
+void BasicContextGraph<Policy>::_UnlinkEdges(/* in */ const std::vector<const CEdge *> &edges)
+{
+	//the buckets of a node hold all its edges, sweeping each once keeps k deletions at a hub O(degree + k) instead of O(k * degree)
+	std::unordered_set<const CEdge *> doomed(edges.cbegin(), edges.cend());
+	auto fnDoomed = [&doomed] (/* in */ const CEdge *edge) { return doomed.count(edge) != 0; };
+
+	std::unordered_set<LabelId, typename Policy::Hash> sources, destinations;
+	std::unordered_set<uint64_t> bySource, byDestination;
+	std::unordered_set<EdgeKey, EdgeKeyHash> byKey;
+	for (auto edge : edges)
+	{
+		auto label = edge->GetLabelId();
+		auto source = edge->GetSource().GetLabelId();
+		auto destination = edge->GetDestination().GetLabelId();
+		sources.emplace(source);
+		destinations.emplace(destination);
+		bySource.emplace(MakeLabelNodeKey(label, source));
+		byDestination.emplace(MakeLabelNodeKey(label, destination));
+		byKey.emplace(label, source, destination);
+
+		_RemoveEdgeFromAdjacencyMatrix(*edge);
+	}
 
-	auto &source = edge.GetSource();
-	auto &dest = edge.GetDestination();
+	//erasing one entry of the multimap walks its bucket up to it, so the bucket is rebuilt from its survivors, in their order
+	auto fnUnlink = [&fnDoomed] (/* inout */ T &graph, /* in */ LabelId node)
+	{
+		auto range = graph.equal_range(node);
+		std::vector<const CEdge *> kept;
+		for (auto it = range.first; it != range.second; it++)
+			if (!fnDoomed(it->second))
+				kept.emplace_back(it->second);
+		graph.erase(range.first, range.second);
+
+		auto hint = graph.end();
+		for (auto edge : kept)
+			hint = graph.emplace_hint(hint, node, edge);
+	};
+	for (auto source : sources)
+		fnUnlink(m_graph, source);
+	for (auto destination : destinations)
+		fnUnlink(m_tGraph, destination);
+
+	_EraseAllFromIndex(m_edgesByLabelAndSource, bySource, fnDoomed);
+	_EraseAllFromIndex(m_edgesByLabelAndDestination, byDestination, fnDoomed);
+	_EraseAllFromIndex(m_edgesByKey, byKey, fnDoomed);
+}
 
-	auto &adjacentEdges = m_matrix[source][dest];
-	auto found = std::find(adjacentEdges.begin(), adjacentEdges.end(), &edge);
-	if (found != adjacentEdges.cend())
-		adjacentEdges.erase(found);
+template <typename Policy>
+void BasicContextGraph<Policy>::_ReleaseIfIsolated(/* in */ const CNode &node)
+{
+	auto id = node.GetLabelId();
+	if (m_graph.find(id) != m_graph.cend() || m_tGraph.find(id) != m_tGraph.cend())
+		return;
+
+	_ReleaseNode(node);
+}
 
-	auto removeIfEmptyFn = [this](const CNode &node)
+template <typename Policy>
+void BasicContextGraph<Policy>::_ErasePathsOf(/* in */ LabelId node)
+{
+	auto row = m_pathMatrix.find(node);
+	if (row != m_pathMatrix.end())
 	{
-		auto neigh = GetNeighbours(node);
-		if (neigh.empty())
+		for (auto &cell : row->second)
 		{
-			m_pathMatrix.erase(node);
-			for (auto &it : m_pathMatrix)
-				it.second.erase(node);
-			m_nodes.erase(node);
+			auto sources = m_pathSources.find(cell.first);
+			if (sources != m_pathSources.end())
+				sources->second.erase(node);
 		}
-	};
+		m_pathMatrix.erase(row);
+	}
+
+	auto sources = m_pathSources.find(node);
+	if (sources == m_pathSources.end())
+		return;
+	for (auto source : sources->second)
+	{
+		auto sourceRow = m_pathMatrix.find(source);
+		if (sourceRow != m_pathMatrix.end())
+			sourceRow->second.erase(node);
+	}
+	m_pathSources.erase(sources);
+}
 
-	removeIfEmptyFn(source);
-	removeIfEmptyFn(dest);
+template <typename Policy>
+void BasicContextGraph<Policy>::_ReleaseIsolatedNodes(/* inout */ std::vector<const CNode *> &nodes)
+{
+	std::sort(nodes.begin(), nodes.end());
+	nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+	for (auto node : nodes)
+		_ReleaseIfIsolated(*node);
 }
 
-void ContextGraph::_DeleteEdge(/* in */ const CEdge &edge)
+template <typename Policy>
+void BasicContextGraph<Policy>::_DeleteEdge(/* in */ const CEdge &edge)
 {
-	_BeforeEdgeDeletion(edge);
+	_Thaw();
+	_ArchiveEdge(edge);
+	_UnlinkEdge(edge);
+
+	//the edge goes before its endpoints, releasing it still reads them
+	std::vector<const CNode *> endpoints = { &edge.GetSource(), &edge.GetDestination() };
+	_ReleaseEdge(edge);
+	_ReleaseIsolatedNodes(endpoints);
+}
 
-	for (auto e = m_edges.cbegin(); e != m_edges.cend(); e++)
-		if (&*e == &edge)
-		{
-			m_edges.erase(e);
-			break;
-		}
+template <typename Policy>
+void BasicContextGraph<Policy>::RefreshGraphConsistency(void)
+{
+	EvictExpired();
+}
+
+template <typename Policy>
+bool BasicContextGraph<Policy>::_IsCurrentExpiration(/* in */ const typename ExpirationIndex::Entry &entry) const
+{
+	//an entry is stale once its edge is gone (its slot may hold another by now) or got a later expiration (which pushed its own entry)
+	return m_expirations.IsCurrentGeneration(entry) && m_edges.IsLive(entry.slot) && m_edges[entry.slot].GetLastExpirationTime() == entry.expireTime;
 }
 
-void ContextGraph::RefreshGraphConsistency(void)
+template <typename Policy>
+size_t BasicContextGraph<Policy>::EvictExpired(/* in */ std::chrono::system_clock::time_point now)
 {
-        std::function<bool(TE::const_iterator)> fnDeleter = [this](TE::const_iterator it) 
+	//the whole batch is deleted at the end, so an edge with two due entries has to be collected once
+	std::vector<const CEdge *> expired;
+	std::unordered_set<SlotIndex> collected;
+	while (!m_expirations.empty() && m_expirations.Top().expireTime < now)
 	{
-		const_cast<CEdge *>(&*it)->RefreshExpiration();
-		if (it->IsExpired())
-		{
-			_BeforeEdgeDeletion(*it);
-			return true;
-		}
-		
-		return false;
-	};
-	_DeleteFromContainer(m_edges, fnDeleter);
+		auto entry = m_expirations.Top();
+		m_expirations.Pop();
+		if (!_IsCurrentExpiration(entry) || !collected.emplace(entry.slot).second)
+			continue;
+
+		auto &edge = m_edges[entry.slot];
+		edge.RefreshExpiration();
+		expired.emplace_back(&edge);
+	}
+
+	DeleteEdges(expired.cbegin(), expired.cend());
+	m_archive.ApplyRetention(now);
+	return expired.size();
+}
+
+template <typename Policy>
+std::chrono::system_clock::time_point BasicContextGraph<Policy>::GetNextExpirationTime(void)
+{
+	while (!m_expirations.empty() && !_IsCurrentExpiration(m_expirations.Top()))
+		m_expirations.Pop();
+
+	return m_expirations.empty() ? NEVER_EXPIRE : m_expirations.Top().expireTime;
 }
 
-std::vector<ContextGraph> ContextGraph::GetMaximumMatchGraphs(/* in */ const ContextGraph &patternGraph, bool bRealTime, bool bMatchInThePast)
+template <typename Policy>
+auto BasicContextGraph<Policy>::GetMaximumMatchGraphs(/* in */ const BasicContextGraph &patternGraph, bool bRealTime, bool bMatchInThePast) -> std::vector<BasicContextGraph>
 {
-	std::vector<ContextGraph> solutions;
+	std::vector<BasicContextGraph> solutions;
 	auto match = GetMaximumMatch(patternGraph, bRealTime, bMatchInThePast);
 
 	for (auto &solution : match)
 	{
-		ContextGraph graph;
+		BasicContextGraph graph;
 		for (const auto &edge : solution)
 		{
-			graph.AddEdge(edge->GetLabel(), edge->GetSource().GetLabel(), edge->GetDestination().GetLabel(), edge->GetFirstExpirationTime(), edge->GetDuration());
+			graph.AddEdge(edge->CopyWithNodes(edge->GetSource(), edge->GetDestination(), edge->GetFirstExpirationTime(), edge->GetDuration()));
 		}
 
 		solutions.emplace_back(graph);
@@ -1380,23 +2618,34 @@ std::vector<ContextGraph> ContextGraph::GetMaximumMatchGraphs(/* in */ const Con
 	return solutions;
 }
 
-void ContextGraph::PrecomputeRoadsBetweenPairOfNodes(void)
+template <typename Policy>
+void BasicContextGraph<Policy>::PrecomputeRoadsBetweenPairOfNodes(/* in_opt */ unsigned int threads)
 {
-	for (auto row : m_matrix)
+	typedef typename Paths::key_type Road;
+
+	//query memos are replaced by the full set, which the graph updates from now on
+	_ClearPaths();
+
+	//the arcs by source row; the matrix doesn't change while the roads are computed
+	std::vector<std::vector<std::pair<const CNode *, const CNode *>>> rows;
+	for (const auto &row : m_matrix)
 	{
-		for (auto cell : row.second)
+		rows.emplace_back();
+		for (const auto &cell : row.second)
 		{
 			auto etalonEdge = cell.second.front();
 			auto &source = etalonEdge->GetSource();
 			auto &destination = etalonEdge->GetDestination();
-			Paths::key_type path;
+			rows.back().emplace_back(&source, &destination);
+
+			Road path;
 			path.emplace_back(&source);
 			path.emplace_back(&destination);
 			_AddSingleUniquePathToCache(source, destination, path);
 		}
 	}
 
-	auto fnDetectSameCiclicRoad = [&](Paths::key_type v) -> bool
+	auto fnDetectSameCiclicRoad = [&](const Road &v) -> bool
 	{
 		for (size_t i = 2; i < v.size() - 1; i++)
 			if (v[i] == v[0] && v[i + 1] == v[1])
@@ -1405,51 +2654,82 @@ void ContextGraph::PrecomputeRoadsBetweenPairOfNodes(void)
 		return false;
 	};
 
-	bool bAddedNew = true;
-	unsigned int currentSize = 2;
-	while (bAddedNew)
+	//a round only reads the roads of currentSize nodes and only makes longer ones, so the rows are extended side by side
+	//into buffers of their own, which go to the cache afterwards in row order, the order a single thread adds them in
+	std::vector<std::vector<Road>> newRoads(rows.size());
+	auto fnExtendRow = [&] (size_t i, size_t currentSize)
 	{
-		bAddedNew = false;
-
-		for (auto row : m_matrix)
+		//the paths are ordered by size only, this finds those of currentSize
+		Road probe(currentSize);
+		for (auto &arc : rows[i])
 		{
-			for (auto cell : row.second)
-			{
-				auto etalonEdge = cell.second.front();
-				auto &source = etalonEdge->GetSource();
-				auto &destination = etalonEdge->GetDestination();
+			auto &source = *arc.first;
+			auto &destination = *arc.second;
+			auto rowFound = m_pathMatrix.find(destination.GetLabelId());
+			if (rowFound == m_pathMatrix.cend())
+				continue;
 
-				auto rowFound = m_pathMatrix.find(destination);
-				if (rowFound != m_pathMatrix.cend())
+			for (const auto &end : rowFound->second)
+			{
+				auto range = end.second.equal_range(probe);
+				for (auto path = range.first; path != range.second; ++path)
 				{
-					for (auto end : rowFound->second)
-					{
-						auto &paths = end.second;
-						for (auto path : paths)
-						{
-							if (path.size() == currentSize && (source != destination || destination != *path[1]))
-							{
-								Paths::key_type newPath;
-								newPath.emplace_back(&source);
-								std::copy(path.cbegin(), path.cend(), std::back_inserter(newPath));
-
-								if (!fnDetectSameCiclicRoad(newPath))
-								{
-									_AddSingleUniquePathToCache(source, *newPath.back(), newPath);
-									bAddedNew = true;
-								}
-							}
-						}
-					}
+					if (source == destination && destination == *(*path)[1])
+						continue;
+
+					Road newPath;
+					newPath.reserve(currentSize + 1);
+					newPath.emplace_back(&source);
+					newPath.insert(newPath.end(), path->cbegin(), path->cend());
+					if (!fnDetectSameCiclicRoad(newPath))
+						newRoads[i].emplace_back(std::move(newPath));
 				}
 			}
 		}
+	};
+
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = static_cast<unsigned int>(std::min<size_t>(threads, rows.size()));
+
+	bool bAddedNew = true;
+	for (size_t currentSize = 2; bAddedNew; currentSize++)
+	{
+		if (threads <= 1)
+		{
+			for (size_t i = 0; i < rows.size(); i++)
+				fnExtendRow(i, currentSize);
+		}
+		else
+		{
+			//rows are handed out one at a time, a few long rows don't hold a whole share back
+			std::atomic<size_t> nextRow(0);
+			std::vector<std::thread> workers;
+			for (unsigned int worker = 0; worker < threads; worker++)
+				workers.emplace_back([&]
+				{
+					for (size_t i = nextRow++; i < rows.size(); i = nextRow++)
+						fnExtendRow(i, currentSize);
+				});
+			for (auto &worker : workers)
+				worker.join();
+		}
 
-		currentSize++;
+		bAddedNew = false;
+		for (auto &roads : newRoads)
+		{
+			for (auto &road : roads)
+				_AddSingleUniquePathToCache(*road.front(), *road.back(), road);
+			bAddedNew = bAddedNew || !roads.empty();
+			roads.clear();
+		}
 	}
+
+	m_bPathsComplete = true;
 }
 
-std::wstring ContextGraph::SerializeGraph(void) const
+template <typename Policy>
+std::wstring BasicContextGraph<Policy>::SerializeGraph(void) const
 {
 	std::wstring strGraph;
 	for (auto &edge : m_edges)
@@ -1461,29 +2741,21 @@ std::wstring ContextGraph::SerializeGraph(void) const
 	return strGraph;
 }
 
-bool ContextGraph::IsIncludedIn(/* in */ const ContextGraph &bigGraph) const
+template <typename Policy>
+bool BasicContextGraph<Policy>::IsIncludedIn(/* in */ const BasicContextGraph &bigGraph) const
 {
 	for (auto &edge : m_edges)
 	{
-		const auto &sameNameEdges = bigGraph.GetEdgesByName(edge.GetLabel());
-		bool bFound = false;
-		for (auto it = sameNameEdges.first; it != sameNameEdges.second; it++)
-		{
-			if (edge.FullEqual(*it))
-			{
-				bFound = true;
-				break;
-			}
-		}
-
-		if (!bFound)
+		const auto &sameEdges = bigGraph.GetEdgesBetween(edge.GetLabelId(), edge.GetSource(), edge.GetDestination());
+		if (sameEdges.first == sameEdges.second)
 			return false;
 	}
 
 	return true;
 }
 
-std::wstring ContextGraph::GetEdgeTextRepresentation(void) const
+template <typename Policy>
+std::wstring BasicContextGraph<Policy>::GetEdgeTextRepresentation(void) const
 {
 	std::wstring hash;
 	for (auto &&edge : m_edges)
@@ -1494,3 +2766,6 @@ std::wstring ContextGraph::GetEdgeTextRepresentation(void) const
 
 	return hash;
 }
+
+template class BasicContextGraph<WStringLabelPolicy>;
+template class BasicContextGraph<IntegerLabelPolicy>;
@@ -3,62 +3,149 @@
 #include "Node.h"
 #include "Edge.h"
 #include <boost/regex.hpp>
+#include "CompiledRegexCache.h"
 #include "IContextGraph.h"
+#include "AdjacencyIndex.h"
+#include "EdgeFilter.h"
+#include "ExpirationIndex.h"
+#include "TemporalArchive.h"
+#include "IntervalIndex.h"
+#include "RegexAutomaton.h"
+#include "PathEnumerator.h"
+#include "ReachabilityIndex.h"
+#include "NodeLabelIndex.h"
+#include "GraphLabelDictionary.h"
+#include "MatchState.h"
+#include "WorkStealingPool.h"
+#include "NodeBitset.h"
+#include "FrozenContextGraph.h"
 
-class ContextGraph : public IContextGraph
+//the policy picks the label carried by nodes and edges (see LabelPolicy.h); ContextGraph is the wstring labelled graph
+template <typename Policy>
+class BasicContextGraph : public BasicIContextGraph<Policy>
 {
 public:
-	ContextGraph() : 
+	//these hide the wstring CNode/CEdge, so the graph works on the records of its own policy
+	typedef BasicIContextGraph<Policy> Base;
+	typedef typename Policy::Label Label;
+	typedef typename Base::CNode CNode;
+	typedef typename Base::CEdge CEdge;
+	typedef typename Base::T T;
+	typedef typename Base::TE TE;
+	typedef typename Base::NodeStore NodeStore;
+	typedef typename Base::TN TN;
+	typedef typename Base::NodeIndex NodeIndex;
+	typedef typename Base::AdjacentEdges AdjacentEdges;
+	typedef typename Base::EdgesByLabel EdgesByLabel;
+	typedef typename Base::EdgesByLabelAndNode EdgesByLabelAndNode;
+	typedef typename Base::EdgesByKey EdgesByKey;
+	typedef typename Base::EdgeRange EdgeRange;
+	typedef typename Base::Row Row;
+	typedef typename Base::AdjacentMatrix AdjacentMatrix;
+	typedef typename Base::RegexCache RegexCache;
+	typedef typename Base::Paths Paths;
+	typedef typename Base::PointerEdgePaths PointerEdgePaths;
+	typedef typename Base::PathsRow PathsRow;
+	typedef typename Base::AccessibilityMatrix AccessibilityMatrix;
+	typedef BasicFrozenContextGraph<Policy> Frozen;
+	typedef BasicTemporalArchive<Policy> Archive;
+	typedef BasicPathEnumerator<BasicContextGraph> PathEnumerator;
+	typedef BasicMatchState<BasicContextGraph> MatchState;
+
+public:
+	BasicContextGraph() : 
 		m_bAllowDuplicateEdges(true),
 		m_bFixedExpireTime(false),
 		m_bFixedValidityInterval(false),
 		m_bQuickMatch(false),
-		m_graph(10, [] (const CNode &node) { return std::hash<std::wstring>()(node.GetLabel()); }),
-		m_tGraph(10, [] (const CNode &node) { return std::hash<std::wstring>()(node.GetLabel()); }),
-                m_edges(10, [] (const CEdge &edge) { return std::hash<std::wstring>()(edge.GetLabel()); }),
-		m_nodes(10, [] (const CNode &node) { return std::hash<std::wstring>()(node.GetLabel()); }),
-		m_oldEdges(10, [] (const CEdge &edge) { return std::hash<std::wstring>()(edge.GetLabel()); }),
-		m_oldNodes(10, [] (const CNode &node) { return std::hash<std::wstring>()(node.GetLabel()); }),
-		m_matrix(10, [] (const CNode &node) { return std::hash<std::wstring>()(node.GetLabel()); }),
-                m_pathMatrix(10, [] (const CNode &node) { return std::hash<std::wstring>()(node.GetLabel()); }),
+		m_bFrozen(false),
+		m_bAdjacencyIndexComplete(true),
+		m_bPathsComplete(false),
+		m_generation(0),
                 m_valability(NEVER_EXPIRE),
-		m_validityInterval(PERMANENT_DURATION),
-		fakeNodeDeleter([] (const CNode *) { }),
-		fakeEdgeDeleter([] (const CEdge *) { })
+		m_validityInterval(PERMANENT_DURATION)
 	{ }
 
-	ContextGraph operator =(const ContextGraph &other)
+	//the copy clones the storage slot by slot and remaps every internal pointer, expiration data included
+	BasicContextGraph(const BasicContextGraph &other) : BasicContextGraph()
+	{
+		_CopyFrom(other);
+	}
+
+	//records live in slabs and index nodes, so moving keeps every pointer into the graph valid; the moved-from graph is
+	//left empty and ready for use
+	BasicContextGraph(BasicContextGraph &&other) : BasicContextGraph()
 	{
-		ContextGraph cg;
-		for (auto edge : other.m_edges)
-			cg.AddEdge(edge.GetLabel(), edge.GetSource(), edge.GetDestination());
+		Swap(other);
+	}
+
+	BasicContextGraph &operator =(BasicContextGraph &&other)
+	{
+		if (this != &other)
+		{
+			BasicContextGraph moved(std::move(other));
+			Swap(moved);
+		}
 
-		return cg;
+		return *this;
 	}
 
-	ContextGraph(const ContextGraph &other) : ContextGraph()
+	BasicContextGraph &operator =(const BasicContextGraph &other)
 	{
-		for (auto edge : other.m_edges)
-			AddEdge(edge.GetLabel(), edge.GetSource(), edge.GetDestination());
+		if (this != &other)
+		{
+			BasicContextGraph copy(other);
+			*this = std::move(copy);
+		}
+
+		return *this;
 	}
 
+	void Swap(/* inout */ BasicContextGraph &other);
+
 	void AddEdge(/* in */ const CEdge &e);
-	void AddEdge(/* in */ const std::wstring &strLabel,
+	void AddEdge(/* in */ const Label &strLabel,
 				 /* inout */ const CNode &source,
 				 /* inout */ const CNode &destination,
 				 /* in */ std::chrono::system_clock::time_point expireTime = NEVER_EXPIRE, 
 				 /* in */ Duration duration = PERMANENT_DURATION);
-	void AddEdge(/* in */ const std::wstring &strLabel,
-				 /* in */ const std::wstring &strNode1,
-				 /* in */  const std::wstring &strNode2,
+	void AddEdge(/* in */ const Label &strLabel,
+				 /* in */ const Label &strNode1,
+				 /* in */  const Label &strNode2,
 				 /* in */ std::chrono::system_clock::time_point expireTime = NEVER_EXPIRE, 
 				 /* in */ Duration duration = PERMANENT_DURATION);
 	bool GetPathBetweenNodes(/* in */ const CNode &n1, /* in */ const CNode &n2, Paths &solutions) const;
+	//reachability over node slots, see ReachabilityIndex; new edges keep it up to date, removed ones drop it
+	void BuildReachabilityIndex(void);
+	inline bool HasReachabilityIndex(void) const { return m_reachability.IsBuilt(); }
+	//labels by prefix and trigram, so FindNodesMatchingNodeName runs a regex on the candidates only (see NodeLabelIndex);
+	//kept up to date once built
+	void BuildNodeLabelIndex(void) { m_labelIndex.Build(m_nodes); }
+	inline bool HasNodeLabelIndex(void) const { return m_labelIndex.IsBuilt(); }
+	//a path of one edge or more n1 -> n2: a bit probe with the index, a breadth first search without
+	bool IsReachable(/* in */ const CNode &n1, /* in */ const CNode &n2) const;
+	//the fewest edges n1 -> n2, empty if there is no path
+	std::vector<const CEdge *> GetShortestPath(/* in */ const CNode &n1, /* in */ const CNode &n2) const;
+	//the k shortest simple paths n1 -> n2, shortest first
+	std::vector<std::vector<const CEdge *>> GetShortestPaths(/* in */ const CNode &n1, /* in */ const CNode &n2, /* in */ size_t k) const;
+	//streams the simple paths n1 -> n2 (see PathEnumerator) to fn(const std::vector<const CEdge *> &), which returns false to stop;
+	//returns how many paths fn got
+	template <typename Fn>
+	size_t ForEachPathBetweenNodes(/* in */ const CNode &n1, /* in */ const CNode &n2, /* in */ Fn fn, /* in_opt */ PathLimits limits = PathLimits()) const
+	{
+		PathEnumerator paths(*this, limits);
+		paths.Reset(n1, &n2);
+		while (paths.Next())
+			if (!fn(paths.GetEdges()))
+				break;
+
+		return paths.GetPathCount();
+	}
 	void ConvertNodesToUnknown (/* in */ unsigned int percentOfNodes);
 
 	inline const TE & GetEdges(void) const
 	{ return m_edges; }
-	inline const TN & GetNodes(void) const
+	inline const NodeStore & GetNodes(void) const
 	{ return m_nodes; }
 	inline void AllowDuplicateEdges(bool bAllow = true) { m_bAllowDuplicateEdges = bAllow; }
 	inline void SetForcedExpireTime(/* in */ std::chrono::system_clock::time_point expireTime = NEVER_EXPIRE, /* in */ bool bIsFixedTime = false) 
@@ -73,15 +160,32 @@ public:
 	}
 
 	//it is sure that the node exists
-	inline const TN::key_type & GetNodeByName(/* in */ std::wstring name) const
-	{ return *m_nodes.find(name); }
+	inline const CNode & GetNodeByName(/* in */ const Label &name) const
+	{
+		const CNode *node = nullptr;
+		FindNodeByName(name, node);
+		return *node;
+	}
+
+	inline bool FindNodeByName(/* in */ const Label &name, /* out */ const CNode * &foundNode) const
+	{
+		//a label that was never interned can't name any node, so don't intern it just for the lookup
+		LabelId id;
+		if (!Policy::Find(name, id))
+		{
+			foundNode = nullptr;
+			return false;
+		}
+
+		return FindNodeById(id, foundNode);
+	}
 
-	inline bool FindNodeByName(/* in */ std::wstring name, /* out */ const CNode * &foundNode) const
+	inline bool FindNodeById(/* in */ LabelId id, /* out */ const CNode * &foundNode) const
 	{
-		auto found = m_nodes.find(name);
-		if (found != m_nodes.cend())
+		auto found = m_nodeIndex.find(id);
+		if (found != m_nodeIndex.cend())
 		{
-			foundNode = const_cast<CNode *>(&*found);
+			foundNode = found->second;
 			return true;
 		}
 		
@@ -90,28 +194,60 @@ public:
 	}
 	std::vector<const CNode *> FindNodesMatchingNodeName(/* in */ const CNode &node) const;
 	std::wstring SerializeGraph(void) const;
-	bool IsIncludedIn(/* in */ const ContextGraph &bigGraph) const;
-
-	inline auto GetEdgesByName(/* in */ const std::wstring &strLabel) const -> std::pair<TE::const_iterator, TE::const_iterator>
-	{ return m_edges.equal_range(CEdge(strLabel)); }
-	inline auto GetChildren(/* in */ const CNode &node) const -> std::pair<T::const_iterator, T::const_iterator> 
-	{ return m_graph.equal_range(node);	}
-	inline auto GetParents(/* in */ const CNode &node) const -> std::pair<T::const_iterator, T::const_iterator>
-	{ return m_tGraph.equal_range(node); }
+	bool IsIncludedIn(/* in */ const BasicContextGraph &bigGraph) const;
+
+	inline EdgeRange GetEdgesByName(/* in */ const Label &strLabel) const
+	{
+		LabelId id;
+		Policy::Find(strLabel, id);
+		return GetEdgesByLabelId(id);
+	}
+	inline EdgeRange GetEdgesByName(/* in */ const CEdge &edge) const
+	{ return GetEdgesByLabelId(edge.GetLabelId()); }
+	inline EdgeRange GetEdgesByLabelId(/* in */ LabelId id) const
+	{ return _GetRange(m_edgesByLabel, id); }
+	inline EdgeRange GetEdgesByLabelAndSource(/* in */ LabelId label, /* in */ const CNode &source) const
+	{ return _GetRange(m_edgesByLabelAndSource, MakeLabelNodeKey(label, source.GetLabelId())); }
+	inline EdgeRange GetEdgesByLabelAndDestination(/* in */ LabelId label, /* in */ const CNode &destination) const
+	{ return _GetRange(m_edgesByLabelAndDestination, MakeLabelNodeKey(label, destination.GetLabelId())); }
+	//every edge label: source -> destination
+	inline EdgeRange GetEdgesBetween(/* in */ LabelId label, /* in */ const CNode &source, /* in */ const CNode &destination) const
+	{ return _GetRange(m_edgesByKey, EdgeKey(label, source.GetLabelId(), destination.GetLabelId())); }
+	inline auto GetChildren(/* in */ const CNode &node) const -> std::pair<typename T::const_iterator, typename T::const_iterator> 
+	{ return m_graph.equal_range(node.GetLabelId()); }
+	inline auto GetParents(/* in */ const CNode &node) const -> std::pair<typename T::const_iterator, typename T::const_iterator>
+	{ return m_tGraph.equal_range(node.GetLabelId()); }
 	inline const T & GetInstanceGraph(void) const { return m_graph; }
 	inline const T & GetInstanceGraphTransposed(void) const { return m_tGraph; }
 	inline bool IsQuickMatch(void) const { return m_bQuickMatch; }
 	inline void SetQuickMatch(bool bQuickMatch) { m_bQuickMatch = bQuickMatch; }
 
+	//builds a CSR snapshot that traversals use until the next topology change
+	void Freeze(void);
+	inline bool IsFrozen(void) const { return m_bFrozen; }
+	inline const Frozen & GetFrozenGraph(void) const { return m_frozen; }
+
+	//the removed and expired edges, see TemporalArchive and EdgeFilter::SetArchiveWindow
+	inline const Archive & GetArchive(void) const { return m_archive; }
+	//past edges older than maxAge, or beyond maxEdges, are dropped (by whole segments) as the graph evicts
+	inline void SetArchiveRetention(/* in */ std::chrono::system_clock::duration maxAge, /* in */ size_t maxEdges = std::numeric_limits<size_t>::max())
+	{ m_archive.SetRetention(maxAge, maxEdges); }
+
 	std::vector<std::vector<const CEdge *>> ComputeConnexComponents(void) const;
-	const CEdge * FindEdge(/* in */ const std::wstring &strLabel, /* in */ const CNode &source, /* in */ const CNode &destiation) const;
+	const CEdge * FindEdge(/* in */ const Label &strLabel, /* in */ const CNode &source, /* in */ const CNode &destiation) const;
+	const CEdge * FindEdge(/* in */ const CEdge &edge) const;
 
+	//a bit probe on the adjacency index; the matrix is only searched for nodes the graph doesn't store
 	inline bool IsAdjacent(/* in */ const CNode &n1, /* in */ const CNode &n2) const
 	{
-		const auto it1 = m_matrix.find(n1.GetLabel());
+		SlotIndex source, destination;
+		if (m_bAdjacencyIndexComplete && _FindSlot(n1, source) && _FindSlot(n2, destination))
+			return m_adjacency.IsAdjacent(source, destination);
+
+		const auto it1 = m_matrix.find(n1.GetLabelId());
 		if (it1 == m_matrix.cend())
 			return false;
-		const auto it2 = it1->second.find(n2.GetLabel());
+		const auto it2 = it1->second.find(n2.GetLabelId());
 		if (it2 == it1->second.cend())
 			return false;
 		return !it2->second.empty();
@@ -121,20 +257,59 @@ public:
 	inline long long GetTimeLeft(void) const { return std::chrono::duration_cast<Granularity>(m_valability - std::chrono::system_clock::now()).count();	}
 	inline std::chrono::system_clock::time_point GetExpireTime(void) const 	{ return m_valability; }
 	inline Duration GetValidityInterval(void) const { return m_validityInterval; }
+	//fraction of the nodes a row must reach before its adjacency is kept as a bitmap, see AdjacencyIndex
+	inline void SetAdjacencyDensityThreshold(/* in */ double threshold) { m_adjacency.SetDensityThreshold(threshold); }
 
 	void RefreshGraphConsistency(void);
+	//archives and removes a batch of edges (a range of const CEdge *); the nodes left without edges are released once, at the end
+	template <typename Iterator>
+	void DeleteEdges(/* in */ Iterator first, /* in */ Iterator last)
+	{
+		_Thaw();
+
+		std::vector<const CEdge *> edges(first, last);
+		std::vector<const CNode *> endpoints;
+		for (auto edge : edges)
+		{
+			endpoints.emplace_back(&edge->GetSource());
+			endpoints.emplace_back(&edge->GetDestination());
+			_ArchiveEdge(*edge);
+		}
+		_UnlinkEdges(edges);
+		for (auto edge : edges)
+			_ReleaseEdge(*edge);
+
+		_ReleaseIsolatedNodes(endpoints);
+	}
+	//archives the edges expired at now, only the due ones are looked at; returns how many were archived
+	size_t EvictExpired(/* in */ std::chrono::system_clock::time_point now = std::chrono::system_clock::now());
+	//when the next edge is due (NEVER_EXPIRE if none), meant for arming a timer
+	std::chrono::system_clock::time_point GetNextExpirationTime(void);
 
-	std::vector<const CEdge *> FindMaxOriginalPathMatchedByRegex(/* in */ const std::wstring &regex, /* in */ const CNode &source, /* in */ const CNode &destination);
+	//the longest / every trail (no node pair used twice) from source to destination whose concatenated edge labels match regex
+	std::vector<const CEdge *> FindMaxOriginalPathMatchedByRegex(/* in */ const std::wstring &regex,
+																 /* in */ const CNode &source,
+																 /* in */ const CNode &destination,
+																 /* in_opt */ const EdgeFilter &filter = EdgeFilter());
 	PointerEdgePaths FindAllOriginalPathsMatchedByRegex(/* in */ const std::wstring &regex, /* in */ const CNode &source, /* in */ const CNode &destination);
-	std::vector<const CEdge *> GetCorrespondingConcreteEdges(/* in */ const CEdge &edge, /* in */ const TN &unkNodes) const;
+	std::vector<const CEdge *> GetCorrespondingConcreteEdges(/* in */ const CEdge &edge, /* in */ const TN &unkNodes, /* in_opt */ const EdgeFilter &filter = EdgeFilter()) const;
+	//the edges whose duration intersects interval, from the interval index
+	std::vector<const CEdge *> GetEdgesValidDuring(/* in */ Duration interval) const;
 
 	std::set<const CNode *> GetLabeledNodes(void) const;
-	std::set<std::set<const CEdge *>> GetMaximumMatch(/* in */ const ContextGraph &patternGraph, bool bRealTime = false, bool bMatchInThePast = false);
-	std::vector<ContextGraph> GetMaximumMatchGraphs(/* in */ const ContextGraph &patternGraph, bool bRealTime = false, bool bMatchInThePast = false);
+	std::set<std::set<const CEdge *>> GetMaximumMatch(/* in */ const BasicContextGraph &patternGraph, bool bRealTime = false, bool bMatchInThePast = false);
+	//matches only against the edges the filter accepts, without building a filtered copy of the graph
+	//the const overload only reads the graph and the pattern, so any number of threads may match over one graph (and one
+	//pattern) at once while nobody changes them; this one first builds the indexes the pattern profits from
+	//the search tree is split over threads workers (0 for one per core); the result doesn't depend on how many
+	std::set<std::set<const CEdge *>> GetMaximumMatch(/* in */ const BasicContextGraph &patternGraph, /* in */ const EdgeFilter &filter, /* in_opt */ unsigned int threads = 1);
+	std::set<std::set<const CEdge *>> GetMaximumMatch(/* in */ const BasicContextGraph &patternGraph, /* in */ const EdgeFilter &filter, /* in_opt */ unsigned int threads = 1) const;
+	std::vector<BasicContextGraph> GetMaximumMatchGraphs(/* in */ const BasicContextGraph &patternGraph, bool bRealTime = false, bool bMatchInThePast = false);
 	bool BuildFromDotFile(/* in */ const std::wstring &fileName, /* in_opt */ bool bClearPrecedent = false);
 	bool WriteGraphToDotFile(/* in */ const std::wstring &fileName, /* in */ const std::wstring &graphName) const;
 	void Clear(void);
-	void PrecomputeRoadsBetweenPairOfNodes(void);
+	//the rows of the matrix are shared by threads workers (0 for one per core); the result doesn't depend on how many
+	void PrecomputeRoadsBetweenPairOfNodes(/* in_opt */ unsigned int threads = 1);
 	std::wstring GetEdgeTextRepresentation(void) const;
 
 	template <typename ContainerMember, typename ContainerExcl>
@@ -145,13 +320,13 @@ public:
 		return GetNeighbours(node, ContainerMember(), ContainerExcl());
 	}
 
-	void RemoveNode(/* in */ const std::wstring &node);
-	void ReplaceNode(/* in */ const std::wstring &oldNode, /* in */ const std::wstring newNode);
+	void RemoveNode(/* in */ const Label &node);
+	void ReplaceNode(/* in */ const Label &oldNode, /* in */ const Label newNode);
 
-	ContextGraph GenerateRandomSubgraph(/* in_opt */ unsigned int nodesPercent = 50,
+	BasicContextGraph GenerateRandomSubgraph(/* in_opt */ unsigned int nodesPercent = 50,
 										/* in_opt */ unsigned int edgesPercentOnSubsetOfNodes = 50,
 										/* in_opt */ unsigned int percentOfUnknownNodes = 50,
-										/* in_opt */ std::set<std::wstring> mandatoryNodes = std::set<std::wstring>());
+										/* in_opt */ std::set<Label> mandatoryNodes = std::set<Label>());
 
 	inline static bool IntervalIntersection(/* in */ Duration firstInterval, /* in */ Duration secondInterval)
 	{
@@ -164,7 +339,7 @@ public:
 		{
 			for (auto &&it2 : it.second)
 			{
-				std::wcout << "[" << it.first << "->" << it2.first << "] --> ";
+				std::wcout << "[" << m_nodeIndex.at(it.first)->GetLabel() << "->" << m_nodeIndex.at(it2.first)->GetLabel() << "] --> ";
 				for(auto &&it3 : it2.second)
 					std::wcout << it3->GetLabel() << ", ";
 				std::wcout << std::endl;
@@ -174,7 +349,7 @@ public:
 		}
 	}
 
-	friend std::wostream& operator<<(/* in */ std::wostream &stream, /* in */ const ContextGraph &cg)
+	friend std::wostream& operator<<(/* in */ std::wostream &stream, /* in */ const BasicContextGraph &cg)
 	{
 		for(auto &&edge : cg.GetEdges())
 		{
@@ -189,25 +364,53 @@ public:
 	bool m_bFixedExpireTime;
 	bool m_bFixedValidityInterval;
 	bool m_bQuickMatch;
+	bool m_bFrozen;
+	bool m_bAdjacencyIndexComplete;
+	//m_pathMatrix holds every trail (no node pair used twice) since PrecomputeRoadsBetweenPairOfNodes, and is kept so;
+	//otherwise it only memoizes path queries
+	bool m_bPathsComplete;
     
 	T m_graph;
 	T m_tGraph;
 	TE m_edges;
-	TN m_nodes;
-        TE m_oldEdges;
-	TN m_oldNodes;
+	EdgesByLabel m_edgesByLabel;
+	EdgesByLabelAndNode m_edgesByLabelAndSource;
+	EdgesByLabelAndNode m_edgesByLabelAndDestination;
+	EdgesByKey m_edgesByKey;
+	NodeStore m_nodes;
+	NodeIndex m_nodeIndex;
+	Archive m_archive;
 	AdjacentMatrix m_matrix;
+	AdjacencyIndex m_adjacency;
+	ExpirationIndex m_expirations;
+	//edge durations, by edge slot
+	IntervalIndex<std::chrono::system_clock::time_point, SlotIndex> m_validity;
 	AccessibilityMatrix m_pathMatrix;
-	RegexCache m_regexCache;
+	//destination -> sources with a cached path to it, so a released node drops its column without a scan
+	std::unordered_map<LabelId, std::unordered_set<LabelId, typename Policy::Hash>, typename Policy::Hash> m_pathSources;
+	//(source, destination) arc -> the (source, destination) cells with a cached path using it, both packed by MakeLabelNodeKey
+	std::unordered_map<uint64_t, std::unordered_set<uint64_t>> m_pathsByArc;
+	ReachabilityIndex m_reachability;
+	NodeLabelIndex m_labelIndex;
+	//every label the graph has seen, with the labels each regex asked about matches
+	GraphLabelDictionary m_labelDictionary;
+	//bumped by every change of the nodes or edges (see _Thaw), m_regexCache is dropped when it moves
+	uint64_t m_generation;
+	mutable RegexCache m_regexCache;
 	std::chrono::system_clock::time_point m_valability;
 	Duration m_validityInterval;
+	Frozen m_frozen;
 
-	std::function<void(const CNode *)> fakeNodeDeleter;
-	std::function<void(const CEdge *)> fakeEdgeDeleter; 
-	typedef std::unique_ptr<const CNode, decltype(fakeNodeDeleter)> CNodePtr;
-	typedef std::unique_ptr<const CEdge, decltype(fakeEdgeDeleter)> CEdgePtr;
-	#define CRefNodePtr(x) CNodePtr(&(x), fakeNodeDeleter)
-	#define CRefEdgePtr(x) CEdgePtr(&(x), fakeEdgeDeleter)
+	//the pointers only borrow records; the deleter holds no state, so nothing of it is left behind by a move
+	struct FakeDeleter
+	{
+		template <typename Type>
+		inline void operator()(/* in */ const Type *) const { }
+	};
+	typedef std::unique_ptr<const CNode, FakeDeleter> CNodePtr;
+	typedef std::unique_ptr<const CEdge, FakeDeleter> CEdgePtr;
+	#define CRefNodePtr(x) CNodePtr(&(x))
+	#define CRefEdgePtr(x) CEdgePtr(&(x))
 
 #ifdef TESTING
 public:
@@ -216,28 +419,208 @@ private:
 #endif
 	bool _IsRegexMatch(/* in */ const std::wstring &regex, /* in */ const std::wstring &string) const;
 	bool _IsRegexMatch(/* in */ const boost::wregex &regex, /* in */ const std::wstring &string) const;
-	TN _GetPossibleUnknownNodes(/* in */ const ContextGraph patternGraph) const;
+	TN _GetPossibleUnknownNodes(/* in */ const BasicContextGraph &patternGraph, /* in_opt */ bool bArchive = false) const;
 	void _AddEdgeToAdjacencyMatrix(/* in */ const CEdge &e);
+	void _RemoveEdgeFromAdjacencyMatrix(/* in */ const CEdge &e);
+	template <typename Fn>
+	void _ForEachPathMatchedByAutomaton(/* inout */ RegexAutomaton &automaton,
+										/* in */ const CNode &source,
+										/* in */ const CNode &destination,
+										/* in */ const EdgeFilter &filter,
+										/* in */ Fn fn) const;
+	//roads gets the node paths the boost fallback walked, so the caller may cache them
+	std::vector<const CEdge *> _FindMaxPathMatchedByRegex(/* in */ const std::wstring &regex,
+														  /* in */ const CNode &source,
+														  /* in */ const CNode &destination,
+														  /* in */ const EdgeFilter &filter,
+														  /* out_opt */ Paths *roads = nullptr) const;
+	std::vector<const CEdge *> _FindMaxPathMatchedByBoostRegex(/* in */ const std::wstring &regex,
+															   /* in */ const CNode &source,
+															   /* in */ const CNode &destination,
+															   /* in */ const EdgeFilter &filter,
+															   /* out */ Paths &roads) const;
+	PointerEdgePaths _FindAllPathsMatchedByBoostRegex(/* in */ const std::wstring &regex, /* in */ const CNode &source, /* in */ const CNode &destination);
 	void _AddCurrentPathsToCache(/* in */ const CNode &source, /* in */ const CNode &dest, /* in */ const Paths &roads);
-	void _AddSingleUniquePathToCache(/* in */ const CNode &source, /* in */ const CNode &dest, /* in */ const Paths::key_type &road);
+	void _AddSingleUniquePathToCache(/* in */ const CNode &source, /* in */ const CNode &dest, /* in */ const typename Paths::key_type &road);
+	void _RegisterPathArcs(/* in */ LabelId source, /* in */ LabelId dest, /* in */ const typename Paths::key_type &road);
+	void _ExtendPathsWithArc(/* in */ const CNode &source, /* in */ const CNode &dest);
+	void _InvalidatePathsThroughArc(/* in */ LabelId source, /* in */ LabelId dest);
+	void _ClearPaths(void);
 	void _ReadGraphFromDotFormat(/* in */ const std::wstring &dot);
 	void _ExtractEdge(/* in */ const std::wstring &edge);
+	void _AddEdgeFromText(/* in */ const std::wstring &strLabel,
+						  /* in */ const std::wstring &strNode1,
+						  /* in */ const std::wstring &strNode2,
+						  /* in */ std::chrono::system_clock::time_point expireTime,
+						  /* in */ Duration duration);
+	void _ReplaceNode(/* in */ const CNode &oldNode, /* in */ const CNode &newNode);
 	void _ReadGraphFromDotFormatNoRegex(const std::wstring &dot);
 	void _DeleteEdge(/* in */ const CEdge &edge);
+	void _ArchiveEdge(/* in */ const CEdge &edge);
+	void _UnlinkEdge(/* in */ const CEdge &edge);
+	void _UnlinkEdges(/* in */ const std::vector<const CEdge *> &edges);
+	void _ReleaseIfIsolated(/* in */ const CNode &node);
+	void _ReleaseIsolatedNodes(/* inout */ std::vector<const CNode *> &nodes);
+	void _ErasePathsOf(/* in */ LabelId node);
 	std::vector<const CEdge *> _FindRandomSpanningTree(/* in */ const std::vector<const CNode *> &nodes) const;
-	void _BeforeEdgeDeletion(/* in */ const CEdge &edge);
+	const CNode & _StoreNode(/* in */ const CNode &node);
+	void _ReleaseNode(/* in */ const CNode &node);
+	const CEdge & _StoreEdge(/* in */ const CEdge &edge);
+	void _ReleaseEdge(/* in */ const CEdge &edge);
+	void _IndexEdgeEndpoints(/* in */ const CEdge &edge);
+	void _UnindexEdgeEndpoints(/* in */ const CEdge &edge);
+	void _Thaw(void);
+	void _CopyFrom(/* in */ const BasicContextGraph &other);
+	//fnUnknown(node) tells whether an unknown pattern node may take node
+	template <typename UnknownFn>
+	std::vector<const CEdge *> _GetCorrespondingConcreteEdges(/* in */ const CEdge &edge,
+															  /* in */ const UnknownFn &fnUnknown,
+															  /* in */ const EdgeFilter &filter,
+															  /* in_opt */ const AdjacentEdges *validEdges) const;
+	bool _CollectEdgesValidDuring(/* in */ Duration interval, /* in */ size_t maxEdges, /* out */ AdjacentEdges &edges) const;
+	bool _IsCurrentExpiration(/* in */ const typename ExpirationIndex::Entry &entry) const;
+	//the node of this graph standing for node: the stored one with its label, else the archived one
+	const CNode &_CanonicalNode(/* in */ const CNode &node) const;
+
+	//slot of the stored node with the same label; node may belong to another graph
+	inline bool _FindSlot(/* in */ const CNode &node, /* out */ SlotIndex &slot) const
+	{
+		slot = node.GetIndex();
+		if (m_nodes.IsLive(slot) && &m_nodes[slot] == &node)
+			return true;
+
+		const CNode *stored = nullptr;
+		if (!FindNodeById(node.GetLabelId(), stored))
+			return false;
+
+		slot = stored->GetIndex();
+		return true;
+	}
+
+	//Fn returns false to stop the iteration
+	template <typename Fn>
+	void _ForEachChild(/* in */ const CNode &node, /* in */ Fn fn) const
+	{
+		typename Frozen::Index index;
+		if (m_bFrozen)
+		{
+			if (!m_frozen.FindIndex(node, index))
+				return;
+			auto arcs = m_frozen.GetOutArcs(index);
+			for (auto arc = arcs.first; arc != arcs.second; arc++)
+				if (!fn(arc->edge))
+					return;
+			return;
+		}
+
+		auto children = GetChildren(node);
+		for (auto child = children.first; child != children.second; child++)
+			if (!fn(child->second))
+				return;
+	}
+
+	template <typename Fn>
+	void _ForEachParent(/* in */ const CNode &node, /* in */ Fn fn) const
+	{
+		typename Frozen::Index index;
+		if (m_bFrozen)
+		{
+			if (!m_frozen.FindIndex(node, index))
+				return;
+			auto arcs = m_frozen.GetInArcs(index);
+			for (auto arc = arcs.first; arc != arcs.second; arc++)
+				if (!fn(arc->edge))
+					return;
+			return;
+		}
+
+		auto parents = GetParents(node);
+		for (auto parent = parents.first; parent != parents.second; parent++)
+			if (!fn(parent->second))
+				return;
+	}
+
+	template <typename Fn>
+	void _ForEachEdgeBetween(/* in */ const CNode &source, /* in */ const CNode &destination, /* in */ Fn fn) const
+	{
+		if (m_bFrozen)
+		{
+			typename Frozen::Index sourceIndex, destinationIndex;
+			if (!m_frozen.FindIndex(source, sourceIndex) || !m_frozen.FindIndex(destination, destinationIndex))
+				return;
+			auto arcs = m_frozen.GetArcsBetween(sourceIndex, destinationIndex);
+			for (auto arc = arcs.first; arc != arcs.second; arc++)
+				if (!fn(arc->edge))
+					return;
+			return;
+		}
+
+		const auto row = m_matrix.find(source.GetLabelId());
+		if (row == m_matrix.cend())
+			return;
+		const auto cell = row->second.find(destination.GetLabelId());
+		if (cell == row->second.cend())
+			return;
+		for (auto edge : cell->second)
+			if (!fn(edge))
+				return;
+	}
+	template <typename Index>
+	inline static EdgeRange _GetRange(/* in */ const Index &index, /* in */ const typename Index::key_type &key)
+	{
+		static const AdjacentEdges noEdges;
+		auto found = index.find(key);
+		if (found == index.cend())
+			return std::make_pair(noEdges.cbegin(), noEdges.cend());
+		return std::make_pair(found->second.cbegin(), found->second.cend());
+	}
+
+	template <typename Index>
+	inline static void _EraseFromIndex(/* inout */ Index &index, /* in */ const typename Index::key_type &key, /* in */ const CEdge *edge)
+	{
+		auto bucket = index.find(key);
+		if (bucket == index.end())
+			return;
+
+		auto &edges = bucket->second;
+		auto found = std::find(edges.begin(), edges.end(), edge);
+		if (found != edges.end())
+			edges.erase(found);
+		if (edges.empty())
+			index.erase(bucket);
+	}
+
+	//drops the doomed edges from the bucket of every key, each bucket is swept once
+	template <typename Index, typename DoomedFn>
+	inline static void _EraseAllFromIndex(/* inout */ Index &index,
+										  /* in */ const std::unordered_set<typename Index::key_type, typename Index::hasher> &keys,
+										  /* in */ const DoomedFn &fnDoomed)
+	{
+		for (auto &key : keys)
+		{
+			auto bucket = index.find(key);
+			if (bucket == index.end())
+				continue;
+
+			auto &edges = bucket->second;
+			edges.erase(std::remove_if(edges.begin(), edges.end(), fnDoomed), edges.end());
+			if (edges.empty())
+				index.erase(bucket);
+		}
+	}
+
 	HAS_MEM_FUNC(find, m_hasFind)
 
-	template <typename T, typename ToFind> 
-	typename std::enable_if<m_hasFind<T>::result, bool>::type
-	inline static _CallFind(/* in */ const T &container, /* in */ const ToFind &element)
+	template <typename Container, typename ToFind> 
+	typename std::enable_if<m_hasFind<Container>::result, bool>::type
+	inline static _CallFind(/* in */ const Container &container, /* in */ const ToFind &element)
 	{
 		return container.find(element) != container.cend();
 	}
 
-	template <typename T, typename ToFind> 
-	typename std::enable_if<!m_hasFind<T>::result, bool>::type
-	inline static _CallFind(/* in */ const T &container, /* in */ const ToFind &element)
+	template <typename Container, typename ToFind> 
+	typename std::enable_if<!m_hasFind<Container>::result, bool>::type
+	inline static _CallFind(/* in */ const Container &container, /* in */ const ToFind &element)
 	{
 		return std::find(container.cbegin(), container.cend(), element) != container.cend();
 	}
@@ -256,3 +639,9 @@ private:
 		}
 	}
 };
+
+extern template class BasicContextGraph<WStringLabelPolicy>;
+extern template class BasicContextGraph<IntegerLabelPolicy>;
+
+typedef BasicContextGraph<WStringLabelPolicy> ContextGraph;
+typedef BasicContextGraph<IntegerLabelPolicy> IntegerContextGraph;
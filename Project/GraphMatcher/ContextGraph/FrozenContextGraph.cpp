@@ -0,0 +1,156 @@
+#include "CommonTypes.h"
+#include "FrozenContextGraph.h"
+
+template <typename Policy>
+void BasicFrozenContextGraph<Policy>::Clear(void)
+{
+	m_nodes.clear();
+	m_indexes.clear();
+	m_outOffsets.clear();
+	m_outArcs.clear();
+	m_inOffsets.clear();
+	m_inArcs.clear();
+}
+
+template <typename Policy>
+void BasicFrozenContextGraph<Policy>::Build(/* in */ const typename BasicIContextGraph<Policy>::NodeStore &nodes, /* in */ const typename BasicIContextGraph<Policy>::TE &edges)
+{
+	Clear();
+
+	auto fnIndexOf = [this] (/* in */ const CNode &node) -> Index
+	{
+		auto found = m_indexes.find(node.GetLabelId());
+		if (found != m_indexes.cend())
+			return found->second;
+
+		Index index = static_cast<Index>(m_nodes.size());
+		m_nodes.emplace_back(&node);
+		m_indexes.emplace(node.GetLabelId(), index);
+		return index;
+	};
+
+	m_nodes.reserve(nodes.size());
+	m_indexes.reserve(nodes.size());
+	for (auto &node : nodes)
+		fnIndexOf(node);
+
+	std::vector<std::pair<Index, Index>> endpoints;
+	endpoints.reserve(edges.size());
+	for (auto &edge : edges)
+		endpoints.emplace_back(fnIndexOf(edge.GetSource()), fnIndexOf(edge.GetDestination()));
+
+	auto nodeCount = m_nodes.size();
+	m_outOffsets.assign(nodeCount + 1, 0);
+	m_inOffsets.assign(nodeCount + 1, 0);
+	for (auto &endpoint : endpoints)
+	{
+		m_outOffsets[endpoint.first + 1]++;
+		m_inOffsets[endpoint.second + 1]++;
+	}
+	std::partial_sum(m_outOffsets.begin(), m_outOffsets.end(), m_outOffsets.begin());
+	std::partial_sum(m_inOffsets.begin(), m_inOffsets.end(), m_inOffsets.begin());
+
+	m_outArcs.resize(edges.size());
+	m_inArcs.resize(edges.size());
+	std::vector<size_t> outPosition(m_outOffsets.cbegin(), m_outOffsets.cend() - 1);
+	std::vector<size_t> inPosition(m_inOffsets.cbegin(), m_inOffsets.cend() - 1);
+
+	size_t i = 0;
+	for (auto &edge : edges)
+	{
+		const auto &endpoint = endpoints[i++];
+		m_outArcs[outPosition[endpoint.first]++] = Arc { endpoint.second, edge.GetLabelId(), &edge };
+		m_inArcs[inPosition[endpoint.second]++] = Arc { endpoint.first, edge.GetLabelId(), &edge };
+	}
+
+	auto fnArcLess = [] (/* in */ const Arc &a1, /* in */ const Arc &a2)
+	{
+		return a1.neighbour < a2.neighbour || (a1.neighbour == a2.neighbour && a1.label < a2.label);
+	};
+
+	for (size_t node = 0; node < nodeCount; node++)
+	{
+		std::sort(m_outArcs.begin() + m_outOffsets[node], m_outArcs.begin() + m_outOffsets[node + 1], fnArcLess);
+		std::sort(m_inArcs.begin() + m_inOffsets[node], m_inArcs.begin() + m_inOffsets[node + 1], fnArcLess);
+	}
+}
+
+template <typename Policy>
+auto BasicFrozenContextGraph<Policy>::GetArcsBetween(/* in */ Index source, /* in */ Index destination) const -> ArcRange
+{
+	auto arcs = GetOutArcs(source);
+
+	struct NeighbourLess
+	{
+		inline bool operator()(/* in */ const Arc &arc, /* in */ Index node) const { return arc.neighbour < node; }
+		inline bool operator()(/* in */ Index node, /* in */ const Arc &arc) const { return node < arc.neighbour; }
+	};
+
+	return std::equal_range(arcs.first, arcs.second, destination, NeighbourLess());
+}
+
+template <typename Policy>
+auto BasicFrozenContextGraph<Policy>::ComputeConnexComponents(void) const -> std::vector<std::vector<const CEdge *>>
+{
+	std::vector<std::vector<const CEdge *>> connexComponents;
+	auto nodeCount = m_nodes.size();
+
+	//a node is expanded only once, so an arc is reported from the endpoint that gets expanded first
+	std::vector<bool> discovered(nodeCount, false);
+	std::vector<bool> expanded(nodeCount, false);
+	std::queue<Index> queue;
+
+	for (Index start = 0; start < nodeCount; start++)
+	{
+		if (discovered[start])
+			continue;
+
+		std::vector<const CEdge *> connexComponent;
+		discovered[start] = true;
+		queue.emplace(start);
+
+		while (!queue.empty())
+		{
+			Index current = queue.front();
+			queue.pop();
+
+			auto children = GetOutArcs(current);
+			for (auto arc = children.first; arc != children.second; arc++)
+			{
+				if (expanded[arc->neighbour])
+					continue;
+
+				connexComponent.emplace_back(arc->edge);
+				if (!discovered[arc->neighbour])
+				{
+					discovered[arc->neighbour] = true;
+					queue.emplace(arc->neighbour);
+				}
+			}
+
+			auto parents = GetInArcs(current);
+			for (auto arc = parents.first; arc != parents.second; arc++)
+			{
+				if (expanded[arc->neighbour] || arc->neighbour == current)
+					continue;
+
+				connexComponent.emplace_back(arc->edge);
+				if (!discovered[arc->neighbour])
+				{
+					discovered[arc->neighbour] = true;
+					queue.emplace(arc->neighbour);
+				}
+			}
+
+			expanded[current] = true;
+		}
+
+		if (!connexComponent.empty())
+			connexComponents.emplace_back(connexComponent);
+	}
+
+	return connexComponents;
+}
+
+template class BasicFrozenContextGraph<WStringLabelPolicy>;
+template class BasicFrozenContextGraph<IntegerLabelPolicy>;
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Node.h"
+#include "Edge.h"
+#include "IContextGraph.h"
+
+//read-only compressed sparse row snapshot of a context graph
+//every node gets a dense index and its out/in arcs are stored contiguously, sorted by (neighbour, label)
+template <typename Policy>
+class BasicFrozenContextGraph
+{
+public:
+	typedef Node<Policy> CNode;
+	typedef Edge<Policy> CEdge;
+	typedef uint32_t Index;
+
+	struct Arc
+	{
+		Index neighbour;
+		LabelId label;
+		const CEdge *edge;
+	};
+
+	typedef std::pair<const Arc *, const Arc *> ArcRange;
+
+public:
+	BasicFrozenContextGraph() { }
+
+	void Build(/* in */ const typename BasicIContextGraph<Policy>::NodeStore &nodes, /* in */ const typename BasicIContextGraph<Policy>::TE &edges);
+	void Clear(void);
+
+	inline bool FindIndex(/* in */ const CNode &node, /* out */ Index &index) const
+	{
+		auto found = m_indexes.find(node.GetLabelId());
+		if (found == m_indexes.cend())
+			return false;
+
+		index = found->second;
+		return true;
+	}
+
+	inline size_t GetNodeCount(void) const { return m_nodes.size(); }
+	inline size_t GetEdgeCount(void) const { return m_outArcs.size(); }
+	inline const CNode &GetNode(/* in */ Index index) const { return *m_nodes[index]; }
+
+	inline ArcRange GetOutArcs(/* in */ Index index) const
+	{ return _GetRange(m_outArcs, m_outOffsets, index); }
+	inline ArcRange GetInArcs(/* in */ Index index) const
+	{ return _GetRange(m_inArcs, m_inOffsets, index); }
+
+	//all the arcs source -> destination
+	ArcRange GetArcsBetween(/* in */ Index source, /* in */ Index destination) const;
+	inline bool IsAdjacent(/* in */ Index source, /* in */ Index destination) const
+	{
+		auto arcs = GetArcsBetween(source, destination);
+		return arcs.first != arcs.second;
+	}
+
+	std::vector<std::vector<const CEdge *>> ComputeConnexComponents(void) const;
+
+private:
+	inline static ArcRange _GetRange(/* in */ const std::vector<Arc> &arcs, /* in */ const std::vector<size_t> &offsets, /* in */ Index index)
+	{
+		const Arc *base = arcs.data();
+		return std::make_pair(base + offsets[index], base + offsets[index + 1]);
+	}
+
+	std::vector<const CNode *> m_nodes;
+	std::unordered_map<LabelId, Index, typename Policy::Hash> m_indexes;
+	std::vector<size_t> m_outOffsets;
+	std::vector<Arc> m_outArcs;
+	std::vector<size_t> m_inOffsets;
+	std::vector<Arc> m_inArcs;
+};
+
+extern template class BasicFrozenContextGraph<WStringLabelPolicy>;
+extern template class BasicFrozenContextGraph<IntegerLabelPolicy>;
+
+typedef BasicFrozenContextGraph<WStringLabelPolicy> FrozenContextGraph;
@@ -3,6 +3,7 @@
 
 #include "CommonTypes.h"
 #include "ContextGraph.h"
+#include "../Agent/AgentInfrastructure/Tasks/ExpirationTimer.hpp"
 
 bool Test_AddStringEdge()
 {
@@ -962,6 +963,1242 @@ bool Test_BigGraphMatching()
 	return true;
 }
 
+bool Test_FrozenGraph()
+{
+	ContextGraph cg;
+	cg.AddEdge(L"e", L"2", L"4");
+	cg.AddEdge(L"e1", L"4", L"1");
+	cg.AddEdge(L"e2", L"1", L"2");
+	cg.AddEdge(L"e3", L"3", L"2");
+	cg.AddEdge(L"e4", L"5", L"6");
+	cg.AddEdge(L"e5", L"4", L"7");
+	cg.AddEdge(L"e6", L"2", L"2");
+	cg.AddEdge(L"e6", L"4", L"4");
+
+	auto fnCountPaths = [&cg] (const std::wstring &n1, const std::wstring &n2)
+	{
+		IContextGraph::Paths roads([] (const std::vector<CNode const *> &l1, const std::vector<CNode const *> &l2) { return l1.size() > l2.size(); });
+		cg.GetPathBetweenNodes(cg.GetNodeByName(n1), cg.GetNodeByName(n2), roads);
+		return roads.size();
+	};
+
+	auto paths = fnCountPaths(L"3", L"7");
+	auto neighbours = cg.GetNeighbours(cg.GetNodeByName(L"4"));
+
+	cg.Freeze();
+	auto connexComponents = cg.ComputeConnexComponents();
+	bool bFrozen = cg.IsFrozen() &&
+				   connexComponents.size() == 2 &&
+				   connexComponents[0].size() + connexComponents[1].size() == 8 &&
+				   fnCountPaths(L"3", L"7") == paths &&
+				   cg.GetNeighbours(cg.GetNodeByName(L"4")) == neighbours;
+
+	cg.AddEdge(L"e7", L"7", L"5");
+
+	return bFrozen && !cg.IsFrozen() && cg.ComputeConnexComponents().size() == 1;
+}
+
+bool Test_SlabStorage()
+{
+	ContextGraph cg;
+	cg.AddEdge(L"e1", L"1", L"2");
+	cg.AddEdge(L"e2", L"2", L"3");
+	cg.AddEdge(L"e3", L"3", L"4");
+
+	auto node3 = &cg.GetNodeByName(L"3");
+	auto edge2 = cg.FindEdge(L"e2", cg.GetNodeByName(L"2"), *node3);
+
+	//erasing records must not move the ones that are left, and the freed slots are reused
+	cg._DeleteEdge(*cg.FindEdge(L"e1", cg.GetNodeByName(L"1"), cg.GetNodeByName(L"2")));
+	cg.AddEdge(L"e4", L"5", L"3");
+	bool bStable = &cg.GetNodeByName(L"3") == node3 &&
+				   cg.FindEdge(L"e2", cg.GetNodeByName(L"2"), *node3) == edge2 &&
+				   cg.GetEdges().size() == 3 &&
+				   cg.GetNodes().size() == 4 &&
+				   cg.GetEdges().GetEndIndex() == 3;
+
+	const CNode *removed = nullptr;
+	bool bRemoved = !cg.FindNodeByName(L"1", removed);
+
+	auto edges = cg.GetEdges();
+	bool bCopied = edges == cg.GetEdges();
+
+	cg.Clear();
+	return bStable && bRemoved && bCopied && cg.GetEdges().empty() && cg.GetNodes().empty() && edges.size() == 3;
+}
+
+bool Test_IntegerGraph()
+{
+	IntegerContextGraph cg;
+	cg.AddEdge(10, 1, 2);
+	cg.AddEdge(11, 2, 3);
+	cg.AddEdge(10, 3, 1);
+
+	IntegerContextGraph pattern;
+	pattern.AddEdge(10, 1, 2);
+
+	IntegerContextGraph unknownPattern;
+	unknownPattern.AddEdge(10, 7, 8);
+	unknownPattern.ConvertNodesToUnknown(100);
+
+	//an integer past 2^31 would alias a text label, the graph refuses it and stays as it was
+	bool bRejected = false;
+	try
+	{
+		cg.AddEdge(IntegerLabelPolicy::TEXT_TAG + 5, 1, 4);
+	}
+	catch (const std::out_of_range &)
+	{
+		bRejected = true;
+	}
+	const IntegerContextGraph::CNode *tagged = nullptr;
+	bRejected = bRejected && cg.GetEdges().size() == 3 && cg.GetNodes().size() == 3 && !cg.FindNodeByName(0xFFFFFFFFu, tagged);
+
+	//an edge read from text keeps its label when a match or a subgraph copies it, no integer spells that label
+	bool bText = false;
+	try
+	{
+		IntegerContextGraph text;
+		text._AddEdgeFromText(L"knows", L"1", L"2", NEVER_EXPIRE, PERMANENT_DURATION);
+		IntegerContextGraph textPattern;
+		textPattern._AddEdgeFromText(L"knows", L"1", L"2", NEVER_EXPIRE, PERMANENT_DURATION);
+		auto graphs = text.GetMaximumMatchGraphs(textPattern);
+		auto subgraph = text.GenerateRandomSubgraph(100, 100, 0);
+		bText = graphs.size() == 1 && graphs[0].GetEdges().size() == 1 && graphs[0].GetEdges().begin()->GetLabel() == L"knows" &&
+				subgraph.GetEdges().size() == 1 && subgraph.GetEdges().begin()->GetLabel() == L"knows";
+	}
+	catch (const std::out_of_range &)
+	{
+	}
+
+	//and when the graph archives it, evicted or deleted, and matches over the archive
+	bool bArchived = false;
+	try
+	{
+		auto now = std::chrono::system_clock::now();
+		IntegerContextGraph archived;
+		archived._AddEdgeFromText(L"knows", L"1", L"2", now - std::chrono::seconds(10), PERMANENT_DURATION);
+		archived._AddEdgeFromText(L"likes", L"2", L"3", now - std::chrono::seconds(10), PERMANENT_DURATION);
+		archived._AddEdgeFromText(L"sees", L"3", L"4", NEVER_EXPIRE, PERMANENT_DURATION);
+		archived.RefreshGraphConsistency();
+		archived._DeleteEdge(*archived.m_edges.begin());
+		std::set<std::wstring> labels;
+		archived.GetArchive().ForEach([&] (const IntegerContextGraph::CEdge &edge) { labels.emplace(edge.GetLabel()); });
+
+		IntegerContextGraph regexPattern;
+		auto regexEdge = IntegerContextGraph::CEdge::FromText(L"e", regexPattern._StoreNode(IntegerContextGraph::CNode::FromText(L"?a")),
+															  regexPattern._StoreNode(IntegerContextGraph::CNode::FromText(L"?b")));
+		regexEdge.SetRegex(L"knows");
+		regexPattern.AddEdge(regexEdge);
+		EdgeFilter past;
+		past.SetArchiveAsOf(now - std::chrono::seconds(20));
+		auto matches = archived.GetMaximumMatch(regexPattern, past);
+
+		bArchived = archived.GetEdges().empty() && labels == std::set<std::wstring>{ L"knows", L"likes", L"sees" } &&
+					matches.size() == 1 && matches.begin()->size() == 1 && (*matches.begin()->begin())->GetLabel() == L"knows";
+	}
+	catch (const std::out_of_range &)
+	{
+	}
+
+	auto &node2 = cg.GetNodeByName(2);
+	return bRejected && bText && bArchived &&
+		   cg.GetMaximumMatch(pattern).size() == 1 &&
+		   cg.GetMaximumMatch(unknownPattern).size() == 2 &&
+		   pattern.IsIncludedIn(cg) &&
+		   node2.GetLabel() == L"2" &&
+		   node2.GetNode() == 2 &&
+		   cg.FindEdge(11, node2, cg.GetNodeByName(3)) != nullptr &&
+		   cg.FindEdge(11, cg.GetNodeByName(3), node2) == nullptr;
+}
+
+bool Test_AdjacencyIndex()
+{
+	ContextGraph cg;
+	for (int i = 1; i < 100; i++)
+	{
+		cg.AddEdge(L"hub", L"0", std::to_wstring(i));
+		cg.AddEdge(L"chain", std::to_wstring(i - 1), std::to_wstring(i));
+	}
+
+	auto fnCheckAll = [&cg] () -> bool
+	{
+		for (auto &n1 : cg.GetNodes())
+			for (auto &n2 : cg.GetNodes())
+			{
+				auto cell = cg.m_matrix.find(n1.GetLabelId());
+				bool bExpected = cell != cg.m_matrix.cend() &&
+								 cell->second.find(n2.GetLabelId()) != cell->second.cend() &&
+								 !cell->second.at(n2.GetLabelId()).empty();
+				if (cg.IsAdjacent(n1, n2) != bExpected)
+					return false;
+			}
+		return true;
+	};
+
+	auto &hub = cg.GetNodeByName(L"0");
+	bool bDense = cg.m_adjacency.IsDense(hub.GetIndex()) && !cg.m_adjacency.IsDense(cg.GetNodeByName(L"5").GetIndex());
+	bool bAll = fnCheckAll();
+
+	//a foreign node with the same label answers like the stored one
+	CNode foreign(L"0");
+	bool bForeign = cg.IsAdjacent(foreign, cg.GetNodeByName(L"7")) && !cg.IsAdjacent(cg.GetNodeByName(L"7"), foreign);
+
+	cg._DeleteEdge(*cg.FindEdge(L"hub", hub, cg.GetNodeByName(L"3")));
+	cg.RemoveNode(L"50");
+	bool bUpdated = !cg.IsAdjacent(hub, cg.GetNodeByName(L"3")) && fnCheckAll();
+	//the slot of 50 goes to a new node, whose column the removal left empty
+	cg.AddEdge(L"chain", L"fresh", L"49");
+	bUpdated = bUpdated && !cg.IsAdjacent(hub, cg.GetNodeByName(L"fresh")) && fnCheckAll();
+
+	cg.SetAdjacencyDensityThreshold(2.0);
+	bool bSparse = !cg.m_adjacency.IsDense(hub.GetIndex()) && fnCheckAll();
+
+	return bDense && bAll && bForeign && bUpdated && bSparse;
+}
+
+bool Test_CompositeEdgeIndex()
+{
+	ContextGraph cg;
+	cg.AllowDuplicateEdges(false);
+	for (int i = 0; i < 50; i++)
+	{
+		cg.AddEdge(L"is", L"a" + std::to_wstring(i), L"thing");
+		cg.AddEdge(L"is", L"thing", L"b" + std::to_wstring(i));
+	}
+	//same triple is merged, same label between other nodes is not
+	cg.AddEdge(L"is", L"a0", L"thing");
+	cg.AddEdge(L"is", L"a0", L"b0");
+
+	auto fnCount = [] (ContextGraph::EdgeRange range) { return std::distance(range.first, range.second); };
+
+	const auto &thing = cg.GetNodeByName(L"thing");
+	auto isId = cg.FindEdge(L"is", cg.GetNodeByName(L"a0"), thing)->GetLabelId();
+	bool bIndexed = cg.GetEdges().size() == 101 &&
+					fnCount(cg.GetEdgesByLabelAndSource(isId, thing)) == 50 &&
+					fnCount(cg.GetEdgesByLabelAndDestination(isId, thing)) == 50 &&
+					fnCount(cg.GetEdgesByLabelAndSource(isId, cg.GetNodeByName(L"a0"))) == 2 &&
+					fnCount(cg.GetEdgesBetween(isId, cg.GetNodeByName(L"a0"), thing)) == 1;
+
+	ContextGraph pattern;
+	pattern.AddEdge(L"is", L"a3", L"thing");
+	pattern.AddEdge(L"is", L"thing", L"b7");
+	bool bIncluded = pattern.IsIncludedIn(cg);
+
+	cg.ReplaceNode(L"a3", L"c3");
+	cg._DeleteEdge(*cg.FindEdge(L"is", thing, cg.GetNodeByName(L"b7")));
+	bool bUpdated = !pattern.IsIncludedIn(cg) &&
+					cg.FindEdge(L"is", cg.GetNodeByName(L"c3"), thing) != nullptr &&
+					fnCount(cg.GetEdgesByLabelAndSource(isId, thing)) == 49 &&
+					fnCount(cg.GetEdgesByLabelAndDestination(isId, thing)) == 50;
+
+	return bIndexed && bIncluded && bUpdated;
+}
+
+bool Test_CopyAndMove()
+{
+	auto expire = std::chrono::system_clock::now() + std::chrono::hours(1);
+	Duration duration(std::chrono::system_clock::from_time_t(100), std::chrono::system_clock::from_time_t(200));
+
+	ContextGraph cg;
+	cg.AddEdge(L"e", L"1", L"2", expire, duration);
+	cg.AddEdge(L"e", L"2", L"3");
+	cg.AddEdge(L"f", L"3", L"1");
+	cg.PrecomputeRoadsBetweenPairOfNodes();
+
+	//the copy owns its records and keeps the expiration data
+	ContextGraph copy(cg);
+	const auto &source = copy.GetNodeByName(L"1");
+	auto edge = copy.FindEdge(L"e", source, copy.GetNodeByName(L"2"));
+	ContextGraph::Paths paths;
+	bool bCopied = copy.GetEdges().size() == 3 &&
+				   edge != nullptr && edge != cg.FindEdge(L"e", cg.GetNodeByName(L"1"), cg.GetNodeByName(L"2")) &&
+				   &edge->GetSource() == &source &&
+				   edge->GetLastExpirationTime() == expire && edge->GetDuration() == duration &&
+				   copy.IsAdjacent(source, copy.GetNodeByName(L"2")) &&
+				   copy.GetPathBetweenNodes(source, copy.GetNodeByName(L"3"), paths) &&
+				   paths.begin()->front() == &source;
+
+	//moving keeps the addresses of the records
+	ContextGraph moved(std::move(copy));
+	bool bMoved = moved.FindEdge(L"e", source, moved.GetNodeByName(L"2")) == edge &&
+				  &moved.GetNodeByName(L"1") == &source;
+
+	//the moved-from graph is empty and takes new edges, cleared or not
+	bool bReused = copy.GetEdges().empty() && copy.GetNodes().empty();
+	copy.AddEdge(L"h", L"6", L"7");
+	bReused = bReused && copy.ComputeConnexComponents().size() == 1 && copy.IsAdjacent(copy.GetNodeByName(L"6"), copy.GetNodeByName(L"7"));
+	ContextGraph target;
+	target = std::move(copy);
+	copy.Clear();
+	copy.AddEdge(L"h", L"8", L"9");
+	copy.PrecomputeRoadsBetweenPairOfNodes();
+	bReused = bReused && copy.ComputeConnexComponents().size() == 1 && copy.GetEdges().size() == 1 &&
+			  target.GetEdges().size() == 1 && target.GetEdges().begin()->GetSource().GetLabel() == L"6";
+
+	ContextGraph assigned;
+	assigned.AddEdge(L"g", L"4", L"5");
+	assigned = moved;
+	const CNode *removed = nullptr;
+	bool bAssigned = assigned.GetEdges().size() == 3 &&
+					 !assigned.FindNodeByName(L"4", removed) &&
+					 &assigned.GetNodeByName(L"1") != &source &&
+					 assigned.GetEdges() == moved.GetEdges();
+
+	return bCopied && bMoved && bReused && bAssigned;
+}
+
+bool Test_FilteredMatch()
+{
+	auto now = std::chrono::system_clock::now();
+	ContextGraph cg;
+	cg.AddEdge(L"e", L"1", L"2", now + std::chrono::hours(1));
+	cg.AddEdge(L"f", L"2", L"3", now - std::chrono::seconds(1));
+	cg.AddEdge(L"f", L"4", L"3");
+
+	ContextGraph pattern;
+	pattern.AddEdge(L"e", L"1", L"2");
+	pattern.AddEdge(L"f", L"2", L"3");
+
+	auto live = cg.FindEdge(L"e", cg.GetNodeByName(L"1"), cg.GetNodeByName(L"2"));
+	EdgeFilter byLabel;
+	byLabel.SetLabels(std::vector<LabelId>(1, live->GetLabelId()));
+	auto labelMatch = cg.GetMaximumMatch(pattern, byLabel);
+	bool bLabels = labelMatch.size() == 1 && *labelMatch.begin() == std::set<const CEdge *>{ live };
+
+	//the expired edge goes to the archive, the match in the past still joins it to the live one through node 2
+	cg.RefreshGraphConsistency();
+	EdgeFilter past;
+	past.IncludeArchive();
+	auto liveMatch = cg.GetMaximumMatch(pattern);
+	auto pastMatch = cg.GetMaximumMatch(pattern, past);
+	bool bArchive = liveMatch.size() == 1 && liveMatch.begin()->size() == 1 &&
+					pastMatch.size() == 1 && pastMatch.begin()->size() == 2 &&
+					pastMatch.begin()->count(live) == 1;
+
+	return bLabels && bArchive;
+}
+
+bool Test_ExpirationIndex()
+{
+	auto now = std::chrono::system_clock::now();
+	ContextGraph cg;
+	cg.AllowDuplicateEdges(false);
+	for (int i = 0; i < 100; i++)
+		cg.AddEdge(L"e", std::to_wstring(i), std::to_wstring(i + 1), now + std::chrono::seconds(i + 1));
+	cg.AddEdge(L"f", L"0", L"100");
+	//the merged expiration postpones the first edge, its old entry goes stale
+	cg.AddEdge(L"e", L"0", L"1", now + std::chrono::seconds(1000));
+
+	bool bNext = cg.GetNextExpirationTime() == now + std::chrono::seconds(2);
+	bool bEvicted = cg.EvictExpired(now) == 0 &&
+					cg.EvictExpired(now + std::chrono::milliseconds(10500)) == 9 &&
+					cg.GetEdges().size() == 92 &&
+					cg.GetNextExpirationTime() == now + std::chrono::seconds(11) &&
+					cg.EvictExpired(now + std::chrono::seconds(2000)) == 91 &&
+					cg.GetEdges().size() == 1 &&
+					cg.GetNextExpirationTime() == NEVER_EXPIRE;
+
+	//merging the same expiration again pushes no entry
+	auto due = now + std::chrono::seconds(5);
+	ContextGraph merged;
+	merged.AllowDuplicateEdges(false);
+	merged.AddEdge(L"e", L"1", L"2", due);
+	merged.AddEdge(L"e", L"1", L"2", due);
+	bool bMerged = merged.m_expirations.size() == 1;
+
+	//the entry of a deleted edge doesn't pass for the edge that reuses its slot with the same expiration
+	ContextGraph reused;
+	reused.AddEdge(L"e", L"1", L"2", due);
+	auto slot = reused.m_edges.begin()->GetIndex();
+	reused._DeleteEdge(*reused.m_edges.begin());
+	reused.AddEdge(L"f", L"3", L"4", due);
+	size_t current = 0;
+	for (auto heap = reused.m_expirations; !heap.empty(); heap.Pop())
+		current += reused._IsCurrentExpiration(heap.Top()) ? 1 : 0;
+	bool bReused = reused.m_edges.begin()->GetIndex() == slot && reused.m_expirations.size() == 2 && current == 1;
+
+	//both edges are evicted once, whatever entries they left
+	bool bOnce = merged.EvictExpired(due + std::chrono::seconds(1)) == 1 && merged.GetEdges().empty() && merged.GetArchive().size() == 1 &&
+				 reused.EvictExpired(due + std::chrono::seconds(1)) == 1 && reused.GetEdges().empty() && reused.GetArchive().size() == 2;
+
+	return bNext && bEvicted && bMerged && bReused && bOnce;
+}
+
+bool Test_DeleteEdges()
+{
+	ContextGraph cg;
+	for (int i = 0; i < 200; i++)
+		cg.AddEdge(L"e", L"hub", std::to_wstring(i));
+	cg.AddEdge(L"loop", L"0", L"0");
+
+	std::vector<const CEdge *> doomed;
+	for (auto &edge : cg.GetEdges())
+		if (edge.GetEdge() == L"e" && edge.GetDestination().GetLabel() != L"199")
+			doomed.push_back(&edge);
+	auto eId = doomed.front()->GetLabelId();
+	cg.DeleteEdges(doomed.cbegin(), doomed.cend());
+
+	//node 0 keeps its loop, the other leaves are released, the label bucket is compacted
+	const CNode *released = nullptr;
+	const auto &hub = cg.GetNodeByName(L"hub");
+	auto last = cg.GetEdgesByLabelId(eId);
+	bool bBulk = cg.GetEdges().size() == 2 && cg.GetNodes().size() == 3 &&
+				 cg.GetArchive().size() == 199 &&
+				 !cg.FindNodeByName(L"5", released) &&
+				 cg.IsAdjacent(cg.GetNodeByName(L"0"), cg.GetNodeByName(L"0")) &&
+				 std::distance(last.first, last.second) == 1 &&
+				 &(*last.first)->GetDestination() == &cg.GetNodeByName(L"199") &&
+				 cg.FindEdge(L"e", hub, cg.GetNodeByName(L"199")) != nullptr;
+
+	//the hub buckets are swept once, keeping the survivor
+	auto children = cg.GetChildren(hub);
+	auto bySource = cg.GetEdgesByLabelAndSource(eId, hub);
+	bool bSwept = std::distance(children.first, children.second) == 1 && children.first->second == *last.first &&
+				  std::distance(bySource.first, bySource.second) == 1 && *bySource.first == *last.first;
+
+	cg._DeleteEdge(*cg.FindEdge(L"e", hub, cg.GetNodeByName(L"199")));
+	cg.RemoveNode(L"0");
+	bool bSingle = cg.GetEdges().empty() && cg.GetNodes().empty() && cg.GetArchive().size() == 200;
+
+	return bBulk && bSwept && bSingle;
+}
+
+bool Test_IncrementalPathCache()
+{
+	auto fnRoads = [] (const ContextGraph &cg)
+	{
+		std::multiset<std::wstring> roads;
+		for (auto &row : cg.m_pathMatrix)
+			for (auto &cell : row.second)
+				for (auto &path : cell.second)
+				{
+					std::wstring road;
+					for (auto node : path)
+						road += node->GetLabel() + L" ";
+					roads.emplace(road);
+				}
+		return roads;
+	};
+
+	std::mt19937 generator(7);
+	std::uniform_int_distribution<int> nodes(0, 5);
+	std::vector<std::pair<int, int>> arcs;
+	ContextGraph cg;
+	for (int i = 0; i < 6; i++)
+	{
+		arcs.emplace_back(nodes(generator), nodes(generator));
+		cg.AddEdge(L"e", std::to_wstring(arcs.back().first), std::to_wstring(arcs.back().second));
+	}
+	cg.PrecomputeRoadsBetweenPairOfNodes();
+
+	//grow and shrink the graph, the cache must stay the one a full precomputation gives
+	bool bSame = true;
+	for (int step = 0; step < 12 && bSame; step++)
+	{
+		if (step % 3 == 2 && !arcs.empty())
+		{
+			auto arc = arcs.back();
+			arcs.pop_back();
+			cg._DeleteEdge(*cg.FindEdge(L"e", cg.GetNodeByName(std::to_wstring(arc.first)), cg.GetNodeByName(std::to_wstring(arc.second))));
+		}
+		else
+		{
+			arcs.emplace_back(nodes(generator), nodes(generator));
+			cg.AddEdge(L"e", std::to_wstring(arcs.back().first), std::to_wstring(arcs.back().second));
+		}
+
+		ContextGraph fresh;
+		for (auto &arc : arcs)
+			fresh.AddEdge(L"e", std::to_wstring(arc.first), std::to_wstring(arc.second));
+		fresh.PrecomputeRoadsBetweenPairOfNodes();
+		bSame = fnRoads(cg) == fnRoads(fresh);
+	}
+
+	return bSame;
+}
+
+bool Test_TemporalArchive()
+{
+	auto t0 = std::chrono::system_clock::from_time_t(1000000);
+	auto fnAt = [t0] (int seconds) { return t0 + std::chrono::seconds(seconds); };
+
+	ContextGraph::Archive archive;
+	archive.SetSegmentSize(4);
+	CNode a(L"a"), b(L"b");
+	for (int i = 0; i < 10; i++)
+		archive.Add(CEdge(i % 2 ? L"odd" : L"even", a, b, NEVER_EXPIRE, Duration(fnAt(0), fnAt(100))), fnAt(i * 10));
+
+	size_t asOf = 0, between = 0, odd = 0;
+	archive.ForEachAsOf(fnAt(55), [&] (const CEdge &) { asOf++; });
+	archive.ForEachBetween(fnAt(15), fnAt(35), [&] (const CEdge &) { between++; });
+	LabelId oddId;
+	LabelDictionary::Instance().Find(L"odd", oddId);
+	archive.ForEachByLabel(oddId, fnAt(55), fnAt(55), [&] (const CEdge &) { odd++; });
+	bool bQueries = archive.size() == 10 && archive.GetSegmentCount() == 3 && asOf == 4 && between == 8 && odd == 2;
+
+	//the copy owns its nodes
+	ContextGraph::Archive copy(archive);
+	const CEdge *first = nullptr;
+	copy.ForEach([&] (const CEdge &edge) { if (!first) first = &edge; });
+	bool bCopy = copy.size() == 10 && &first->GetSource() == copy.FindNode(a) && copy.FindNode(a) != archive.FindNode(a);
+
+	//retention drops whole segments, oldest first
+	archive.SetRetention(std::chrono::seconds(45), 6);
+	bool bMaxEdges = archive.size() == 6 && archive.GetSegmentCount() == 2;
+	bool bMaxAge = archive.ApplyRetention(fnAt(120)) == 4 && archive.size() == 2 && archive.FindNode(a) != nullptr;
+	archive.SetRetention(std::chrono::seconds(0));
+	bool bEmpty = archive.ApplyRetention(fnAt(1000)) == 2 && archive.empty() && archive.FindNode(a) == nullptr;
+
+	//a match as of a past time only sees the edges still in the graph back then
+	auto now = std::chrono::system_clock::now();
+	ContextGraph cg;
+	cg.AddEdge(L"e", L"1", L"2", now - std::chrono::seconds(1000));
+	cg.AddEdge(L"e", L"1", L"3", now - std::chrono::seconds(10));
+	cg.AddEdge(L"e", L"4", L"5");
+	cg.EvictExpired(now);
+	ContextGraph pattern;
+	pattern.AddEdge(L"e", L"1", L"?");
+	EdgeFilter past;
+	past.SetArchiveAsOf(now - std::chrono::seconds(100));
+	auto match = cg.GetMaximumMatch(pattern, past);
+	bool bAsOf = cg.GetArchive().size() == 2 && match.size() == 1 && match.begin()->size() == 1 &&
+				 (*match.begin()->begin())->GetDestination().GetLabel() == L"3";
+
+	return bQueries && bCopy && bMaxEdges && bMaxAge && bEmpty && bAsOf;
+}
+
+bool Test_IntervalIndex()
+{
+	//random intervals against a brute force scan, erasing a third of them on the way
+	IntervalIndex<int, unsigned> index;
+	std::map<unsigned, std::pair<int, int>> intervals;
+	std::srand(7);
+	for (unsigned i = 0; i < 600; i++)
+	{
+		int low = std::rand() % 1000, high = low + std::rand() % 50;
+		index.Insert(low, high, i);
+		intervals[i] = std::make_pair(low, high);
+		if (i % 3 == 0)
+		{
+			auto victim = intervals.find(std::rand() % (i + 1));
+			if (victim != intervals.end())
+			{
+				if (!index.Erase(victim->second.first, victim->first))
+					return false;
+				intervals.erase(victim);
+			}
+		}
+	}
+
+	bool bIndex = index.size() == intervals.size();
+	for (int low = 0; low < 1100 && bIndex; low += 37)
+	{
+		std::set<unsigned> found, expected;
+		index.ForEachOverlapping(low, low + 20, [&] (unsigned value) { found.insert(value); return true; });
+		for (auto &interval : intervals)
+			if (interval.second.first <= low + 20 && interval.second.second >= low)
+				expected.insert(interval.first);
+		bIndex = found == expected;
+	}
+
+	//the graph keeps it in step with its edges
+	auto t0 = std::chrono::system_clock::from_time_t(1000000);
+	auto fnAt = [t0] (int seconds) { return t0 + std::chrono::seconds(seconds); };
+	ContextGraph cg;
+	for (int i = 0; i < 40; i++)
+		cg.AddEdge(L"v", std::to_wstring(i), std::to_wstring(i + 1), NEVER_EXPIRE, Duration(fnAt(i * 10), fnAt(i * 10 + 5)));
+	auto valid = cg.GetEdgesValidDuring(Duration(fnAt(100), fnAt(112)));
+	auto eleventh = std::find_if(valid.begin(), valid.end(), [] (const CEdge *edge) { return edge->GetSource().GetLabel() == L"11"; });
+	cg.DeleteEdges(eleventh, eleventh + 1);
+	bool bGraph = valid.size() == 2 && cg.GetEdgesValidDuring(Duration(fnAt(100), fnAt(112))).size() == 1 &&
+				  cg.GetEdgesValidDuring(Duration(fnAt(106), fnAt(109))).empty();
+
+	//a narrow validity window matches from the index
+	ContextGraph pattern;
+	pattern.AddEdge(L"v", L"?", L"?");
+	EdgeFilter window;
+	window.SetValidityInterval(Duration(fnAt(200), fnAt(201)));
+	auto match = cg.GetMaximumMatch(pattern, window);
+	bool bMatch = match.size() == 1 && match.begin()->size() == 1 && (*match.begin()->begin())->GetSource().GetLabel() == L"20";
+	window.SetValidityInterval(Duration(fnAt(206), fnAt(209)));
+	bMatch = bMatch && (cg.GetMaximumMatch(pattern, window).empty() || cg.GetMaximumMatch(pattern, window).begin()->empty());
+
+	return bIndex && bGraph && bMatch;
+}
+
+bool Test_RegexAutomaton()
+{
+	//same answers as boost on the syntax it takes, random strings over a small alphabet
+	const wchar_t *regexes[] = { L"e", L"e*", L"!e", L"(ab|a)*b?", L"^[\\w\\s]*1[\\w\\s]*$", L"[^a-c]+", L"a{2,3}b{1,}", L"(?:ab){2}|.", L"\\d\\D*\\.", L"x[]a]*?" };
+	std::srand(11);
+	bool bAgrees = true;
+	for (auto regex : regexes)
+	{
+		RegexAutomaton automaton;
+		boost::wregex expected(regex);
+		bAgrees = bAgrees && automaton.Compile(regex);
+		for (int i = 0; i < 300 && bAgrees; i++)
+		{
+			std::wstring text;
+			for (int length = std::rand() % 7; length > 0; length--)
+				text += L"abce1!. ]x"[std::rand() % 10];
+			bAgrees = automaton.IsMatch(text) == boost::regex_match(text, expected);
+		}
+	}
+	RegexAutomaton automaton;
+	bool bUnsupported = !automaton.Compile(L"(e)\\1") && !automaton.Compile(L"\\bfoo") && !automaton.Compile(L"a(?=b)");
+
+	//a ladder of 30 steps, two parallel edges each: 2^30 edge combinations for a path enumeration
+	ContextGraph cg;
+	for (int i = 0; i < 30; i++)
+	{
+		cg.AddEdge(L"a", std::to_wstring(i), std::to_wstring(i + 1));
+		cg.AddEdge(L"b", std::to_wstring(i), std::to_wstring(i + 1));
+	}
+	auto &first = cg.GetNodeByName(L"0");
+	auto &last = cg.GetNodeByName(L"30");
+	auto all = cg.FindAllOriginalPathsMatchedByRegex(L"a*ba*", first, last);
+	auto max = cg.FindMaxOriginalPathMatchedByRegex(L"a*b{2}a*", first, last);
+	bool bLadder = all.size() == 30 && max.size() == 30 &&
+				   std::count_if(max.begin(), max.end(), [] (const CEdge *edge) { return edge->GetLabel() == L"b"; }) == 2 &&
+				   cg.FindMaxOriginalPathMatchedByRegex(L"a*c", first, last).empty();
+
+	//a back reference goes through boost
+	ContextGraph small;
+	small.AddEdge(L"e", L"1", L"2");
+	small.AddEdge(L"e", L"2", L"3");
+	bool bFallback = small.FindMaxOriginalPathMatchedByRegex(L"(e)\\1", small.GetNodeByName(L"1"), small.GetNodeByName(L"3")).size() == 2;
+
+	return bAgrees && bUnsupported && bLadder && bFallback;
+}
+
+bool Test_PathEnumerator()
+{
+	ContextGraph cg;
+	cg.AddEdge(L"e", L"1", L"2");
+	cg.AddEdge(L"f", L"1", L"2");
+	cg.AddEdge(L"e", L"2", L"3");
+	cg.AddEdge(L"e", L"1", L"3");
+	cg.AddEdge(L"e", L"3", L"1");
+	auto &n1 = cg.GetNodeByName(L"1");
+	auto &n3 = cg.GetNodeByName(L"3");
+	auto fnAll = [] (const std::vector<const CEdge *> &) { return true; };
+	bool bSmall = cg.ForEachPathBetweenNodes(n1, n3, fnAll) == 3 &&
+				  cg.ForEachPathBetweenNodes(n1, n3, fnAll, PathLimits(1)) == 1 &&
+				  cg.ForEachPathBetweenNodes(n1, n3, fnAll, PathLimits(5, 2)) == 2 &&
+				  cg.ForEachPathBetweenNodes(n1, n3, [] (const std::vector<const CEdge *> &) { return false; }) == 1 &&
+				  cg.ForEachPathBetweenNodes(n1, n1, fnAll) == 3;
+
+	//every path from a source, prefixes included
+	ContextGraph::PathEnumerator from(cg, PathLimits(1));
+	from.Reset(n1);
+	size_t fromCount = 0;
+	while (from.Next())
+		fromCount++;
+	bSmall = bSmall && fromCount == 3;
+
+	//a random graph against a recursive count, live and frozen
+	ContextGraph random;
+	std::srand(5);
+	for (int i = 0; i < 60; i++)
+		random.AddEdge(i % 3 ? L"e" : L"f", std::to_wstring(std::rand() % 12), std::to_wstring(std::rand() % 12));
+
+	std::function<size_t(const CNode &, const CNode &, std::set<const CNode *> &, size_t)> countFn =
+		[&] (const CNode &node, const CNode &target, std::set<const CNode *> &onPath, size_t hops) -> size_t
+	{
+		size_t count = 0;
+		auto children = random.GetChildren(node);
+		for (auto child = children.first; child != children.second && hops > 0; child++)
+		{
+			auto &next = child->second->GetDestination();
+			if (&next == &target)
+				count++;
+			else if (onPath.insert(&next).second)
+			{
+				count += countFn(next, target, onPath, hops - 1);
+				onPath.erase(&next);
+			}
+		}
+		return count;
+	};
+
+	bool bRandom = true;
+	for (int i = 0; i < 12 && bRandom; i += 5)
+		for (int j = 0; j < 12 && bRandom; j += 2)
+		{
+			const CNode *source = nullptr, *target = nullptr;
+			if (!random.FindNodeByName(std::to_wstring(i), source) || !random.FindNodeByName(std::to_wstring(j), target))
+				continue;
+			std::set<const CNode *> onPath{ source };
+			auto expected = countFn(*source, *target, onPath, 4);
+			random.Freeze();
+			bRandom = random.ForEachPathBetweenNodes(*source, *target, fnAll, PathLimits(4)) == expected;
+			random.AddEdge(L"g", L"100", L"101");
+			random.RemoveNode(L"100");
+			bRandom = bRandom && !random.IsFrozen() && random.ForEachPathBetweenNodes(*source, *target, fnAll, PathLimits(4)) == expected;
+		}
+
+	return bSmall && bRandom;
+}
+
+bool Test_ReachabilityIndex()
+{
+	//a simple path (or cycle) exists exactly when the target is reachable
+	auto fnCheck = [] (const ContextGraph &cg)
+	{
+		for (auto &n1 : cg.GetNodes())
+			for (auto &n2 : cg.GetNodes())
+				if (cg.IsReachable(n1, n2) != (cg.ForEachPathBetweenNodes(n1, n2, [] (const std::vector<const CEdge *> &) { return false; }) != 0))
+					return false;
+		return true;
+	};
+
+	ContextGraph cg;
+	std::srand(3);
+	for (int i = 0; i < 40; i++)
+		cg.AddEdge(L"e", std::to_wstring(std::rand() % 25), std::to_wstring(std::rand() % 25));
+	cg.BuildReachabilityIndex();
+	bool bBuilt = cg.HasReachabilityIndex() && fnCheck(cg);
+
+	//new arcs keep the index unless they close a cycle, removed ones drop it
+	bool bIncremental = true;
+	for (int i = 0; i < 20 && bIncremental; i++)
+	{
+		cg.AddEdge(L"f", std::to_wstring(std::rand() % 30), std::to_wstring(std::rand() % 30));
+		bIncremental = fnCheck(cg);
+		if (!cg.HasReachabilityIndex())
+			cg.BuildReachabilityIndex();
+	}
+	cg.RemoveNode(L"3");
+	bool bRemoved = !cg.HasReachabilityIndex() && fnCheck(cg);
+	cg.BuildReachabilityIndex();
+	bRemoved = bRemoved && fnCheck(cg);
+
+	//shortest first
+	ContextGraph chain;
+	chain.AddEdge(L"e", L"0", L"1");
+	chain.AddEdge(L"e", L"1", L"2");
+	chain.AddEdge(L"e", L"2", L"3");
+	chain.AddEdge(L"e", L"1", L"3");
+	chain.AddEdge(L"e", L"3", L"0");
+	chain.BuildReachabilityIndex();
+	auto &n0 = chain.GetNodeByName(L"0");
+	auto &n3 = chain.GetNodeByName(L"3");
+	auto paths = chain.GetShortestPaths(n0, n3, 5);
+	bool bShortest = chain.GetShortestPath(n0, n3).size() == 2 && chain.GetShortestPath(n0, n0).size() == 3 &&
+					 paths.size() == 2 && paths[0].size() == 2 && paths[1].size() == 3 && paths[1][2]->GetDestination() == n3;
+
+	return bBuilt && bIncremental && bRemoved && bShortest;
+}
+
+bool Test_ParallelPrecompute()
+{
+	ContextGraph cg;
+	std::srand(9);
+	for (int i = 0; i < 16; i++)
+		cg.AddEdge(L"e", std::to_wstring(std::rand() % 8), std::to_wstring(std::rand() % 8));
+	ContextGraph parallel(cg);
+
+	cg.PrecomputeRoadsBetweenPairOfNodes();
+	parallel.PrecomputeRoadsBetweenPairOfNodes(4);
+
+	//the same roads, in the same order
+	auto fnLabels = [] (const std::vector<CNode const *> &road)
+	{
+		std::wstring labels;
+		for (auto node : road)
+			labels += node->GetLabel() + L",";
+		return labels;
+	};
+	bool bSame = parallel.m_bPathsComplete && cg.m_pathMatrix.size() == parallel.m_pathMatrix.size();
+	size_t roads = 0;
+	for (auto &row : cg.m_pathMatrix)
+		for (auto &cell : row.second)
+		{
+			auto &other = parallel.m_pathMatrix[row.first][cell.first];
+			bSame = bSame && other.size() == cell.second.size() &&
+					std::equal(cell.second.begin(), cell.second.end(), other.begin(), [&] (const std::vector<CNode const *> &l, const std::vector<CNode const *> &r) { return fnLabels(l) == fnLabels(r); });
+			roads += cell.second.size();
+		}
+
+	return bSame && roads > 100;
+}
+
+bool Test_CompiledRegexCache()
+{
+	auto &cache = CompiledRegexCache::Instance();
+	cache.Clear();
+
+	auto first = cache.Get(L"a.*b");
+	auto second = cache.Get(L"a.*b");
+	auto extended = cache.Get(L"a.*b", boost::regex_constants::extended);
+	bool bShared = first == second && first != extended && cache.GetHits() == 1 && cache.GetMisses() == 2 &&
+				   boost::regex_match(std::wstring(L"axxb"), *first);
+
+	//least recently used out first, the evicted regex stays alive for its holders
+	cache.SetCapacity(2);
+	cache.Get(L"a.*b");
+	cache.Get(L"c+");
+	bool bEvicted = cache.size() == 2 && cache.Get(L"a.*b") == first && cache.Get(L"a.*b", boost::regex_constants::extended) != extended &&
+					boost::regex_match(std::wstring(L"ab"), *extended);
+
+	bool bThrown = false;
+	try
+	{
+		cache.Get(L"(a");
+	}
+	catch (const boost::regex_error &)
+	{
+		bThrown = true;
+	}
+	bThrown = bThrown && cache.size() == 2;
+	cache.SetCapacity(CompiledRegexCache::DEFAULT_CAPACITY + 0);
+
+	std::atomic<bool> bConcurrent(true);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; t++)
+		threads.emplace_back([&, t] ()
+		{
+			for (int i = 0; i < 200; i++)
+			{
+				auto pattern = std::to_wstring((i + t) % 50) + L"x*";
+				if (!boost::regex_match(std::to_wstring((i + t) % 50) + L"xx", *cache.Get(pattern)))
+					bConcurrent = false;
+			}
+		});
+	for (auto &thread : threads)
+		thread.join();
+	bConcurrent = bConcurrent && cache.size() == 52;
+
+	//the graph goes through the cache too
+	ContextGraph cg;
+	cg.AddEdge(L"e", L"n1", L"n2");
+	ContextGraph::CNode node(L"");
+	node.SetRegex(L"n.");
+	auto misses = cache.GetMisses();
+	bool bGraph = cg.FindNodesMatchingNodeName(node).size() == 2 && cg.FindNodesMatchingNodeName(node).size() == 2 &&
+				  cache.GetMisses() == misses + 1;
+
+	return bShared && bEvicted && bThrown && bConcurrent && bGraph;
+}
+
+bool Test_RegexPathCache()
+{
+	ContextGraph cg;
+	cg.AddEdge(L"e", L"a", L"b");
+	cg.AddEdge(L"e", L"b", L"c");
+	ContextGraph pattern;
+	ContextGraph::CEdge regexEdge(L"e", pattern._StoreNode(CNode(L"a")), pattern._StoreNode(CNode(L"c")));
+	regexEdge.SetRegex(L"e+");
+	pattern.AddEdge(regexEdge);
+
+	auto fnMatchSize = [&] () { auto match = cg.GetMaximumMatch(pattern); return match.empty() ? size_t(0) : match.begin()->size(); };
+	bool bCached = fnMatchSize() == 2 && cg.m_regexCache.size() == 1 && cg.m_regexCache.GetGeneration() == cg.m_generation;
+
+	//a longer path a -> d -> b -> c, the cached one must not be handed out again
+	cg.AddEdge(L"e", L"a", L"d");
+	cg.AddEdge(L"e", L"d", L"b");
+	bool bInvalidated = fnMatchSize() == 3 && cg.m_regexCache.GetGeneration() == cg.m_generation;
+
+	//the copy keeps the entries, remapped to its own edges
+	ContextGraph copy(cg);
+	bool bCopied = copy.m_regexCache.size() == cg.m_regexCache.size();
+	copy.m_regexCache.ForEach([&] (const std::wstring &, const CNode *source, const CNode *, const std::vector<const CEdge *> &path)
+	{
+		bCopied = bCopied && source == &copy.GetNodeByName(L"a") && path.size() == 3 && &copy.m_edges[path[0]->GetIndex()] == path[0];
+	});
+
+	//cost is one plus the path length, a capacity under it evicts
+	cg.m_regexCache.SetCapacity(3);
+	bool bBounded = cg.m_regexCache.size() == 0 && cg.m_regexCache.GetCost() == 0;
+	cg.m_regexCache.SetCapacity(ContextGraph::RegexCache::DEFAULT_CAPACITY + 0);
+	fnMatchSize();
+	cg.Clear();
+	bBounded = bBounded && cg.m_regexCache.size() == 0;
+
+	return bCached && bInvalidated && bCopied && bBounded;
+}
+
+bool Test_NodeLabelIndex()
+{
+	auto fnLiterals = [] (const std::wstring &regex, const std::wstring &prefix, std::vector<std::wstring> infixes)
+	{
+		NodeLabelIndex::Literals literals;
+		bool bFound = NodeLabelIndex::ExtractLiterals(regex, literals);
+		return bFound == !infixes.empty() && literals.prefix == prefix && literals.infixes == infixes;
+	};
+	bool bLiterals = fnLiterals(L"abc.*def", L"abc", { L"abc", L"def" }) &&
+					 fnLiterals(L"^a*bcd$", L"", { L"bcd" }) &&
+					 fnLiterals(L"x\\.yz{0,1}", L"x.y", { L"x.y" }) &&
+					 fnLiterals(L"ab+[0-9](c|d)efg", L"ab", { L"ab", L"efg" }) &&
+					 fnLiterals(L"ab|cd", L"", { }) &&
+					 fnLiterals(L"(?i)abc", L"", { }) &&
+					 fnLiterals(L"\\w+", L"", { }) &&
+					 fnLiterals(L"ab\\d+cd", L"ab", { L"ab", L"cd" }) &&
+					 fnLiterals(L"\\x41bc", L"", { }) &&
+					 fnLiterals(L"x\\cAyz", L"", { }) &&
+					 fnLiterals(L"x\\012yz", L"", { });
+
+	ContextGraph cg;
+	for (int i = 0; i < 2000; i++)
+		cg.AddEdge(L"e", L"node_" + std::to_wstring(i) + L"_tail", L"node_" + std::to_wstring(i + 1) + L"_tail");
+	//spelled with a hex escape, none of its characters is a literal of the regex
+	cg.AddEdge(L"e", L"Abc", L"node_0_tail");
+	cg.BuildNodeLabelIndex();
+
+	std::vector<std::wstring> regexes = { L"node_1.*", L".*_77_.*", L"[a-z]+_5_tail", L"node_(1|2)_tail", L"nope.*", L"no.*", L"(node)_19+_tail",
+										  L"\\x41bc", L"\\x{41}b.", L"node_\\d+_tail" };
+	auto fnAgrees = [&] ()
+	{
+		bool bAgrees = true;
+		for (auto &regex : regexes)
+		{
+			ContextGraph::CNode node(L"");
+			node.SetRegex(regex);
+			std::vector<const CNode *> expected;
+			boost::wregex compiled(regex);
+			for (auto &n : cg.GetNodes())
+				if (boost::regex_match(n.GetLabel(), compiled))
+					expected.emplace_back(&n);
+			bAgrees = bAgrees && cg.FindNodesMatchingNodeName(node) == expected;
+		}
+		return bAgrees;
+	};
+	bool bIndexed = cg.HasNodeLabelIndex() && fnAgrees();
+
+	//removed nodes leave, reused slots come back with their new labels
+	for (int i = 0; i < 2000; i += 2)
+		cg.RemoveNode(L"node_" + std::to_wstring(i) + L"_tail");
+	bool bRemoved = cg.m_labelIndex.size() == cg.GetNodes().size() && fnAgrees();
+	for (int i = 0; i < 300; i++)
+		cg.AddEdge(L"e", L"other_" + std::to_wstring(i), L"node_1" + std::to_wstring(i) + L"_tail");
+	bool bReused = cg.m_labelIndex.size() == cg.GetNodes().size() && fnAgrees();
+
+	return bLiterals && bIndexed && bRemoved && bReused;
+}
+
+bool Test_GraphLabelDictionary()
+{
+	ContextGraph cg;
+	std::vector<std::wstring> labels = { L"road", L"rail", L"river" };
+	for (int i = 0; i < 300; i++)
+		cg.AddEdge(labels[i % 3], L"city_" + std::to_wstring(i % 40), L"city_" + std::to_wstring((i * 7) % 40));
+	auto &dictionary = cg.m_labelDictionary;
+	bool bDictionary = dictionary.size() == 43;
+
+	//the regex endpoints are tested against the labels, once per label
+	CNode source(L"s"), destination(L"d");
+	source.SetRegex(L"city_1[0-9]");
+	destination.SetRegex(L"city_[0-9]");
+	CEdge edge(L"road", source, destination);
+	ContextGraph pattern;
+	pattern.AddEdge(edge);
+	auto unkNodes = cg._GetPossibleUnknownNodes(pattern);
+	auto edges = cg.GetCorrespondingConcreteEdges(edge, unkNodes);
+	size_t expected = 0;
+	boost::wregex sourceRegex(source.GetLabel()), destinationRegex(destination.GetLabel());
+	for (auto &e : cg.GetEdges())
+		expected += e.GetLabel() == L"road" && boost::regex_match(e.GetSource().GetLabel(), sourceRegex) && boost::regex_match(e.GetDestination().GetLabel(), destinationRegex) ? 1 : 0;
+	auto evaluations = dictionary.GetEvaluationCount();
+	bool bEdges = expected > 0 && edges.size() == expected && evaluations == 2 * dictionary.size() &&
+				  cg.GetCorrespondingConcreteEdges(edge, unkNodes).size() == expected && dictionary.GetEvaluationCount() == evaluations;
+
+	//new labels are the only ones the regexes see again
+	cg.AddEdge(L"road", L"city_15", L"city_100");
+	cg.AddEdge(L"road", L"city_17", L"city_3");
+	bool bExtended = cg.GetCorrespondingConcreteEdges(edge, unkNodes).size() == expected + 1 && dictionary.GetEvaluationCount() == evaluations + 2;
+
+	//a regex node without a literal to look up goes through the dictionary too
+	CNode node(L"n");
+	node.SetRegex(L"[a-z]+_[2-3]");
+	auto nodes = cg.FindNodesMatchingNodeName(node);
+	bool bNodes = nodes.size() == 2 && nodes[0]->GetIndex() < nodes[1]->GetIndex() && nodes[0]->GetLabel() == L"city_2";
+
+	return bDictionary && bEdges && bExtended && bNodes;
+}
+
+bool Test_ConcurrentMaximumMatch()
+{
+	ContextGraph cg;
+	for (int i = 0; i < 12; i++)
+	{
+		cg.AddEdge(L"e", L"c" + std::to_wstring(i), L"c" + std::to_wstring(i + 1));
+		cg.AddEdge(L"f", L"c" + std::to_wstring(i), L"d" + std::to_wstring(i % 4));
+	}
+	ContextGraph pattern;
+	CNode regexNode(L"x");
+	regexNode.SetRegex(L"d[0-9]");
+	pattern.AddEdge(CEdge(L"f", pattern._StoreNode(CNode(L"c2")), pattern._StoreNode(regexNode)));
+	ContextGraph::CEdge regexEdge(L"e", pattern.GetNodeByName(L"c2"), pattern._StoreNode(CNode(L"c9")));
+	regexEdge.SetRegex(L"e+");
+	pattern.AddEdge(regexEdge);
+	cg.BuildNodeLabelIndex();
+
+	//the const overload only reads the graph and the pattern, the threads share both
+	const ContextGraph &shared = cg;
+	auto expected = shared.GetMaximumMatch(pattern, EdgeFilter());
+	std::vector<std::set<std::set<const CEdge *>>> results(4);
+	std::vector<std::thread> threads;
+	for (auto &result : results)
+		threads.emplace_back([&] ()
+		{
+			for (int i = 0; i < 20; i++)
+				result = shared.GetMaximumMatch(pattern, EdgeFilter());
+		});
+	for (auto &thread : threads)
+		thread.join();
+
+	bool bSame = !expected.empty() && expected.begin()->size() == 8;
+	for (auto &result : results)
+		bSame = bSame && result == expected;
+
+	//nothing of a query stays behind in the graph or the pattern
+	bool bRepeated = cg.GetMaximumMatch(pattern) == expected && cg.GetMaximumMatch(pattern) == expected;
+
+	return bSame && bRepeated;
+}
+
+bool Test_ParallelMaximumMatch()
+{
+	bool bSame = true;
+	size_t solutions = 0;
+	for (unsigned int seed = 1; seed <= 4; seed++)
+	{
+		ContextGraph cg;
+		std::srand(seed);
+		for (int i = 0; i < 20; i++)
+			cg.AddEdge(i % 3 ? L"a" : L"b", L"n" + std::to_wstring(std::rand() % 10), L"n" + std::to_wstring(std::rand() % 10));
+
+		//unknown nodes and a regex edge, so every level has a few candidates and there are ties to merge
+		ContextGraph pattern;
+		auto &x = pattern._StoreNode(CNode(L"?x"));
+		auto &y = pattern._StoreNode(CNode(L"?y"));
+		auto &z = pattern._StoreNode(CNode(L"?z"));
+		auto &w = pattern._StoreNode(CNode(L"?w"));
+		pattern.AddEdge(CEdge(L"a", x, y));
+		pattern.AddEdge(CEdge(L"b", y, z));
+		pattern.AddEdge(CEdge(L"a", z, w));
+		ContextGraph::CEdge regexEdge(L"e", w, x);
+		regexEdge.SetRegex(L"(ab?)+");
+		pattern.AddEdge(regexEdge);
+
+		auto expected = cg.GetMaximumMatch(pattern, EdgeFilter());
+		solutions += expected.size();
+		bSame = bSame && !expected.empty() && cg.GetMaximumMatch(pattern, EdgeFilter(), 4) == expected &&
+				cg.GetMaximumMatch(pattern, EdgeFilter(), 0) == expected;
+	}
+
+	return bSame && solutions > 4;
+}
+
+bool Test_MatchBounds()
+{
+	ContextGraph cg;
+	cg.AddEdge(L"e", L"a", L"b");
+	cg.AddEdge(L"e", L"a", L"b");
+	cg.AddEdge(L"e", L"c", L"d");
+	cg.AddEdge(L"f", L"b", L"c");
+	for (int i = 0; i < 30; i++)
+		cg.AddEdge(L"f", L"x" + std::to_wstring(i), L"x" + std::to_wstring(i + 1));
+
+	//three parallel pattern edges with two context edges between any pair, and an edge nothing matches
+	ContextGraph pattern;
+	auto &u = pattern._StoreNode(CNode(L"?u"));
+	auto &v = pattern._StoreNode(CNode(L"?v"));
+	auto &w = pattern._StoreNode(CNode(L"?w"));
+	for (int i = 0; i < 3; i++)
+		pattern.AddEdge(CEdge(L"e", u, v));
+	pattern.AddEdge(CEdge(L"f", v, w));
+	pattern.AddEdge(CEdge(L"g", w, u));
+
+	auto matches = cg.GetMaximumMatch(pattern, EdgeFilter());
+	bool bMatched = matches.size() == 1 && matches.begin()->size() == 3;
+	if (bMatched)
+		for (auto edge : *matches.begin())
+			bMatched = bMatched && (edge->GetLabel() == L"e" ? edge->GetSource().GetLabel() == L"a" : edge->GetSource().GetLabel() == L"b");
+
+	return bMatched && cg.GetMaximumMatch(pattern, EdgeFilter(), 4) == matches;
+}
+
+bool Test_RegexEndDomains()
+{
+	ContextGraph cg;
+	cg.AddEdge(L"a", L"n0", L"n1");
+	cg.AddEdge(L"a", L"n1", L"n2");
+	for (int i = 0; i < 20; i++)
+		cg.AddEdge(L"x", L"m" + std::to_wstring(i), L"m" + std::to_wstring(i + 1));
+	cg.AddEdge(L"x", L"n2", L"m0");
+
+	//only n0 and n1 leave with an a, every pair from the other nodes would be searched for nothing
+	ContextGraph pattern;
+	ContextGraph::CEdge regexEdge(L"e", pattern._StoreNode(CNode(L"?s")), pattern._StoreNode(CNode(L"?d")));
+	regexEdge.SetRegex(L"a+");
+	pattern.AddEdge(regexEdge);
+
+	auto matches = cg.GetMaximumMatch(pattern);
+	bool bMatched = matches.size() == 1 && matches.begin()->size() == 2;
+	bool bNarrowed = cg.m_regexCache.size() > 0 && cg.m_regexCache.size() <= 2 * cg.GetNodes().size();
+
+	//an unknown end can't take a node the pattern names, so with n0 and n1 named the regex edge has no source left
+	ContextGraph named(pattern);
+	named.AddEdge(CEdge(L"a", named._StoreNode(CNode(L"n0")), named._StoreNode(CNode(L"n1"))));
+	auto namedMatches = cg.GetMaximumMatch(named);
+	bool bNamed = namedMatches.size() == 1 && namedMatches.begin()->size() == 1 && (*namedMatches.begin()->begin())->GetSource().GetLabel() == L"n0";
+
+	//the ends of a regex edge added whole are its own nodes, so 1 -(a|b)-> 0 finds the a edge between them
+	ContextGraph small;
+	small.AddEdge(L"a", L"1", L"0");
+	ContextGraph whole;
+	CNode wholeSource(L"1"), wholeDestination(L"0");
+	ContextGraph::CEdge wholeEdge(L"e", wholeSource, wholeDestination);
+	wholeEdge.SetRegex(L"(a|b)");
+	whole.AddEdge(wholeEdge);
+	auto wholeMatches = small.GetMaximumMatch(whole);
+	bool bWhole = wholeMatches.size() == 1 && wholeMatches.begin()->size() == 1;
+
+	return bMatched && bNarrowed && bNamed && bWhole;
+}
+
+bool Test_LabelRelease()
+{
+	auto &dictionary = LabelDictionary::Instance();
+	auto before = dictionary.Size();
+
+	//a label lives as long as a record holds it, the graph or not
+	CNode kept(L"kept_label");
+	LabelId keptId = kept.GetLabelId();
+	{
+		ContextGraph cg;
+		for (int i = 0; i < 100; i++)
+			cg.AddEdge(L"churn_edge_" + std::to_wstring(i), L"churn_" + std::to_wstring(i), L"kept_label");
+		bool bInterned = dictionary.Size() == before + 201;
+		if (!bInterned)
+			return false;
+	}
+	LabelId foundId;
+	bool bReleased = dictionary.Size() == before + 1 && kept.GetLabel() == L"kept_label" &&
+					 dictionary.Find(L"kept_label", foundId) && foundId == keptId && !dictionary.Find(L"churn_0", foundId);
+
+	//a graph that keeps taking in new labels doesn't keep the old ones, nor does its own dictionary; the removed edges kept
+	//are the ones the archive retains
+	ContextGraph cg;
+	cg.m_archive.SetSegmentSize(4);
+	cg.SetArchiveRetention(std::chrono::hours(1), 4);
+	cg.AddEdge(L"e", L"stable_1", L"stable_2");
+	for (int i = 0; i < 1000; i++)
+	{
+		cg.AddEdge(L"e_" + std::to_wstring(i), L"stable_1", L"node_" + std::to_wstring(i));
+		if (i >= 10)
+			cg._DeleteEdge(*cg.FindEdge(L"e_" + std::to_wstring(i - 10), cg.GetNodeByName(L"stable_1"), cg.GetNodeByName(L"node_" + std::to_wstring(i - 10))));
+	}
+	auto evaluations = cg.m_labelDictionary.GetEvaluationCount();
+	auto matched = cg.m_labelDictionary.Match(L"node_.*");
+	size_t matchedCount = 0;
+	cg.m_labelDictionary.ForEach(*matched, [&] (LabelId) { matchedCount++; });
+	bool bChurn = dictionary.Size() <= before + 1 + 3 + 20 + 2 * 8 && cg.m_labelDictionary.size() == 3 + 20 &&
+				  cg.m_labelDictionary.GetEvaluationCount() == evaluations + 3 + 20 && matchedCount == 10;
+
+	//the ids the churn gave back were taken by other labels, the regexes see the labels the graph has now
+	CNode regex(L"r");
+	regex.SetRegex(L"node_[0-9]*");
+	auto nodes = cg.FindNodesMatchingNodeName(regex);
+	bool bReused = nodes.size() == 10 && cg.GetEdgesByName(L"e_995").first != cg.GetEdgesByName(L"e_995").second;
+	for (auto node : nodes)
+		bReused = bReused && node->GetLabel().compare(0, 7, L"node_99") == 0;
+
+	//the text labels of an integer graph are released the same way
+	auto integerBefore = dictionary.Size();
+	{
+		IntegerContextGraph ig;
+		ig._AddEdgeFromText(L"?x", L"1", L"?y", NEVER_EXPIRE, PERMANENT_DURATION);
+		bReused = bReused && dictionary.Size() == integerBefore + 2;
+	}
+	bool bInteger = dictionary.Size() == integerBefore;
+
+	return bReleased && bChurn && bReused && bInteger;
+}
+
+bool Test_EdgeEndpointsStored()
+{
+	ContextGraph cg;
+	cg.AddEdge(L"e", L"1", L"2");
+
+	//edges added whole bring their nodes, so 1 is named by the pattern and no unknown may take it
+	ContextGraph pattern;
+	CNode a(L"?a"), b(L"?b"), n1(L"1");
+	pattern.AddEdge(CEdge(L"e", a, b));
+	pattern.AddEdge(CEdge(L"f", n1, n1));
+	bool bStored = pattern.GetNodes().size() == 3 && &pattern.m_edges.begin()->GetSource() == &pattern.GetNodeByName(L"?a");
+
+	auto matches = cg.GetMaximumMatch(pattern);
+	bool bNamed = matches.size() == 1 && matches.begin()->empty();
+	ContextGraph copy(pattern);
+	auto copyMatches = cg.GetMaximumMatch(copy);
+	bool bCopy = copyMatches.size() == 1 && copyMatches.begin()->empty();
+
+	return bStored && bNamed && bCopy;
+}
+
+//stands for a graph whose eviction is slow, so the timer is torn down while its callback runs
+struct SlowEvictionGraph
+{
+	SlowEvictionGraph() : bInside(false), bLeft(false) { }
+
+	std::chrono::system_clock::time_point GetNextExpirationTime(void) { return std::chrono::system_clock::now(); }
+	size_t EvictExpired(void)
+	{
+		bInside = true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		bLeft = true;
+		return 0;
+	}
+
+	std::atomic<bool> bInside;
+	std::atomic<bool> bLeft;
+};
+
+bool Test_ExpirationTimer()
+{
+	CTimerService service;
+
+	ContextGraph cg;
+	std::mutex mutex;
+	bool bEvicted = false;
+	{
+		TExpirationTimer<ContextGraph> timer(cg, mutex, service);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			cg.AddEdge(L"e", L"1", L"2", std::chrono::system_clock::now() + std::chrono::milliseconds(20));
+			cg.AddEdge(L"f", L"2", L"3");
+			timer.rearm();
+		}
+		for (int i = 0; i < 200 && !bEvicted; i++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			std::lock_guard<std::mutex> lock(mutex);
+			bEvicted = cg.GetEdges().size() == 1;
+		}
+	}
+
+	//the destructor returns only once the callback in flight is done
+	SlowEvictionGraph slow;
+	std::mutex slowMutex;
+	bool bWaited;
+	{
+		TExpirationTimer<SlowEvictionGraph> timer(slow, slowMutex, service);
+		{
+			std::lock_guard<std::mutex> lock(slowMutex);
+			timer.rearm();
+		}
+		while (!slow.bInside)
+			std::this_thread::yield();
+	}
+	bWaited = slow.bLeft;
+
+	return bEvicted && bWaited;
+}
+
 void Test_DeleteEdge()
 {
 	ContextGraph cg;
@@ -1133,6 +2370,60 @@ int main()
 		std::cout << "OK 39 \n";
 	if (Test_BigGraphMatching())
 		std::cout << "OK 40 \n";
+	if (Test_FrozenGraph())
+		std::cout << "OK 41 \n";
+	if (Test_SlabStorage())
+		std::cout << "OK 42 \n";
+	if (Test_IntegerGraph())
+		std::cout << "OK 43 \n";
+	if (Test_AdjacencyIndex())
+		std::cout << "OK 44 \n";
+	if (Test_CompositeEdgeIndex())
+		std::cout << "OK 45 \n";
+	if (Test_CopyAndMove())
+		std::cout << "OK 46 \n";
+	if (Test_FilteredMatch())
+		std::cout << "OK 47 \n";
+	if (Test_ExpirationIndex())
+		std::cout << "OK 48 \n";
+	if (Test_DeleteEdges())
+		std::cout << "OK 49 \n";
+	if (Test_IncrementalPathCache())
+		std::cout << "OK 50 \n";
+	if (Test_TemporalArchive())
+		std::cout << "OK 51 \n";
+	if (Test_IntervalIndex())
+		std::cout << "OK 52 \n";
+	if (Test_RegexAutomaton())
+		std::cout << "OK 53 \n";
+	if (Test_PathEnumerator())
+		std::cout << "OK 54 \n";
+	if (Test_ReachabilityIndex())
+		std::cout << "OK 55 \n";
+	if (Test_ParallelPrecompute())
+		std::cout << "OK 56 \n";
+	if (Test_CompiledRegexCache())
+		std::cout << "OK 57 \n";
+	if (Test_RegexPathCache())
+		std::cout << "OK 58 \n";
+	if (Test_NodeLabelIndex())
+		std::cout << "OK 59 \n";
+	if (Test_GraphLabelDictionary())
+		std::cout << "OK 60 \n";
+	if (Test_ConcurrentMaximumMatch())
+		std::cout << "OK 61 \n";
+	if (Test_ParallelMaximumMatch())
+		std::cout << "OK 62 \n";
+	if (Test_MatchBounds())
+		std::cout << "OK 63 \n";
+	if (Test_RegexEndDomains())
+		std::cout << "OK 64 \n";
+	if (Test_LabelRelease())
+		std::cout << "OK 65 \n";
+	if (Test_EdgeEndpointsStored())
+		std::cout << "OK 66 \n";
+	if (Test_ExpirationTimer())
+		std::cout << "OK 67 \n";
 	
 	return 0;
 }
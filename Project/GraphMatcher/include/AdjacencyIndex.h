@@ -0,0 +1,142 @@
+#pragma once
+
+//answers "is there an edge source -> destination" over node slots
+//a row whose out-degree reaches the density threshold (as a fraction of the slots in use) is kept as a bitmap,
+//sparser rows stay in a hash set, so the memory stays proportional to the edges for sparse graphs
+class AdjacencyIndex
+{
+	typedef uint64_t Word;
+	static const size_t WORD_BITS = 64;
+	//below this many slots a hash set is always smaller than the bitmap bookkeeping
+	static const size_t MIN_BITMAP_SLOTS = 64;
+
+	struct Row
+	{
+		Row() : bDense(false), size(0) { }
+
+		bool bDense;
+		size_t size;
+		std::vector<Word> bits;
+		std::unordered_set<SlotIndex> sparse;
+	};
+
+public:
+	AdjacencyIndex() : m_densityThreshold(1.0 / 64), m_slots(0) { }
+
+	//a threshold above 1 keeps every row hashed, 0 turns every non empty row into a bitmap
+	inline void SetDensityThreshold(/* in */ double threshold)
+	{
+		m_densityThreshold = threshold;
+		for (SlotIndex source = 0; source < m_rows.size(); source++)
+			_Rebalance(m_rows[source]);
+	}
+	inline double GetDensityThreshold(void) const { return m_densityThreshold; }
+
+	inline bool IsAdjacent(/* in */ SlotIndex source, /* in */ SlotIndex destination) const
+	{
+		if (source >= m_rows.size())
+			return false;
+
+		const auto &row = m_rows[source];
+		if (row.bDense)
+		{
+			auto word = destination / WORD_BITS;
+			return word < row.bits.size() && (row.bits[word] >> (destination % WORD_BITS) & 1) != 0;
+		}
+
+		return row.size != 0 && row.sparse.find(destination) != row.sparse.cend();
+	}
+
+	void Set(/* in */ SlotIndex source, /* in */ SlotIndex destination)
+	{
+		_Grow(std::max(source, destination) + 1);
+
+		auto &row = m_rows[source];
+		if (row.bDense)
+		{
+			auto word = destination / WORD_BITS;
+			if (word >= row.bits.size())
+				row.bits.resize(word + 1, 0);
+			auto mask = Word(1) << (destination % WORD_BITS);
+			if (row.bits[word] & mask)
+				return;
+			row.bits[word] |= mask;
+		}
+		else if (!row.sparse.emplace(destination).second)
+			return;
+
+		row.size++;
+		_Rebalance(row);
+	}
+
+	void Reset(/* in */ SlotIndex source, /* in */ SlotIndex destination)
+	{
+		if (!IsAdjacent(source, destination))
+			return;
+
+		auto &row = m_rows[source];
+		if (row.bDense)
+			row.bits[destination / WORD_BITS] &= ~(Word(1) << (destination % WORD_BITS));
+		else
+			row.sparse.erase(destination);
+
+		row.size--;
+		_Rebalance(row);
+	}
+
+	//forgets the row of a released slot, so the slot can be handed out again; a node is released once its edges are gone,
+	//which emptied its column already
+	inline void RemoveNode(/* in */ SlotIndex slot)
+	{
+		if (slot < m_rows.size())
+			m_rows[slot] = Row();
+	}
+
+	inline void Clear(void)
+	{
+		m_rows.clear();
+		m_slots = 0;
+	}
+
+	inline bool IsDense(/* in */ SlotIndex source) const { return source < m_rows.size() && m_rows[source].bDense; }
+
+private:
+	inline void _Grow(/* in */ size_t slots)
+	{
+		if (slots <= m_slots)
+			return;
+
+		m_slots = slots;
+		if (m_rows.size() < slots)
+			m_rows.resize(slots);
+	}
+
+	void _Rebalance(/* inout */ Row &row)
+	{
+		bool bDense = m_slots >= MIN_BITMAP_SLOTS && row.size != 0 && row.size >= m_densityThreshold * m_slots;
+		//half the threshold on the way down, so a row on the edge doesn't flip at every update
+		bool bSparse = !bDense && (!row.bDense || row.size == 0 || row.size < m_densityThreshold * m_slots / 2);
+
+		if (bDense && !row.bDense)
+		{
+			row.bits.assign((m_slots + WORD_BITS - 1) / WORD_BITS, 0);
+			for (auto destination : row.sparse)
+				row.bits[destination / WORD_BITS] |= Word(1) << (destination % WORD_BITS);
+			row.sparse.clear();
+			row.bDense = true;
+		}
+		else if (bSparse && row.bDense)
+		{
+			row.sparse.clear();
+			for (size_t word = 0; word < row.bits.size(); word++)
+				for (auto bits = row.bits[word]; bits != 0; bits &= bits - 1)
+					row.sparse.emplace(static_cast<SlotIndex>(word * WORD_BITS + __builtin_ctzll(bits)));
+			row.bits.clear();
+			row.bDense = false;
+		}
+	}
+
+	std::vector<Row> m_rows;
+	double m_densityThreshold;
+	size_t m_slots;
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <boost/regex.hpp>
+
+//process wide cache of compiled node and edge label regexes, keyed by pattern and syntax flags, least recently used out first
+//the regexes are handed out as shared pointers, so one evicted while in use stays alive for whoever holds it, and since a
+//compiled boost regex is only read while matching, threads share them freely
+//a pattern is compiled outside the lock; two threads missing on the same pattern both compile it and the first one in wins
+class CompiledRegexCache
+{
+public:
+	typedef boost::wregex Regex;
+	typedef std::shared_ptr<const Regex> RegexPtr;
+	typedef boost::regex_constants::syntax_option_type Flags;
+
+	static const size_t DEFAULT_CAPACITY = 1024;
+
+public:
+	static CompiledRegexCache &Instance(void)
+	{
+		static CompiledRegexCache cache;
+		return cache;
+	}
+
+	//throws what boost throws for a pattern that doesn't compile, such patterns aren't cached
+	RegexPtr Get(/* in */ const std::wstring &pattern, /* in_opt */ Flags flags = boost::regex_constants::normal)
+	{
+		Key key(pattern, flags);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto found = m_entries.find(key);
+			if (found != m_entries.end())
+			{
+				m_hits++;
+				m_lru.splice(m_lru.begin(), m_lru, found->second.second);
+				return found->second.first;
+			}
+			m_misses++;
+		}
+
+		RegexPtr regex = std::make_shared<const Regex>(pattern, flags);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto inserted = m_entries.emplace(key, std::make_pair(regex, m_lru.end()));
+		if (!inserted.second)
+			return inserted.first->second.first;
+
+		m_lru.emplace_front(&inserted.first->first);
+		inserted.first->second.second = m_lru.begin();
+		_Evict();
+		return regex;
+	}
+
+	inline void SetCapacity(/* in */ size_t capacity)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_capacity = std::max<size_t>(capacity, 1);
+		_Evict();
+	}
+
+	inline size_t size(void) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_entries.size();
+	}
+
+	inline size_t GetHits(void) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_hits;
+	}
+
+	inline size_t GetMisses(void) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_misses;
+	}
+
+	inline void Clear(void)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_lru.clear();
+		m_entries.clear();
+		m_hits = m_misses = 0;
+	}
+
+private:
+	typedef std::pair<std::wstring, Flags> Key;
+
+	struct KeyHash
+	{
+		inline size_t operator()(/* in */ const Key &key) const { return std::hash<std::wstring>()(key.first) * 31 + static_cast<size_t>(key.second); }
+	};
+
+	//the list holds the keys of the map, most recently used first
+	typedef std::list<const Key *> Lru;
+	typedef std::unordered_map<Key, std::pair<RegexPtr, Lru::iterator>, KeyHash> Entries;
+
+	CompiledRegexCache() : m_capacity(DEFAULT_CAPACITY), m_hits(0), m_misses(0) { }
+	CompiledRegexCache(const CompiledRegexCache &) = delete;
+	CompiledRegexCache &operator =(const CompiledRegexCache &) = delete;
+
+	inline void _Evict(void)
+	{
+		while (m_entries.size() > m_capacity)
+		{
+			m_entries.erase(*m_lru.back());
+			m_lru.pop_back();
+		}
+	}
+
+	mutable std::mutex m_mutex;
+	Lru m_lru;
+	Entries m_entries;
+	size_t m_capacity;
+	size_t m_hits;
+	size_t m_misses;
+};
@@ -3,74 +3,105 @@
 #include "Node.h"
 #include "Statistics.h"
 
-template <typename E, typename N>
+template <typename Policy>
 class Edge
 {
 public:
-	explicit Edge(/* in */ const E &edge,
-		 /* in */ const Node<N> & source,
-		 /* in */ const Node<N> & destination,
+	typedef typename Policy::Label Label;
+	typedef Node<Policy> NodeType;
+
+	explicit Edge(/* in */ const Label &edge,
+		 /* in */ const NodeType & source,
+		 /* in */ const NodeType & destination,
 		 /* in */ std::chrono::system_clock::time_point expireTime = NEVER_EXPIRE,
-		 /* in */ Duration duration = PERMANENT_DURATION,
-		 /* in */ const std::function<const std::wstring(const E &)> toString = 
-		 [] (/* in */ const E &e) { return e; })	
-	:m_edge(edge),
-	 m_label(toString(edge)),
+		 /* in */ Duration duration = PERMANENT_DURATION)
+	:m_labelId(INVALID_LABEL_ID),
+	 m_label(),
+	 m_index(INVALID_SLOT),
+	 m_labelPosition(0),
 	 m_bRegex(false),
-	 m_bAlreadyUsed(false),
 	 m_expireTime(expireTime),
 	 m_duration(duration),
          m_nodes(&source, &destination)
 	{
+		m_labelId = Policy::Intern(edge, m_label);
 		m_expirationFrames.emplace(m_expireTime);
 	}
 
-	Edge(/* in */ const E &edge,
-		 /* in */ const Node<N> && source,
-		 /* in */ const Node<N> && destination,
+	//builds the edge out of its text form, like the dot reader spells it
+	static Edge FromText(/* in */ const std::wstring &text,
+		 /* in */ const NodeType & source,
+		 /* in */ const NodeType & destination,
+		 /* in */ std::chrono::system_clock::time_point expireTime = NEVER_EXPIRE,
+		 /* in */ Duration duration = PERMANENT_DURATION)
+	{
+		Edge edge;
+		edge._SetLabel(text);
+		edge.m_bRegex = false;
+		edge.m_expireTime = expireTime;
+		edge.m_expirationFrames.emplace(expireTime);
+		edge.m_duration = duration;
+		edge.m_nodes = std::make_pair(&source, &destination);
+		return edge;
+	}
+
+	Edge(/* in */ const Label &edge,
+		 /* in */ const NodeType && source,
+		 /* in */ const NodeType && destination,
 		 /* in */ time_t expireTime = 0,
-		 /* in */ Duration duration = PERMANENT_DURATION,
-		 /* in */ const std::function<const std::wstring(const E &)> toString = 
-		 [] (/* in */ const E &e) { return e; }
+		 /* in */ Duration duration = PERMANENT_DURATION
 	) = delete;
-	Edge(/* in */ const E &edge,
-		 /* in */ const Node<N> & source,
-		 /* in */ const Node<N> && destination,
+	Edge(/* in */ const Label &edge,
+		 /* in */ const NodeType & source,
+		 /* in */ const NodeType && destination,
 		 /* in */ time_t expireTime = 0,
-		 /* in */ Duration duration = PERMANENT_DURATION,
-		 /* in */ const std::function<const std::wstring(const E &)> toString = 
-		 [] (/* in */ const E &e) { return e; }
+		 /* in */ Duration duration = PERMANENT_DURATION
 	) = delete;
-	Edge(/* in */ const E &edge,
-		 /* in */ const Node<N> && source,
-		 /* in */ const Node<N> & destination,
+	Edge(/* in */ const Label &edge,
+		 /* in */ const NodeType && source,
+		 /* in */ const NodeType & destination,
 		 /* in */ time_t expireTime = 0,
-		 /* in */ Duration duration = PERMANENT_DURATION,
-		 /* in */ const std::function<const std::wstring(const E &)> toString = 
-		 [] (/* in */ const E &e) { return e; }
+		 /* in */ Duration duration = PERMANENT_DURATION
 	) = delete;
 
-	 Edge(/* in */ const E &edge,
-		  /* in */ const std::function<const std::wstring(const E &)> toString = 
-		  [] (/* in */ const E &e) { return e; }) 
-	 : Edge(edge, NIL, NIL) { }
-
-	inline const std::wstring &GetLabel(void) const { return m_label; }
-	inline const std::pair<const Node<N> *, const Node<N> *>& GetNodes(void) const { return m_nodes; }
-	inline const E& GetEdge(void) const { return m_edge; }
-	inline const Node<N> & GetSource(void) const { return *m_nodes.first; }
-	inline const Node<N> & GetDestination(void) const { return *m_nodes.second; }
+	inline typename Policy::Text GetLabel(void) const { return Policy::ToText(m_labelId, m_label); }
+	inline LabelId GetLabelId(void) const { return m_labelId; }
+	//slot of the record inside the storage of the graph that owns it
+	inline SlotIndex GetIndex(void) const { return m_index; }
+	inline void SetIndex(/* in */ SlotIndex index) { m_index = index; }
+	//position of the record in the label bucket of the graph that owns it, so removing it doesn't search the bucket
+	inline size_t GetLabelPosition(void) const { return m_labelPosition; }
+	inline void SetLabelPosition(/* in */ size_t position) { m_labelPosition = position; }
+	inline const std::pair<const NodeType *, const NodeType *>& GetNodes(void) const { return m_nodes; }
+	inline typename Policy::LabelRef GetEdge(void) const { return Policy::ToLabel(m_labelId, m_label); }
+	inline const NodeType & GetSource(void) const { return *m_nodes.first; }
+	inline const NodeType & GetDestination(void) const { return *m_nodes.second; }
 	inline bool IsRegex(void) const { return m_bRegex; }
-	inline void SetRegex(/* in */ std::wstring regex) { m_bRegex = true; m_label = regex; }
-	inline bool operator== (/* in */ const Edge &other) const { return m_label == other.m_label; }
-	inline bool operator== (/* in */ const std::wstring &label) const { return m_label == label; }
-	inline friend bool operator==(/* in */ const std::wstring &label, /* in */ const Edge &other) { return label == other.m_label; }
-	inline bool FullEqual (/* in */ const Edge &other) const { return m_label == other.m_label && *m_nodes.first == *other.m_nodes.first && *m_nodes.second == *other.m_nodes.second; }
-	inline bool FullEqual (/* in */ const std::wstring &label, /* in */ const CNode &source, /* in */ const CNode &dest) const
-	{ return m_label == label && *m_nodes.first == source && *m_nodes.second == dest; }
-	inline void SetNodes(/* in */ const CNode &source, /* in */ const CNode &dest) { m_nodes.first = &source; m_nodes.second = &dest; }
-	inline void SetAlreayUsed(/* in */ bool bUsed) { m_bAlreadyUsed = bUsed; }
-	inline bool IsAlreadyUsed(void) const { return m_bAlreadyUsed; }
+	inline void SetRegex(/* in */ std::wstring regex) { m_bRegex = true; _SetLabel(regex); }
+	inline bool operator== (/* in */ const Edge &other) const { return m_labelId == other.m_labelId; }
+	inline bool operator== (/* in */ const Label &label) const { return GetEdge() == label; }
+	inline friend bool operator==(/* in */ const Label &label, /* in */ const Edge &other) { return label == other.GetEdge(); }
+	inline bool FullEqual (/* in */ const Edge &other) const { return m_labelId == other.m_labelId && *m_nodes.first == *other.m_nodes.first && *m_nodes.second == *other.m_nodes.second; }
+	inline bool FullEqual (/* in */ LabelId label, /* in */ const NodeType &source, /* in */ const NodeType &dest) const
+	{ return m_labelId == label && *m_nodes.first == source && *m_nodes.second == dest; }
+	inline void SetNodes(/* in */ const NodeType &source, /* in */ const NodeType &dest) { m_nodes.first = &source; m_nodes.second = &dest; }
+	//a copy between other nodes, with a validity of its own; the label reference is shared rather than interned again,
+	//so it works for labels the Label type can't spell, like the text labels of an integer graph
+	Edge CopyWithNodes(/* in */ const NodeType &source,
+					   /* in */ const NodeType &dest,
+					   /* in */ std::chrono::system_clock::time_point expireTime = NEVER_EXPIRE,
+					   /* in */ Duration duration = PERMANENT_DURATION) const
+	{
+		Edge edge(*this);
+		edge.m_index = INVALID_SLOT;
+		edge.m_labelPosition = 0;
+		edge.m_expireTime = expireTime;
+		edge.m_expirationFrames.clear();
+		edge.m_expirationFrames.emplace(expireTime);
+		edge.m_duration = duration;
+		edge.SetNodes(source, dest);
+		return edge;
+	}
 	inline bool IsExpired(void) const { return m_expireTime < std::chrono::system_clock::now(); }
 	void RefreshExpiration(void)
 	{
@@ -82,7 +113,10 @@ public:
 				break;
 		}
 
-		m_expirationFrames.erase(m_expirationFrames.cbegin(), m_expirationFrames.cend());
+		//the last frame stays, GetLastExpirationTime needs one
+		if (exp == m_expirationFrames.end() && exp != m_expirationFrames.begin())
+			exp--;
+		m_expirationFrames.erase(m_expirationFrames.begin(), exp);
 	}
 	
 	inline void AddExpirationTime(/* in */ std::chrono::system_clock::time_point expireTime) 
@@ -102,17 +136,20 @@ public:
 
 public:
 
-	Edge() { };
+	Edge() : m_labelId(INVALID_LABEL_ID), m_label(), m_index(INVALID_SLOT), m_labelPosition(0) { };
+
+	inline void _SetLabel(/* in */ const std::wstring &label) { m_labelId = Policy::InternText(label, m_label); }
 
-	E m_edge;
-        std::wstring m_label;
+	LabelId m_labelId;
+	typename Policy::Stored m_label;
+	SlotIndex m_index;
+	size_t m_labelPosition;
 	bool m_bRegex;
-	bool m_bAlreadyUsed;
 	std::chrono::system_clock::time_point m_expireTime;
 	std::set<std::chrono::system_clock::time_point> m_expirationFrames;
 	Duration m_duration;
-        std::pair<const Node<N> *, const Node<N> *> m_nodes;
+        std::pair<const NodeType *, const NodeType *> m_nodes;
 };
 
-typedef Edge<std::wstring, std::wstring> CEdge;
+typedef Edge<WStringLabelPolicy> CEdge;
 static const CEdge VOID_EDGE = CEdge(L"", NIL, NIL);
@@ -0,0 +1,91 @@
+#pragma once
+
+//non owning view over the edges of a context graph: the matcher runs on the graph itself and skips the edges the filter rejects,
+//so a real time match doesn't rebuild the live graph
+//an empty filter accepts every live edge and lets the matcher keep its shortcuts (regex cache, no archive lookups)
+class EdgeFilter
+{
+public:
+	EdgeFilter() :
+		m_minimumExpireTime(std::chrono::system_clock::time_point::min()),
+		m_validityInterval(PERMANENT_DURATION),
+		m_archiveFrom(std::chrono::system_clock::time_point::min()),
+		m_archiveTo(std::chrono::system_clock::time_point::max()),
+		m_bTimeWindow(false),
+		m_bValidityInterval(false),
+		m_bLabels(false),
+		m_bArchive(false)
+	{ }
+
+	//only the edges still alive at expireTime
+	inline void SetMinimumExpireTime(/* in */ std::chrono::system_clock::time_point expireTime)
+	{
+		m_minimumExpireTime = expireTime;
+		m_bTimeWindow = true;
+	}
+
+	//only the edges whose duration intersects the interval
+	inline void SetValidityInterval(/* in */ Duration interval)
+	{
+		m_validityInterval = interval;
+		m_bValidityInterval = true;
+	}
+
+	inline bool HasValidityInterval(void) const { return m_bValidityInterval; }
+	inline Duration GetValidityInterval(void) const { return m_validityInterval; }
+
+	//only the edges carrying one of the labels
+	template <typename Container>
+	inline void SetLabels(/* in */ const Container &labels)
+	{
+		m_labels.clear();
+		m_labels.insert(std::begin(labels), std::end(labels));
+		m_bLabels = true;
+	}
+
+	//the archived (expired) edges take part in the match too
+	inline void IncludeArchive(/* in */ bool bArchive = true) { m_bArchive = bArchive; }
+	inline bool IsArchiveIncluded(void) const { return m_bArchive; }
+
+	//of the archived edges, only those still in the graph at some point of [from, to] (see TemporalArchive)
+	inline void SetArchiveWindow(/* in */ std::chrono::system_clock::time_point from, /* in */ std::chrono::system_clock::time_point to)
+	{
+		m_archiveFrom = from;
+		m_archiveTo = to;
+		m_bArchive = true;
+	}
+	//the graph as it was at time
+	inline void SetArchiveAsOf(/* in */ std::chrono::system_clock::time_point time) { SetArchiveWindow(time, time); }
+	inline std::chrono::system_clock::time_point GetArchiveFrom(void) const { return m_archiveFrom; }
+	inline std::chrono::system_clock::time_point GetArchiveTo(void) const { return m_archiveTo; }
+
+	inline bool IsEmpty(void) const { return !m_bTimeWindow && !m_bValidityInterval && !m_bLabels && !m_bArchive; }
+
+	template <typename EdgeType>
+	bool Accepts(/* in */ const EdgeType &edge) const
+	{
+		if (m_bLabels && m_labels.find(edge.GetLabelId()) == m_labels.cend())
+			return false;
+		if (m_bTimeWindow && edge.GetLastExpirationTime() < m_minimumExpireTime)
+			return false;
+		if (m_bValidityInterval)
+		{
+			auto duration = edge.GetDuration();
+			if (m_validityInterval.second < duration.first || duration.second < m_validityInterval.first)
+				return false;
+		}
+
+		return true;
+	}
+
+private:
+	std::chrono::system_clock::time_point m_minimumExpireTime;
+	Duration m_validityInterval;
+	std::chrono::system_clock::time_point m_archiveFrom;
+	std::chrono::system_clock::time_point m_archiveTo;
+	std::unordered_set<LabelId> m_labels;
+	bool m_bTimeWindow;
+	bool m_bValidityInterval;
+	bool m_bLabels;
+	bool m_bArchive;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+//min-heap of (expire time, edge slot), so eviction only looks at the edges that are due
+//entries are never updated in place: a moved expiration pushes a new entry and the owner drops the stale ones when they surface
+//a released slot starts a new generation, so the entries of its old edge never pass for those of the edge that reuses it
+class ExpirationIndex
+{
+public:
+	typedef std::chrono::system_clock::time_point TimePoint;
+
+	struct Entry
+	{
+		TimePoint expireTime;
+		SlotIndex slot;
+		uint32_t generation;
+
+		inline bool operator>(/* in */ const Entry &other) const { return expireTime > other.expireTime; }
+	};
+
+public:
+	inline void Push(/* in */ TimePoint expireTime, /* in */ SlotIndex slot)
+	{
+		if (expireTime == NEVER_EXPIRE)
+			return;
+
+		m_heap.push_back(Entry{expireTime, slot, _Generation(slot)});
+		std::push_heap(m_heap.begin(), m_heap.end(), std::greater<Entry>());
+	}
+
+	inline bool empty(void) const { return m_heap.empty(); }
+	inline size_t size(void) const { return m_heap.size(); }
+	inline const Entry &Top(void) const { return m_heap.front(); }
+
+	inline void Pop(void)
+	{
+		std::pop_heap(m_heap.begin(), m_heap.end(), std::greater<Entry>());
+		m_heap.pop_back();
+	}
+
+	inline void Release(/* in */ SlotIndex slot)
+	{
+		if (slot >= m_generations.size())
+			m_generations.resize(slot + 1, 0);
+		m_generations[slot]++;
+	}
+
+	inline bool IsCurrentGeneration(/* in */ const Entry &entry) const { return entry.generation == _Generation(entry.slot); }
+
+	inline void Clear(void)
+	{
+		m_heap.clear();
+		m_generations.clear();
+	}
+
+private:
+	inline uint32_t _Generation(/* in */ SlotIndex slot) const { return slot < m_generations.size() ? m_generations[slot] : 0; }
+
+	std::vector<Entry> m_heap;
+	std::vector<uint32_t> m_generations;
+};
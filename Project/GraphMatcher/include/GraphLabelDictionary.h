@@ -0,0 +1,201 @@
+#pragma once
+
+#include "CompiledRegexCache.h"
+
+//the distinct node and edge labels of one graph, numbered densely in the order they showed up
+//a label regex is run once per label here and not once per node or edge: Match hands out the bitmap of the labels it
+//matches, and a bitmap is extended with the labels added since, so each (regex, label) pair is evaluated once
+//Add and Remove count the records of the graph using a label; a label they all left is forgotten, since the process wide
+//dictionary may give its id to another label, and once the forgotten ones outnumber the others the labels are renumbered
+//and the bitmaps dropped
+//the bitmaps are shared pointers replaced on extension, so const lookups from several threads are safe; adding labels is not
+class GraphLabelDictionary
+{
+public:
+	typedef uint64_t Word;
+	typedef std::vector<Word> Bitmap;
+	typedef std::shared_ptr<const Bitmap> BitmapPtr;
+
+	//past this many regexes the bitmaps are dropped and computed again on demand
+	static const size_t MAX_REGEXES = 1024;
+
+public:
+	GraphLabelDictionary() : m_dead(0), m_evaluations(0) { }
+	GraphLabelDictionary(const GraphLabelDictionary &other) { *this = other; }
+	GraphLabelDictionary(GraphLabelDictionary &&other) { *this = std::move(other); }
+	GraphLabelDictionary &operator =(const GraphLabelDictionary &other)
+	{
+		if (this != &other)
+		{
+			std::lock_guard<std::mutex> lock(other.m_mutex);
+			m_local = other.m_local;
+			m_ids = other.m_ids;
+			m_texts = other.m_texts;
+			m_counts = other.m_counts;
+			m_dead = other.m_dead;
+			m_matches = other.m_matches;
+			m_evaluations = other.m_evaluations;
+		}
+		return *this;
+	}
+	GraphLabelDictionary &operator =(GraphLabelDictionary &&other)
+	{
+		if (this != &other)
+		{
+			std::lock_guard<std::mutex> lock(other.m_mutex);
+			m_local = std::move(other.m_local);
+			m_ids = std::move(other.m_ids);
+			m_texts = std::move(other.m_texts);
+			m_counts = std::move(other.m_counts);
+			m_dead = other.m_dead;
+			m_matches = std::move(other.m_matches);
+			m_evaluations = other.m_evaluations;
+		}
+		return *this;
+	}
+
+	inline void Add(/* in */ LabelId id, /* in */ const std::wstring &text)
+	{
+		auto inserted = m_local.emplace(id, static_cast<uint32_t>(m_ids.size()));
+		if (!inserted.second)
+		{
+			m_counts[inserted.first->second]++;
+			return;
+		}
+
+		m_ids.emplace_back(id);
+		m_texts.emplace_back(text);
+		m_counts.emplace_back(1);
+	}
+
+	//takes back one Add of the label
+	void Remove(/* in */ LabelId id)
+	{
+		auto found = m_local.find(id);
+		if (found == m_local.end() || --m_counts[found->second] > 0)
+			return;
+
+		m_ids[found->second] = INVALID_LABEL_ID;
+		std::wstring().swap(m_texts[found->second]);
+		m_local.erase(found);
+		if (++m_dead * 2 > m_ids.size())
+			_Compact();
+	}
+
+	//the labels the regex matches in full; throws what boost throws for a regex that doesn't compile
+	BitmapPtr Match(/* in */ const std::wstring &regex) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto &match = m_matches[regex];
+		if (match.evaluated == m_ids.size() && match.bitmap)
+			return match.bitmap;
+
+		auto compiled = CompiledRegexCache::Instance().Get(regex);
+		auto bitmap = match.bitmap ? std::make_shared<Bitmap>(*match.bitmap) : std::make_shared<Bitmap>();
+		bitmap->resize((m_ids.size() + 63) / 64, 0);
+		for (auto label = match.evaluated; label < m_ids.size(); label++)
+		{
+			if (m_ids[label] == INVALID_LABEL_ID)
+				continue;
+			if (boost::regex_match(m_texts[label], *compiled))
+				(*bitmap)[label / 64] |= Word(1) << (label % 64);
+			m_evaluations++;
+		}
+
+		if (m_matches.size() > MAX_REGEXES)
+		{
+			m_matches.clear();
+			m_matches[regex].bitmap = bitmap;
+			m_matches[regex].evaluated = m_ids.size();
+			return bitmap;
+		}
+		match.bitmap = bitmap;
+		match.evaluated = m_ids.size();
+		return bitmap;
+	}
+
+	inline bool Test(/* in */ const Bitmap &bitmap, /* in */ LabelId id) const
+	{
+		auto found = m_local.find(id);
+		if (found == m_local.end() || found->second / 64 >= bitmap.size())
+			return false;
+		return (bitmap[found->second / 64] >> (found->second % 64) & 1) != 0;
+	}
+
+	//fn(LabelId) for every label of the bitmap the graph still has
+	template <typename Fn>
+	void ForEach(/* in */ const Bitmap &bitmap, /* in */ Fn fn) const
+	{
+		for (size_t word = 0; word < bitmap.size(); word++)
+			for (auto bits = bitmap[word]; bits != 0; bits &= bits - 1)
+			{
+				size_t bit = 0;
+				while (!(bits >> bit & 1))
+					bit++;
+				if (m_ids[word * 64 + bit] != INVALID_LABEL_ID)
+					fn(m_ids[word * 64 + bit]);
+			}
+	}
+
+	inline size_t size(void) const { return m_local.size(); }
+	//how many times a regex was run against a label
+	inline size_t GetEvaluationCount(void) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_evaluations;
+	}
+
+	inline void Clear(void)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_local.clear();
+		m_ids.clear();
+		m_texts.clear();
+		m_counts.clear();
+		m_dead = 0;
+		m_matches.clear();
+		m_evaluations = 0;
+	}
+
+private:
+	void _Compact(void)
+	{
+		size_t live = 0;
+		for (size_t label = 0; label < m_ids.size(); label++)
+		{
+			if (m_ids[label] == INVALID_LABEL_ID)
+				continue;
+			m_ids[live] = m_ids[label];
+			m_texts[live] = std::move(m_texts[label]);
+			m_counts[live] = m_counts[label];
+			m_local[m_ids[live]] = static_cast<uint32_t>(live);
+			live++;
+		}
+		m_ids.resize(live);
+		m_texts.resize(live);
+		m_counts.resize(live);
+		m_dead = 0;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_matches.clear();
+	}
+
+	struct MatchedLabels
+	{
+		MatchedLabels() : evaluated(0) { }
+
+		BitmapPtr bitmap;
+		//the labels [0, evaluated) are in the bitmap
+		size_t evaluated;
+	};
+
+	std::unordered_map<LabelId, uint32_t> m_local;
+	std::vector<LabelId> m_ids;
+	std::vector<std::wstring> m_texts;
+	//the Adds not taken back, by label
+	std::vector<size_t> m_counts;
+	size_t m_dead;
+	mutable std::mutex m_mutex;
+	mutable std::unordered_map<std::wstring, MatchedLabels> m_matches;
+	mutable size_t m_evaluations;
+};
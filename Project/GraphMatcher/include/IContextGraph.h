@@ -1,22 +1,74 @@
 #pragma once
 
-class IContextGraph
+#include "RegexPathCache.h"
+
+struct NodeLabelHash
+{
+	template <typename NodeType>
+	inline size_t operator()(/* in */ const NodeType &node) const { return std::hash<LabelId>()(node.GetLabelId()); }
+};
+
+struct EdgeLabelHash
+{
+	template <typename EdgeType>
+	inline size_t operator()(/* in */ const EdgeType &edge) const { return std::hash<LabelId>()(edge.GetLabelId()); }
+};
+
+//(label, source, destination) of an edge, all as label ids
+struct EdgeKey
+{
+	EdgeKey(/* in */ LabelId label, /* in */ LabelId source, /* in */ LabelId destination) : label(label), source(source), destination(destination) { }
+
+	inline bool operator==(/* in */ const EdgeKey &other) const
+	{ return label == other.label && source == other.source && destination == other.destination; }
+
+	LabelId label;
+	LabelId source;
+	LabelId destination;
+};
+
+struct EdgeKeyHash
+{
+	inline size_t operator()(/* in */ const EdgeKey &key) const
+	{
+		uint64_t hash = (static_cast<uint64_t>(key.label) << 32 | key.source) * 0x9E3779B97F4A7C15ull;
+		return static_cast<size_t>(hash ^ (hash >> 29) ^ (static_cast<uint64_t>(key.destination) * 0xC2B2AE3D27D4EB4Full));
+	}
+};
+
+//(label, node) packed in one word
+inline uint64_t MakeLabelNodeKey(/* in */ LabelId label, /* in */ LabelId node) { return static_cast<uint64_t>(label) << 32 | node; }
+
+template <typename Policy>
+class BasicIContextGraph
 {
 public:
-	typedef std::unordered_multimap<CNode, const CEdge *, std::function<size_t(const CNode &)>> T;
-	typedef std::unordered_multiset<CEdge, std::function<size_t(const CEdge &)>> TE;
-	typedef std::unordered_set<CNode, std::function<size_t(const CNode &)>> TN;
+	typedef Node<Policy> CNode;
+	typedef Edge<Policy> CEdge;
+	typedef typename Policy::Hash Hash;
+
+	typedef std::unordered_multimap<LabelId, const CEdge *, Hash> T;
+	typedef SlabPool<CEdge> TE;
+	typedef SlabPool<CNode> NodeStore;
+	typedef std::unordered_set<CNode, NodeLabelHash> TN;
+	typedef std::unordered_map<LabelId, const CNode *, Hash> NodeIndex;
 
 	typedef std::vector<const CEdge *> AdjacentEdges;
-	typedef std::unordered_map<CNode, AdjacentEdges, std::function<size_t(const CNode &)>> Row;
-	typedef std::unordered_map<CNode, Row, std::function<size_t(const CNode &)>> AdjacentMatrix;
-	typedef std::unordered_multimap<std::wstring, std::tuple<const CNode *, const CNode *, std::vector<const CEdge *>>> RegexCache;
+	typedef std::unordered_map<LabelId, AdjacentEdges, Hash> EdgesByLabel;
+	typedef std::unordered_map<uint64_t, AdjacentEdges> EdgesByLabelAndNode;
+	typedef std::unordered_map<EdgeKey, AdjacentEdges, EdgeKeyHash> EdgesByKey;
+	typedef std::pair<typename AdjacentEdges::const_iterator, typename AdjacentEdges::const_iterator> EdgeRange;
+	typedef std::unordered_map<LabelId, AdjacentEdges, Hash> Row;
+	typedef std::unordered_map<LabelId, Row, Hash> AdjacentMatrix;
+	typedef RegexPathCache<CNode, CEdge> RegexCache;
 
 public:
 
 	//ordered by size of the path
 	typedef std::multiset<std::vector<CNode const *>, std::function<bool(const std::vector<CNode const *> &, const std::vector<CNode const *> &)>> Paths;
 	typedef std::set<std::vector<const CEdge *>, std::function<bool(const std::vector<const CEdge *> &, const std::vector<const CEdge *> &)>> PointerEdgePaths;
-	typedef std::unordered_map<CNode, Paths, std::function<size_t(const CNode &)>> PathsRow;
-	typedef std::unordered_map<CNode, PathsRow, std::function<size_t(const CNode &)>> AccessibilityMatrix;
-};
\ No newline at end of file
+	typedef std::unordered_map<LabelId, Paths, Hash> PathsRow;
+	typedef std::unordered_map<LabelId, PathsRow, Hash> AccessibilityMatrix;
+};
+
+typedef BasicIContextGraph<WStringLabelPolicy> IContextGraph;
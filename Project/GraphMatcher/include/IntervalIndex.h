@@ -0,0 +1,215 @@
+#pragma once
+
+//closed intervals [low, high] with a value each, in a treap ordered by (low, value) where every node keeps the highest
+//high of its subtree; insert and erase are O(log n) expected and "the intervals overlapping [a, b]" costs O(log n + k)
+template <typename Point, typename Value>
+class IntervalIndex
+{
+	typedef uint32_t Link;
+	static const Link NONE = 0xFFFFFFFFu;
+
+	struct TreeNode
+	{
+		Point low;
+		Point high;
+		Point maxHigh;
+		Value value;
+		uint32_t priority;
+		Link left;
+		Link right;
+	};
+
+public:
+	IntervalIndex() : m_root(NONE), m_free(NONE), m_size(0), m_seed(0x9E3779B9u) { }
+
+	void Insert(/* in */ Point low, /* in */ Point high, /* in */ const Value &value)
+	{
+		Link link = _Allocate();
+		auto &node = m_nodes[link];
+		node.low = low;
+		node.high = high;
+		node.maxHigh = high;
+		node.value = value;
+		node.priority = _NextPriority();
+		node.left = node.right = NONE;
+
+		m_root = _Insert(m_root, link);
+		m_size++;
+	}
+
+	//the interval must be given as inserted, it is part of the key
+	bool Erase(/* in */ Point low, /* in */ const Value &value)
+	{
+		bool bErased = false;
+		m_root = _Erase(m_root, low, value, bErased);
+		if (bErased)
+			m_size--;
+		return bErased;
+	}
+
+	//calls fn(value) for every interval overlapping [low, high]; fn returns false to stop
+	template <typename Fn>
+	void ForEachOverlapping(/* in */ Point low, /* in */ Point high, /* in */ Fn fn) const
+	{
+		if (m_root == NONE)
+			return;
+
+		std::vector<Link> stack(1, m_root);
+		while (!stack.empty())
+		{
+			auto &node = m_nodes[stack.back()];
+			stack.pop_back();
+			//nothing below ends late enough
+			if (node.maxHigh < low)
+				continue;
+
+			if (node.left != NONE)
+				stack.push_back(node.left);
+			//everything to the right starts later still
+			if (high < node.low)
+				continue;
+			if (!(node.high < low) && !fn(node.value))
+				return;
+			if (node.right != NONE)
+				stack.push_back(node.right);
+		}
+	}
+
+	inline size_t size(void) const { return m_size; }
+	inline bool empty(void) const { return m_size == 0; }
+
+	inline void Clear(void)
+	{
+		m_nodes.clear();
+		m_root = m_free = NONE;
+		m_size = 0;
+	}
+
+private:
+	inline static bool _Less(/* in */ const TreeNode &node, /* in */ Point low, /* in */ const Value &value)
+	{ return node.low < low || (!(low < node.low) && node.value < value); }
+
+	inline uint32_t _NextPriority(void)
+	{
+		m_seed ^= m_seed << 13;
+		m_seed ^= m_seed >> 17;
+		m_seed ^= m_seed << 5;
+		return m_seed;
+	}
+
+	Link _Allocate(void)
+	{
+		if (m_free == NONE)
+		{
+			m_nodes.emplace_back();
+			return static_cast<Link>(m_nodes.size() - 1);
+		}
+
+		Link link = m_free;
+		m_free = m_nodes[link].left;
+		return link;
+	}
+
+	inline void _Update(/* in */ Link link)
+	{
+		auto &node = m_nodes[link];
+		node.maxHigh = node.high;
+		if (node.left != NONE && node.maxHigh < m_nodes[node.left].maxHigh)
+			node.maxHigh = m_nodes[node.left].maxHigh;
+		if (node.right != NONE && node.maxHigh < m_nodes[node.right].maxHigh)
+			node.maxHigh = m_nodes[node.right].maxHigh;
+	}
+
+	Link _RotateRight(/* in */ Link link)
+	{
+		Link left = m_nodes[link].left;
+		m_nodes[link].left = m_nodes[left].right;
+		m_nodes[left].right = link;
+		_Update(link);
+		_Update(left);
+		return left;
+	}
+
+	Link _RotateLeft(/* in */ Link link)
+	{
+		Link right = m_nodes[link].right;
+		m_nodes[link].right = m_nodes[right].left;
+		m_nodes[right].left = link;
+		_Update(link);
+		_Update(right);
+		return right;
+	}
+
+	Link _Insert(/* in */ Link root, /* in */ Link link)
+	{
+		if (root == NONE)
+			return link;
+
+		const auto &node = m_nodes[link];
+		if (_Less(node, m_nodes[root].low, m_nodes[root].value))
+		{
+			Link left = _Insert(m_nodes[root].left, link);
+			m_nodes[root].left = left;
+			if (m_nodes[left].priority > m_nodes[root].priority)
+				return _RotateRight(root);
+		}
+		else
+		{
+			Link right = _Insert(m_nodes[root].right, link);
+			m_nodes[root].right = right;
+			if (m_nodes[right].priority > m_nodes[root].priority)
+				return _RotateLeft(root);
+		}
+
+		_Update(root);
+		return root;
+	}
+
+	Link _Erase(/* in */ Link root, /* in */ Point low, /* in */ const Value &value, /* out */ bool &bErased)
+	{
+		if (root == NONE)
+			return NONE;
+
+		auto &node = m_nodes[root];
+		if (_Less(node, low, value))
+			node.right = _Erase(node.right, low, value, bErased);
+		else if (low < node.low || value < node.value)
+			node.left = _Erase(node.left, low, value, bErased);
+		else
+		{
+			bErased = true;
+			Link merged = _Merge(node.left, node.right);
+			node.left = m_free;
+			m_free = root;
+			return merged;
+		}
+
+		_Update(root);
+		return root;
+	}
+
+	Link _Merge(/* in */ Link left, /* in */ Link right)
+	{
+		if (left == NONE)
+			return right;
+		if (right == NONE)
+			return left;
+
+		if (m_nodes[left].priority > m_nodes[right].priority)
+		{
+			m_nodes[left].right = _Merge(m_nodes[left].right, right);
+			_Update(left);
+			return left;
+		}
+
+		m_nodes[right].left = _Merge(left, m_nodes[right].left);
+		_Update(right);
+		return right;
+	}
+
+	std::vector<TreeNode> m_nodes;
+	Link m_root;
+	Link m_free;
+	size_t m_size;
+	uint32_t m_seed;
+};
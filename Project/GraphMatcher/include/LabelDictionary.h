@@ -0,0 +1,155 @@
+#pragma once
+
+typedef uint32_t LabelId;
+const LabelId INVALID_LABEL_ID = std::numeric_limits<LabelId>::max();
+
+//process wide symbol table for node and edge labels
+//every record holds a Ref on its label; the label is released with its last Ref and its id is handed to the next new label,
+//so a graph that keeps churning labels doesn't keep every one it ever saw
+//while a Ref is held both the id and the address of the stored string stay valid
+class LabelDictionary
+{
+	struct Entry
+	{
+		Entry(/* in */ LabelId id) : id(id), refs(0) { }
+
+		LabelId id;
+		std::atomic<uint32_t> refs;
+	};
+	typedef std::unordered_map<std::wstring, Entry> Entries;
+
+public:
+	//shares one interned label; copying takes another reference without the lock of the dictionary
+	class Ref
+	{
+	public:
+		Ref() : m_entry(nullptr) { }
+		Ref(/* in */ const Ref &other) : m_entry(other.m_entry) { _Acquire(); }
+		Ref(/* inout */ Ref &&other) : m_entry(other.m_entry) { other.m_entry = nullptr; }
+		Ref &operator =(/* in */ const Ref &other)
+		{
+			if (m_entry != other.m_entry)
+			{
+				Ref copy(other);
+				std::swap(m_entry, copy.m_entry);
+			}
+			return *this;
+		}
+		Ref &operator =(/* inout */ Ref &&other)
+		{
+			std::swap(m_entry, other.m_entry);
+			return *this;
+		}
+		~Ref() { Reset(); }
+
+		inline void Reset(void)
+		{
+			if (m_entry)
+				LabelDictionary::Instance()._Release(m_entry);
+			m_entry = nullptr;
+		}
+
+		inline const std::wstring &GetText(void) const { return m_entry->first; }
+		inline bool IsEmpty(void) const { return m_entry == nullptr; }
+
+	private:
+		friend class LabelDictionary;
+
+		explicit Ref(/* in */ Entries::value_type *entry) : m_entry(entry) { _Acquire(); }
+
+		inline void _Acquire(void)
+		{
+			if (m_entry)
+				m_entry->second.refs.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		Entries::value_type *m_entry;
+	};
+
+public:
+	//never destroyed, the records of static objects release their labels at exit
+	static LabelDictionary &Instance(void)
+	{
+		static LabelDictionary *dictionary = new LabelDictionary();
+		return *dictionary;
+	}
+
+	LabelId Intern(/* in */ const std::wstring &label, /* out */ Ref &ref)
+	{
+		Ref interned;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			auto found = m_entries.find(label);
+			if (found == m_entries.end())
+			{
+				LabelId id;
+				if (!m_free.empty())
+				{
+					id = m_free.back();
+					m_free.pop_back();
+				}
+				else
+					id = m_next++;
+				found = m_entries.emplace(std::piecewise_construct, std::forward_as_tuple(label), std::forward_as_tuple(id)).first;
+			}
+
+			interned = Ref(&*found);
+		}
+
+		//the old label of ref may be released here, out of the lock
+		ref = std::move(interned);
+		return ref.m_entry->second.id;
+	}
+
+	//doesn't intern the label if it is not already known
+	inline bool Find(/* in */ const std::wstring &label, /* out */ LabelId &id) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto found = m_entries.find(label);
+		if (found == m_entries.cend())
+		{
+			id = INVALID_LABEL_ID;
+			return false;
+		}
+
+		id = found->second.id;
+		return true;
+	}
+
+	//the labels held by a Ref at the moment
+	inline size_t Size(void) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_entries.size();
+	}
+
+private:
+	LabelDictionary() : m_next(0) { }
+	LabelDictionary(const LabelDictionary &) = delete;
+	LabelDictionary &operator =(const LabelDictionary &) = delete;
+
+	//only the last reference takes the lock; a label is interned again (0 -> 1) under the lock only, so once the count
+	//drops to zero there under the lock nobody else can see the entry
+	void _Release(/* in */ Entries::value_type *entry)
+	{
+		auto &refs = entry->second.refs;
+		auto count = refs.load(std::memory_order_relaxed);
+		while (count > 1)
+			if (refs.compare_exchange_weak(count, count - 1, std::memory_order_release, std::memory_order_relaxed))
+				return;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+			return;
+
+		m_free.emplace_back(entry->second.id);
+		m_entries.erase(m_entries.find(entry->first));
+	}
+
+	mutable std::mutex m_mutex;
+	Entries m_entries;
+	std::vector<LabelId> m_free;
+	LabelId m_next;
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "LabelDictionary.h"
+
+//a label policy decides, at compile time, what nodes and edges carry:
+//	Label  - the payload type a caller passes in
+//	Stored - what a record keeps next to its LabelId
+//	LabelRef - how a record hands its label back
+//	Text   - what GetLabel() hands out for regex matching, printing and serialization
+//	Hash   - the hasher of the LabelId keyed indexes
+//text is interned through InternText, so the dot reader, unknown ("?") and regex labels work for every policy
+
+//labels are strings interned in the process wide dictionary; the record keeps a reference on the stored string
+struct WStringLabelPolicy
+{
+	typedef std::wstring Label;
+	typedef LabelDictionary::Ref Stored;
+	typedef const std::wstring &LabelRef;
+	typedef const std::wstring &Text;
+	typedef std::hash<LabelId> Hash;
+
+	inline static LabelId Intern(/* in */ const Label &label, /* out */ Stored &stored)
+	{ return LabelDictionary::Instance().Intern(label, stored); }
+	inline static LabelId InternText(/* in */ const std::wstring &text, /* out */ Stored &stored)
+	{ return Intern(text, stored); }
+	//doesn't intern the label if it is not already known
+	inline static bool Find(/* in */ const Label &label, /* out */ LabelId &id)
+	{ return LabelDictionary::Instance().Find(label, id); }
+	inline static LabelRef ToLabel(/* in */ LabelId, /* in */ const Stored &stored) { return stored.GetText(); }
+	inline static Text ToText(/* in */ LabelId, /* in */ const Stored &stored) { return stored.GetText(); }
+	inline static bool IsUnknown(/* in */ LabelId, /* in */ const Stored &stored)
+	{ return stored.GetText().empty() || stored.GetText().front() == L'?'; }
+};
+
+//labels are integers below 2^31 (TEXT_TAG) and are their own id, so building a record touches neither the dictionary nor its lock
+//text that doesn't spell such a number (unknown and regex labels) is interned and tagged with the high bit, and only such
+//a record holds a reference in the dictionary
+struct IntegerLabelPolicy
+{
+	typedef uint32_t Label;
+	typedef LabelDictionary::Ref Stored;
+	typedef Label LabelRef;
+	typedef std::wstring Text;
+
+	//producers hand out ids in runs, so spread them over the buckets
+	struct Hash
+	{
+		inline size_t operator()(/* in */ LabelId id) const { return static_cast<size_t>(id) * 2654435761u; }
+	};
+
+	static const LabelId TEXT_TAG = 0x80000000u;
+
+	//a label past 2^31 would read as a tagged text id, so it is refused
+	static LabelId Intern(/* in */ const Label &label, /* out */ Stored &stored)
+	{
+		if (label >= TEXT_TAG)
+			throw std::out_of_range("integer label out of range");
+		stored.Reset();
+		return label;
+	}
+	static LabelId InternText(/* in */ const std::wstring &text, /* out */ Stored &stored)
+	{
+		LabelId id;
+		if (_ParseNumber(text, id))
+		{
+			stored.Reset();
+			return id;
+		}
+
+		return LabelDictionary::Instance().Intern(text, stored) | TEXT_TAG;
+	}
+	inline static bool Find(/* in */ const Label &label, /* out */ LabelId &id)
+	{
+		id = label < TEXT_TAG ? label : INVALID_LABEL_ID;
+		return label < TEXT_TAG;
+	}
+	inline static LabelRef ToLabel(/* in */ LabelId id, /* in */ const Stored &) { return id; }
+	inline static Text ToText(/* in */ LabelId id, /* in */ const Stored &stored)
+	{
+		if (id & TEXT_TAG)
+			return stored.GetText();
+		return std::to_wstring(id);
+	}
+	inline static bool IsUnknown(/* in */ LabelId id, /* in */ const Stored &stored)
+	{
+		if (!(id & TEXT_TAG))
+			return false;
+		const auto &text = stored.GetText();
+		return text.empty() || text.front() == L'?';
+	}
+
+private:
+	static bool _ParseNumber(/* in */ const std::wstring &text, /* out */ LabelId &id)
+	{
+		if (text.empty() || text.size() > 10)
+			return false;
+
+		uint64_t value = 0;
+		for (auto c : text)
+		{
+			if (c < L'0' || c > L'9')
+				return false;
+			value = value * 10 + (c - L'0');
+		}
+
+		if (value >= TEXT_TAG)
+			return false;
+
+		id = static_cast<LabelId>(value);
+		return true;
+	}
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+//a value per record of a slab pool, in an array indexed by slot; records the pool doesn't own (archived edges, nodes
+//an edge was added with from outside the graph) go to a side map
+template <typename Record, typename Value>
+class RecordTable
+{
+public:
+	RecordTable(/* in */ const SlabPool<Record> &pool, /* in */ Value none) :
+		m_pool(pool),
+		m_values(pool.GetEndIndex(), none),
+		m_none(none)
+	{ }
+
+	inline Value Get(/* in */ const Record &record) const
+	{
+		if (_IsOwned(record))
+			return m_values[record.GetIndex()];
+		auto found = m_foreign.find(&record);
+		return found != m_foreign.end() ? found->second : m_none;
+	}
+
+	inline void Set(/* in */ const Record &record, /* in */ Value value)
+	{
+		if (_IsOwned(record))
+			m_values[record.GetIndex()] = value;
+		else if (value == m_none)
+			m_foreign.erase(&record);
+		else
+			m_foreign[&record] = value;
+	}
+
+private:
+	inline bool _IsOwned(/* in */ const Record &record) const
+	{
+		auto slot = record.GetIndex();
+		return slot < m_values.size() && m_pool.IsLive(slot) && &m_pool[slot] == &record;
+	}
+
+	const SlabPool<Record> &m_pool;
+	std::vector<Value> m_values;
+	std::unordered_map<const Record *, Value> m_foreign;
+	Value m_none;
+};
+
+//the search state of one GetMaximumMatch query, so the graph and the pattern are only read and any number of queries
+//can run over them at once:
+//	the context nodes already assigned to a pattern node
+//	the context edges already in the partial solution
+//	the context node each pattern node corresponds to
+template <typename Graph>
+class BasicMatchState
+{
+public:
+	typedef typename Graph::CNode CNode;
+	typedef typename Graph::CEdge CEdge;
+
+public:
+	BasicMatchState(/* in */ const Graph &graph, /* in */ const Graph &pattern) :
+		m_assigned(graph.GetNodes(), false),
+		m_used(graph.GetEdges(), false),
+		m_correspondents(pattern.GetNodes(), nullptr)
+	{ }
+
+	inline bool IsAssigned(/* in */ const CNode &node) const { return m_assigned.Get(node); }
+	inline void SetAssigned(/* in */ const CNode &node, /* in */ bool bAssigned) { m_assigned.Set(node, bAssigned); }
+
+	inline bool IsUsed(/* in */ const CEdge &edge) const { return m_used.Get(edge); }
+	inline void SetUsed(/* in */ const CEdge &edge, /* in */ bool bUsed) { m_used.Set(edge, bUsed); }
+
+	//nullptr while the pattern node has no correspondent
+	inline const CNode *GetCorrespondent(/* in */ const CNode &patternNode) const { return m_correspondents.Get(patternNode); }
+	inline void SetCorrespondent(/* in */ const CNode &patternNode, /* in_opt */ const CNode *node) { m_correspondents.Set(patternNode, node); }
+
+private:
+	RecordTable<CNode, bool> m_assigned;
+	RecordTable<CEdge, bool> m_used;
+	RecordTable<CNode, const CNode *> m_correspondents;
+};
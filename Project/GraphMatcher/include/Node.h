@@ -1,44 +1,47 @@
 #pragma once
 
 #include "Statistics.h"
+#include "LabelPolicy.h"
+#include "SlabPool.h"
 
-template <typename N>
+template <typename Policy>
 class Node
 {
 public:
-	Node(/* in */ const N &node,
-		 /* in */ const std::function<const std::wstring(const N &)> toString =
-			   [] (/* in */ const N &n) { return n; })
-	:m_node(node),
-	 m_label(toString(node)),
+	typedef typename Policy::Label Label;
+
+	Node(/* in */ const Label &node)
+	:m_labelId(INVALID_LABEL_ID),
+	 m_label(),
+	 m_index(INVALID_SLOT),
 	 m_bUnknown(false),
-	 m_bHasCorrespondent(false),
-	 m_bHasAssignment(false),
-         m_correspondent(nullptr),
          m_bRegex(false)
 	{
-		if (m_label.empty() || m_label.front() == L'?')
-			m_bUnknown = true;
+		m_labelId = Policy::Intern(node, m_label);
+		m_bUnknown = Policy::IsUnknown(m_labelId, m_label);
 	}
 
-	inline const std::wstring GetLabel(void) const { return m_label; }
-	inline void SetUnknown(/* in */ bool bUnknown = true, std::wstring newLabel = L"") { m_bUnknown = bUnknown; m_label = newLabel; }
+	//builds the node out of its text form, like the dot reader and the unknown labels spell it
+	static Node FromText(/* in */ const std::wstring &text)
+	{
+		Node node;
+		node._SetLabel(text);
+		node.m_bUnknown = Policy::IsUnknown(node.m_labelId, node.m_label);
+		return node;
+	}
+
+	inline typename Policy::Text GetLabel(void) const { return Policy::ToText(m_labelId, m_label); }
+	inline LabelId GetLabelId(void) const { return m_labelId; }
+	//slot of the record inside the storage of the graph that owns it
+	inline SlotIndex GetIndex(void) const { return m_index; }
+	inline void SetIndex(/* in */ SlotIndex index) { m_index = index; }
+	inline void SetUnknown(/* in */ bool bUnknown = true, std::wstring newLabel = L"") { m_bUnknown = bUnknown; _SetLabel(newLabel); }
 	inline bool IsUnknown(void) const { return m_bUnknown; }
-	inline const N& GetNode(void) const { return m_node; }
-	inline bool HasAssignment(void) const { return m_bHasAssignment; }
-	inline void SetAssignment(/* in */ bool bHasAssignment) { m_bHasAssignment = bHasAssignment; }
-	inline bool operator== (/* in */ const Node<N> &other) const { return m_label == other.GetLabel(); }
-	inline bool operator!= (/* in */ const Node<N> &other) const { return m_label != other.GetLabel(); }
+	inline typename Policy::LabelRef GetNode(void) const { return Policy::ToLabel(m_labelId, m_label); }
+	inline bool operator== (/* in */ const Node &other) const { return m_labelId == other.m_labelId; }
+	inline bool operator!= (/* in */ const Node &other) const { return m_labelId != other.m_labelId; }
 	inline bool IsRegex(void) const { return m_bRegex; }
-	inline void SetRegex(/* in */ std::wstring regex) { m_bRegex = true; m_label = regex; }
-	inline void SetCorespondent(/* in */ bool bCorrespondent, /* in */ const Node<N> *correspondent = nullptr) 
-	{ 
-		m_bHasCorrespondent = bCorrespondent;
-		if (correspondent) 
-			m_correspondent = const_cast<Node<N> *>(correspondent); 
-	}
-	inline bool HasCorrespondent(void) const { return m_bHasCorrespondent; }
-	inline const Node<N> &GetCorrespondent(void) const { return *m_correspondent; }
+	inline void SetRegex(/* in */ std::wstring regex) { m_bRegex = true; _SetLabel(regex); }
 
 	friend std::wostream& operator<<(/* inout */ std::wostream &stream, /* in */ const Node &n)
 	{
@@ -47,14 +50,22 @@ public:
 	}
 
 private:
-	N m_node;
-	std::wstring m_label;
+	Node() :
+	 m_labelId(INVALID_LABEL_ID),
+	 m_label(),
+	 m_index(INVALID_SLOT),
+	 m_bUnknown(false),
+         m_bRegex(false)
+	{ }
+
+	inline void _SetLabel(/* in */ const std::wstring &label) { m_labelId = Policy::InternText(label, m_label); }
+
+	LabelId m_labelId;
+	typename Policy::Stored m_label;
+	SlotIndex m_index;
 	bool m_bUnknown;
-        bool m_bHasCorrespondent;
-	bool m_bHasAssignment;
-	Node<N> *m_correspondent;
         bool m_bRegex;
 };
 
-typedef Node<std::wstring> CNode;
+typedef Node<WStringLabelPolicy> CNode;
 static const CNode NIL = CNode(L"?");
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+
+//a set of node slots as a bitmap, the candidate domain of a pattern node while matching
+class NodeBitset
+{
+	typedef uint64_t Word;
+	static const size_t WORD_BITS = 64;
+
+public:
+	NodeBitset() : m_count(0) { }
+	explicit NodeBitset(/* in */ size_t slots) : m_bits((slots + WORD_BITS - 1) / WORD_BITS, 0), m_count(0) { }
+
+	inline bool Test(/* in */ SlotIndex slot) const
+	{
+		return slot / WORD_BITS < m_bits.size() && (m_bits[slot / WORD_BITS] >> (slot % WORD_BITS) & 1) != 0;
+	}
+
+	inline void Set(/* in */ SlotIndex slot)
+	{
+		if (slot / WORD_BITS >= m_bits.size())
+			m_bits.resize(slot / WORD_BITS + 1, 0);
+		auto &word = m_bits[slot / WORD_BITS];
+		auto bit = Word(1) << (slot % WORD_BITS);
+		m_count += (word & bit) ? 0 : 1;
+		word |= bit;
+	}
+
+	//keeps the slots both have, false if none went
+	bool IntersectWith(/* in */ const NodeBitset &other)
+	{
+		auto count = m_count;
+		m_count = 0;
+		for (size_t i = 0; i < m_bits.size(); i++)
+		{
+			m_bits[i] &= i < other.m_bits.size() ? other.m_bits[i] : 0;
+			m_count += _PopCount(m_bits[i]);
+		}
+		return m_count != count;
+	}
+
+	//fn(SlotIndex) for every slot, in increasing order
+	template <typename Fn>
+	void ForEach(/* in */ Fn fn) const
+	{
+		for (size_t i = 0; i < m_bits.size(); i++)
+			for (auto bits = m_bits[i]; bits != 0; bits &= bits - 1)
+			{
+				size_t bit = 0;
+				while (!(bits >> bit & 1))
+					bit++;
+				fn(static_cast<SlotIndex>(i * WORD_BITS + bit));
+			}
+	}
+
+	inline size_t Count(void) const { return m_count; }
+	inline bool IsEmpty(void) const { return m_count == 0; }
+
+private:
+	inline static size_t _PopCount(/* in */ Word word)
+	{
+		size_t count = 0;
+		for (; word != 0; word &= word - 1)
+			count++;
+		return count;
+	}
+
+	std::vector<Word> m_bits;
+	size_t m_count;
+};
@@ -0,0 +1,295 @@
+#pragma once
+
+//narrows the nodes a label regex has to be run on: the labels sorted (for a literal prefix) and the slots by trigram
+//(for a literal anywhere); the caller still runs the full regex on the candidates
+//the literals are those every match must contain, taken from a perl subset: alternations at the top level and inline
+//modifiers give none, and a group, a class or an escape class just ends a literal
+//a removed slot leaves its trigram entries behind (a candidate too many, the regex drops it), they are swept out once
+//they outnumber the live labels
+class NodeLabelIndex
+{
+	typedef std::set<std::pair<std::wstring, SlotIndex>> Labels;
+
+public:
+	struct Literals
+	{
+		//what every match starts with, empty if nothing
+		std::wstring prefix;
+		//the literal runs every match contains, the prefix included
+		std::vector<std::wstring> infixes;
+	};
+
+public:
+	NodeLabelIndex() : m_stale(0), m_bBuilt(false) { }
+
+	//nodes is a container of node records, keyed by their slots
+	template <typename Nodes>
+	void Build(/* in */ const Nodes &nodes)
+	{
+		Clear();
+		m_bBuilt = true;
+		for (auto &node : nodes)
+			Insert(node.GetLabel(), node.GetIndex());
+	}
+
+	inline bool IsBuilt(void) const { return m_bBuilt; }
+
+	void Insert(/* in */ const std::wstring &label, /* in */ SlotIndex slot)
+	{
+		if (!m_bBuilt)
+			return;
+
+		m_labels.emplace(label, slot);
+		_AddTrigrams(label, slot);
+	}
+
+	void Erase(/* in */ const std::wstring &label, /* in */ SlotIndex slot)
+	{
+		if (!m_bBuilt || m_labels.erase(std::make_pair(label, slot)) == 0)
+			return;
+
+		m_stale += label.size() >= 3 ? 1 : 0;
+		if (m_stale > m_labels.size())
+			_SweepTrigrams();
+	}
+
+	//false if the regex has no literal worth looking up, the caller scans every node then; the slots come sorted
+	bool FindCandidates(/* in */ const std::wstring &regex, /* out */ std::vector<SlotIndex> &slots) const
+	{
+		slots.clear();
+		Literals literals;
+		if (!m_bBuilt || !ExtractLiterals(regex, literals))
+			return false;
+
+		auto longest = std::max_element(literals.infixes.begin(), literals.infixes.end(),
+										[] (const std::wstring &l, const std::wstring &r) { return l.size() < r.size(); });
+		if (literals.prefix.empty() && longest->size() < 3)
+			return false;
+
+		if (!literals.prefix.empty() && (literals.prefix.size() >= longest->size() || longest->size() < 3))
+		{
+			auto &prefix = literals.prefix;
+			for (auto label = m_labels.lower_bound(std::make_pair(prefix, SlotIndex(0)));
+				 label != m_labels.end() && label->first.compare(0, prefix.size(), prefix) == 0; label++)
+				slots.emplace_back(label->second);
+		}
+		else
+		{
+			//the rarest trigram of the longest literal
+			const std::vector<SlotIndex> *rarest = nullptr;
+			for (size_t i = 0; i + 3 <= longest->size(); i++)
+			{
+				auto found = m_trigrams.find(_Trigram(longest->data() + i));
+				if (found == m_trigrams.end())
+					return true;
+				if (!rarest || found->second.size() < rarest->size())
+					rarest = &found->second;
+			}
+			slots = *rarest;
+		}
+
+		std::sort(slots.begin(), slots.end());
+		slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+		return true;
+	}
+
+	//false if the regex gives nothing every match must contain
+	static bool ExtractLiterals(/* in */ const std::wstring &regex, /* out */ Literals &literals)
+	{
+		literals = Literals();
+		std::wstring current;
+		bool bAtStart = true;
+		bool bLastLiteral = false;
+		auto fnFlush = [&] ()
+		{
+			if (!current.empty())
+			{
+				if (bAtStart)
+					literals.prefix = current;
+				literals.infixes.emplace_back(std::move(current));
+			}
+			current.clear();
+			bAtStart = false;
+			bLastLiteral = false;
+		};
+
+		size_t i = 0;
+		if (!regex.empty() && regex[0] == L'^')
+			i++;
+		while (i < regex.size())
+		{
+			wchar_t c = regex[i];
+			switch (c)
+			{
+			case L'\\':
+				if (i + 1 == regex.size())
+					return false;
+				//a class escape stands for one unknown character; the others (\x41, \cA, \0nn, \p{L}, backreferences...)
+				//have operands that would be taken for literals, so the regex is left to the scan
+				if (std::wstring(L"wWsSdD").find(regex[i + 1]) != std::wstring::npos)
+					fnFlush();
+				else if (std::iswalnum(regex[i + 1]))
+					return false;
+				else
+				{
+					current += regex[i + 1];
+					bLastLiteral = true;
+				}
+				i += 2;
+				continue;
+			case L'[':
+				fnFlush();
+				if (!_SkipClass(regex, i))
+					return false;
+				continue;
+			case L'(':
+				fnFlush();
+				if (i + 2 < regex.size() && regex[i + 1] == L'?' && (std::iswalpha(regex[i + 2]) || regex[i + 2] == L'-'))
+					return false;
+				if (!_SkipGroup(regex, i))
+					return false;
+				continue;
+			case L')':
+			case L'|':
+				return false;
+			case L'*':
+			case L'?':
+			case L'{':
+			{
+				//the atom before may be missing
+				bool bOptional = true;
+				if (c == L'{')
+				{
+					auto close = regex.find(L'}', i);
+					if (close == std::wstring::npos)
+						return false;
+					bOptional = regex.compare(i + 1, 1, L"0") == 0 || regex[i + 1] == L',';
+					i = close;
+				}
+				if (bLastLiteral && bOptional)
+					current.pop_back();
+				fnFlush();
+				i = _SkipQuantifierSuffix(regex, i + 1);
+				continue;
+			}
+			case L'+':
+				fnFlush();
+				i = _SkipQuantifierSuffix(regex, i + 1);
+				continue;
+			case L'.':
+			case L'^':
+			case L'$':
+				fnFlush();
+				break;
+			default:
+				current += c;
+				bLastLiteral = true;
+				break;
+			}
+			i++;
+		}
+		fnFlush();
+
+		return !literals.infixes.empty();
+	}
+
+	inline size_t size(void) const { return m_labels.size(); }
+
+	inline void Clear(void)
+	{
+		m_labels.clear();
+		m_trigrams.clear();
+		m_stale = 0;
+		m_bBuilt = false;
+	}
+
+private:
+	//three characters of 21 bits
+	inline static uint64_t _Trigram(/* in */ const wchar_t *text)
+	{
+		return (static_cast<uint64_t>(text[0] & 0x1FFFFF) << 42) | (static_cast<uint64_t>(text[1] & 0x1FFFFF) << 21) | static_cast<uint64_t>(text[2] & 0x1FFFFF);
+	}
+
+	void _AddTrigrams(/* in */ const std::wstring &label, /* in */ SlotIndex slot)
+	{
+		for (size_t i = 0; i + 3 <= label.size(); i++)
+		{
+			auto &slots = m_trigrams[_Trigram(label.data() + i)];
+			if (slots.empty() || slots.back() != slot)
+				slots.emplace_back(slot);
+		}
+	}
+
+	void _SweepTrigrams(void)
+	{
+		m_trigrams.clear();
+		m_stale = 0;
+		for (auto &label : m_labels)
+			_AddTrigrams(label.first, label.second);
+	}
+
+	//i is on the '[', it ends past the ']'
+	static bool _SkipClass(/* in */ const std::wstring &regex, /* inout */ size_t &i)
+	{
+		i++;
+		if (i < regex.size() && regex[i] == L'^')
+			i++;
+		//a ']' first is a member
+		if (i < regex.size() && regex[i] == L']')
+			i++;
+		for (; i < regex.size(); i++)
+		{
+			if (regex[i] == L'\\')
+				i++;
+			else if (regex[i] == L']')
+			{
+				i++;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//i is on the '(', it ends past the matching ')'
+	static bool _SkipGroup(/* in */ const std::wstring &regex, /* inout */ size_t &i)
+	{
+		size_t depth = 0;
+		while (i < regex.size())
+		{
+			switch (regex[i])
+			{
+			case L'\\':
+				i += 2;
+				continue;
+			case L'[':
+				if (!_SkipClass(regex, i))
+					return false;
+				continue;
+			case L'(':
+				depth++;
+				break;
+			case L')':
+				if (--depth == 0)
+				{
+					i++;
+					return true;
+				}
+				break;
+			}
+			i++;
+		}
+		return false;
+	}
+
+	//the lazy '?' and possessive '+' after a quantifier
+	inline static size_t _SkipQuantifierSuffix(/* in */ const std::wstring &regex, /* in */ size_t i)
+	{
+		return i < regex.size() && (regex[i] == L'?' || regex[i] == L'+') ? i + 1 : i;
+	}
+
+	Labels m_labels;
+	std::unordered_map<uint64_t, std::vector<SlotIndex>> m_trigrams;
+	//labels of three characters or more erased since the last sweep
+	size_t m_stale;
+	bool m_bBuilt;
+};
@@ -0,0 +1,241 @@
+#pragma once
+
+//bounds of a path enumeration; a hop is an edge
+struct PathLimits
+{
+	PathLimits(/* in */ size_t maxHops = std::numeric_limits<size_t>::max(), /* in */ size_t maxPaths = std::numeric_limits<size_t>::max()) :
+		maxHops(maxHops),
+		maxPaths(maxPaths)
+	{ }
+
+	size_t maxHops;
+	size_t maxPaths;
+};
+
+//hands out the simple paths (no node twice, except the source closing a cycle) of a graph one at a time, as edge sequences,
+//so parallel edges make distinct paths
+//the walk is a depth first search over an explicit stack of child cursors; the marks of the nodes on the path are indexed
+//by node slot and outlive a query, so an enumerator reused for many queries doesn't allocate once it has grown
+//with a destination, a breadth first search back from it first gives every node its hop distance to the destination
+//(within maxHops): the forward walk never steps on a node that can't reach the destination in the hops it has left
+//the graph must not change while an enumeration is running
+template <typename Graph>
+class BasicPathEnumerator
+{
+public:
+	typedef typename Graph::CNode CNode;
+	typedef typename Graph::CEdge CEdge;
+
+private:
+	typedef typename Graph::T::const_iterator ChildIterator;
+	typedef typename Graph::Frozen::Arc Arc;
+
+	//the children of a node not walked yet, from the instance graph or the frozen one
+	struct Frame
+	{
+		const CNode *node;
+		ChildIterator child;
+		ChildIterator childEnd;
+		const Arc *arc;
+		const Arc *arcEnd;
+	};
+
+public:
+	BasicPathEnumerator(/* in */ const Graph &graph, /* in_opt */ PathLimits limits = PathLimits()) :
+		m_graph(graph),
+		m_limits(limits),
+		m_destination(nullptr),
+		m_count(0),
+		m_epoch(0),
+		m_bPendingEdge(false)
+	{ }
+
+	//starts over from source; without a destination every path from source is handed out, the prefixes included
+	bool Reset(/* in */ const CNode &source, /* in_opt */ const CNode *destination = nullptr)
+	{
+		for (auto &frame : m_stack)
+			m_onPath[frame.node->GetIndex()] = false;
+		m_stack.clear();
+		m_edges.clear();
+		m_count = 0;
+		m_bPendingEdge = false;
+		m_destination = nullptr;
+
+		const CNode *start = nullptr;
+		if (!m_graph.FindNodeById(source.GetLabelId(), start))
+			return false;
+		if (destination && !m_graph.FindNodeById(destination->GetLabelId(), m_destination))
+			return false;
+
+		auto slots = m_graph.GetNodes().GetEndIndex();
+		if (m_onPath.size() < slots)
+		{
+			m_onPath.resize(slots, false);
+			m_distance.resize(slots, 0);
+			m_stamp.resize(slots, 0);
+		}
+
+		if (m_destination && !_ComputeDistances(*start))
+			return false;
+
+		_Push(*start);
+		return true;
+	}
+
+	inline void SetLimits(/* in */ PathLimits limits) { m_limits = limits; }
+
+	//moves to the next path; false once there is none left or maxPaths were handed out
+	bool Next(void)
+	{
+		if (m_bPendingEdge)
+		{
+			m_edges.pop_back();
+			m_bPendingEdge = false;
+		}
+		if (m_count >= m_limits.maxPaths)
+			return false;
+
+		while (!m_stack.empty())
+		{
+			const CEdge *edge = _NextChild(m_stack.back());
+			if (!edge)
+			{
+				_Pop();
+				continue;
+			}
+
+			const CNode &child = edge->GetDestination();
+			auto slot = child.GetIndex();
+			bool bTarget = m_destination == &child;
+			size_t hops = m_edges.size() + 1;
+			if (hops > m_limits.maxHops || (!bTarget && m_onPath[slot]))
+				continue;
+			if (m_destination && (m_stamp[slot] != m_epoch || hops + m_distance[slot] > m_limits.maxHops))
+				continue;
+
+			m_edges.emplace_back(edge);
+			//a simple path ends at its destination
+			if (bTarget || hops == m_limits.maxHops)
+				m_bPendingEdge = true;
+			else
+				_Push(child);
+
+			if (bTarget || !m_destination)
+			{
+				m_count++;
+				return true;
+			}
+			if (m_bPendingEdge)
+			{
+				m_edges.pop_back();
+				m_bPendingEdge = false;
+			}
+		}
+
+		return false;
+	}
+
+	inline const std::vector<const CEdge *> &GetEdges(void) const { return m_edges; }
+	inline size_t GetPathCount(void) const { return m_count; }
+
+private:
+	//the hop distances to the destination, up to maxHops; false if source can't get there
+	bool _ComputeDistances(/* in */ const CNode &source)
+	{
+		if (++m_epoch == 0)
+		{
+			std::fill(m_stamp.begin(), m_stamp.end(), 0);
+			m_epoch = 1;
+		}
+
+		m_queue.clear();
+		m_queue.emplace_back(m_destination);
+		m_stamp[m_destination->GetIndex()] = m_epoch;
+		m_distance[m_destination->GetIndex()] = 0;
+		for (size_t next = 0; next < m_queue.size(); next++)
+		{
+			const CNode &node = *m_queue[next];
+			uint32_t distance = m_distance[node.GetIndex()];
+			if (distance >= m_limits.maxHops)
+				continue;
+
+			_ForEachParent(node, [&] (const CEdge *edge)
+			{
+				auto slot = edge->GetSource().GetIndex();
+				if (m_stamp[slot] == m_epoch)
+					return;
+				m_stamp[slot] = m_epoch;
+				m_distance[slot] = distance + 1;
+				m_queue.emplace_back(&edge->GetSource());
+			});
+		}
+
+		return m_stamp[source.GetIndex()] == m_epoch;
+	}
+
+	template <typename Fn>
+	void _ForEachParent(/* in */ const CNode &node, /* in */ Fn fn) const
+	{
+		if (m_graph.IsFrozen())
+		{
+			typename Graph::Frozen::Index index;
+			if (!m_graph.GetFrozenGraph().FindIndex(node, index))
+				return;
+			auto arcs = m_graph.GetFrozenGraph().GetInArcs(index);
+			for (auto arc = arcs.first; arc != arcs.second; arc++)
+				fn(arc->edge);
+			return;
+		}
+
+		auto parents = m_graph.GetParents(node);
+		for (auto parent = parents.first; parent != parents.second; parent++)
+			fn(parent->second);
+	}
+
+	void _Push(/* in */ const CNode &node)
+	{
+		Frame frame = Frame();
+		frame.node = &node;
+		frame.arc = frame.arcEnd = nullptr;
+		typename Graph::Frozen::Index index;
+		if (m_graph.IsFrozen())
+		{
+			if (m_graph.GetFrozenGraph().FindIndex(node, index))
+				std::tie(frame.arc, frame.arcEnd) = m_graph.GetFrozenGraph().GetOutArcs(index);
+		}
+		else
+			std::tie(frame.child, frame.childEnd) = m_graph.GetChildren(node);
+
+		m_onPath[node.GetIndex()] = true;
+		m_stack.emplace_back(frame);
+	}
+
+	void _Pop(void)
+	{
+		m_onPath[m_stack.back().node->GetIndex()] = false;
+		m_stack.pop_back();
+		if (!m_stack.empty())
+			m_edges.pop_back();
+	}
+
+	inline const CEdge *_NextChild(/* inout */ Frame &frame) const
+	{
+		if (m_graph.IsFrozen())
+			return frame.arc != frame.arcEnd ? (frame.arc++)->edge : nullptr;
+		return frame.child != frame.childEnd ? (frame.child++)->second : nullptr;
+	}
+
+	const Graph &m_graph;
+	PathLimits m_limits;
+	const CNode *m_destination;
+	std::vector<Frame> m_stack;
+	std::vector<const CEdge *> m_edges;
+	std::vector<bool> m_onPath;
+	//m_distance[slot] is only meaningful when m_stamp[slot] is the current epoch
+	std::vector<uint32_t> m_distance;
+	std::vector<uint32_t> m_stamp;
+	std::vector<const CNode *> m_queue;
+	size_t m_count;
+	uint32_t m_epoch;
+	bool m_bPendingEdge;
+};
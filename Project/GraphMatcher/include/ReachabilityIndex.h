@@ -0,0 +1,211 @@
+#pragma once
+
+//"is there a path (of one edge or more) from a to b" over node slots, answered with one bit probe
+//the strongly connected components are found with an iterative tarjan, and every component keeps the bitset of the
+//components it reaches; tarjan closes components sinks first, so a component ORs in rows that are already final
+//an arc the index already implies costs nothing, an arc between components that don't close a cycle ORs one row into the
+//rows that reach its source; a removed arc or a new cycle needs a rebuild, AddArc says so by returning false
+//the rows are as wide as the capacity picked at build time, past MAX_COMPONENTS the index refuses to build
+class ReachabilityIndex
+{
+	typedef uint64_t Word;
+	static const size_t WORD_BITS = 64;
+	static const uint32_t NO_COMPONENT = 0xFFFFFFFFu;
+
+public:
+	//a row per component, so the closure takes MAX_COMPONENTS^2 / 8 bytes at most (32MB)
+	static const size_t MAX_COMPONENTS = 16384;
+
+public:
+	ReachabilityIndex() : m_words(0), m_capacity(0), m_components(0), m_bBuilt(false) { }
+
+	//arcs are the (source, destination) slot pairs, each at most once; false if there are too many components
+	bool Build(/* in */ size_t slots, /* in */ const std::vector<std::pair<SlotIndex, SlotIndex>> &arcs)
+	{
+		Clear();
+
+		//the arcs by source, as offsets into one array
+		std::vector<size_t> offsets(slots + 1, 0);
+		for (auto &arc : arcs)
+			offsets[arc.first + 1]++;
+		std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+		std::vector<SlotIndex> targets(arcs.size());
+		std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+		for (auto &arc : arcs)
+			targets[fill[arc.first]++] = arc.second;
+
+		m_component.assign(slots, uint32_t(NO_COMPONENT));
+		std::vector<uint32_t> order(slots, uint32_t(NO_COMPONENT)), low(slots, 0);
+		std::vector<SlotIndex> stack;
+		std::vector<std::pair<SlotIndex, size_t>> calls;
+		std::vector<std::vector<SlotIndex>> members;
+		uint32_t counter = 0;
+
+		for (SlotIndex root = 0; root < slots; root++)
+		{
+			if (order[root] != NO_COMPONENT || offsets[root] == offsets[root + 1])
+				continue;
+
+			calls.emplace_back(root, offsets[root]);
+			order[root] = low[root] = counter++;
+			stack.emplace_back(root);
+			while (!calls.empty())
+			{
+				auto node = calls.back().first;
+				auto &next = calls.back().second;
+				if (next < offsets[node + 1])
+				{
+					auto child = targets[next++];
+					if (order[child] == NO_COMPONENT)
+					{
+						order[child] = low[child] = counter++;
+						stack.emplace_back(child);
+						calls.emplace_back(child, offsets[child]);
+					}
+					else if (m_component[child] == NO_COMPONENT)
+						low[node] = std::min(low[node], order[child]);
+					continue;
+				}
+
+				calls.pop_back();
+				if (!calls.empty())
+					low[calls.back().first] = std::min(low[calls.back().first], low[node]);
+				if (low[node] != order[node])
+					continue;
+
+				//node is the root of a component, its members are on top of the stack
+				auto id = static_cast<uint32_t>(members.size());
+				members.emplace_back();
+				SlotIndex member;
+				do
+				{
+					member = stack.back();
+					stack.pop_back();
+					m_component[member] = id;
+					members.back().emplace_back(member);
+				} while (member != node);
+
+				if (members.size() > MAX_COMPONENTS)
+				{
+					Clear();
+					return false;
+				}
+			}
+		}
+
+		m_components = members.size();
+		_Allocate(std::min(size_t(MAX_COMPONENTS), std::max(size_t(WORD_BITS), m_components * 2)));
+
+		//components come sinks first, so the rows of the children are done
+		for (uint32_t id = 0; id < m_components; id++)
+		{
+			Word *row = _Row(id);
+			for (auto member : members[id])
+				for (auto arc = offsets[member]; arc < offsets[member + 1]; arc++)
+				{
+					auto child = m_component[targets[arc]];
+					_Set(row, child);
+					if (child != id)
+						_Or(row, _Row(child));
+				}
+		}
+
+		m_bBuilt = true;
+		return true;
+	}
+
+	//false when the arc can't be absorbed (the index is cleared then and needs a Build)
+	bool AddArc(/* in */ SlotIndex source, /* in */ SlotIndex destination)
+	{
+		if (!m_bBuilt)
+			return false;
+
+		uint32_t from, to;
+		if (!_ComponentOf(source, from) || !_ComponentOf(destination, to))
+		{
+			Clear();
+			return false;
+		}
+		if (_Test(_Row(from), to))
+			return true;
+		if (from != to && _Test(_Row(to), from))
+		{
+			//a new cycle merges components
+			Clear();
+			return false;
+		}
+
+		//whatever reaches from now reaches to, and what to reaches
+		std::vector<Word> added(_Row(to), _Row(to) + m_words);
+		_Set(added.data(), to);
+		for (uint32_t id = 0; id < m_components; id++)
+			if (id == from || _Test(_Row(id), from))
+				_Or(_Row(id), added.data());
+		return true;
+	}
+
+	inline bool IsReachable(/* in */ SlotIndex source, /* in */ SlotIndex destination) const
+	{
+		if (source >= m_component.size() || destination >= m_component.size())
+			return false;
+		auto from = m_component[source];
+		auto to = m_component[destination];
+		return from != NO_COMPONENT && to != NO_COMPONENT && _Test(_Row(from), to);
+	}
+
+	inline bool IsBuilt(void) const { return m_bBuilt; }
+	inline size_t GetComponentCount(void) const { return m_components; }
+
+	inline void Clear(void)
+	{
+		m_component.clear();
+		m_rows.clear();
+		m_words = 0;
+		m_capacity = 0;
+		m_components = 0;
+		m_bBuilt = false;
+	}
+
+private:
+	inline void _Allocate(/* in */ size_t capacity)
+	{
+		m_capacity = capacity;
+		m_words = (capacity + WORD_BITS - 1) / WORD_BITS;
+		m_rows.assign(m_words * capacity, 0);
+	}
+
+	inline Word *_Row(/* in */ uint32_t id) { return &m_rows[id * m_words]; }
+	inline const Word *_Row(/* in */ uint32_t id) const { return &m_rows[id * m_words]; }
+	inline static bool _Test(/* in */ const Word *row, /* in */ uint32_t id) { return (row[id / WORD_BITS] >> (id % WORD_BITS) & 1) != 0; }
+	inline static void _Set(/* inout */ Word *row, /* in */ uint32_t id) { row[id / WORD_BITS] |= Word(1) << (id % WORD_BITS); }
+	inline void _Or(/* inout */ Word *row, /* in */ const Word *other) const
+	{
+		for (size_t word = 0; word < m_words; word++)
+			row[word] |= other[word];
+	}
+
+	//a slot the index hasn't seen is an isolated node so far, it gets a component of its own while there is room
+	bool _ComponentOf(/* in */ SlotIndex slot, /* out */ uint32_t &id)
+	{
+		if (slot >= m_component.size())
+			m_component.resize(slot + 1, uint32_t(NO_COMPONENT));
+		if (m_component[slot] == NO_COMPONENT)
+		{
+			if (m_components == m_capacity)
+				return false;
+			m_component[slot] = static_cast<uint32_t>(m_components++);
+		}
+
+		id = m_component[slot];
+		return true;
+	}
+
+	//component of every slot, NO_COMPONENT for the slots without arcs
+	std::vector<uint32_t> m_component;
+	//m_capacity rows of m_words words
+	std::vector<Word> m_rows;
+	size_t m_words;
+	size_t m_capacity;
+	size_t m_components;
+	bool m_bBuilt;
+};
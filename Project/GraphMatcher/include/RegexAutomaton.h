@@ -0,0 +1,541 @@
+#pragma once
+
+//an edge label regex compiled to an automaton, for walking the graph one edge label at a time instead of matching whole paths
+//the regex is parsed into a thompson nfa and determinised lazily: a dfa state is a set of nfa states, made the first time
+//a character leads to it, so only the part of the dfa the graph labels really exercise is ever built
+//the syntax is the part of perl's that a finite automaton can do: literals, ., classes, \w \s \d and their negations, groups,
+//alternation, * + ? {n,m} (lazy or not, a full match doesn't care) and ^ / $ at the ends; anything else (back references,
+//look arounds, word boundaries...) makes Compile fail, and the caller falls back to boost::regex
+class RegexAutomaton
+{
+public:
+	typedef uint32_t StateId;
+
+	//the empty set of nfa states, nothing can match from it
+	static const StateId DEAD = 0;
+	//counted repetitions are unrolled, this bounds the nfa they blow up into
+	static const size_t MAX_NFA_STATES = 1 << 16;
+
+public:
+	RegexAutomaton() : m_start(DEAD) { }
+
+	bool Compile(/* in */ const std::wstring &regex)
+	{
+		m_sets.clear();
+		m_nfa.clear();
+		m_dfa.clear();
+		m_dfaIds.clear();
+		m_start = DEAD;
+
+		Parser parser(regex, m_sets);
+		auto root = parser.Parse();
+		if (!root)
+			return false;
+
+		m_nfa.emplace_back(NfaState());
+		m_nfa[0].bMatch = true;
+		uint32_t start = 0;
+		if (!_Build(*root, 0, start))
+		{
+			m_nfa.clear();
+			return false;
+		}
+
+		_AddDfaState(std::vector<uint32_t>());
+		std::vector<uint32_t> closure(1, start);
+		_Close(closure);
+		m_start = _AddDfaState(closure);
+		return true;
+	}
+
+	inline StateId Start(void) const { return m_start; }
+	inline bool IsAccepting(/* in */ StateId state) const { return m_dfa[state].bAccepting; }
+
+	StateId Step(/* in */ StateId state, /* in */ wchar_t c)
+	{
+		if (state == DEAD)
+			return DEAD;
+
+		auto found = m_dfa[state].next.find(c);
+		if (found != m_dfa[state].next.end())
+			return found->second;
+
+		std::vector<uint32_t> next;
+		for (auto nfaState : m_dfa[state].nfaStates)
+		{
+			auto &nfa = m_nfa[nfaState];
+			if (nfa.set != NO_SET && m_sets[nfa.set].Contains(c))
+				next.emplace_back(nfa.out);
+		}
+		_Close(next);
+
+		StateId id = _AddDfaState(next);
+		m_dfa[state].next.emplace(c, id);
+		return id;
+	}
+
+	//feeds a whole edge label, stops as soon as nothing can match any more
+	StateId Step(/* in */ StateId state, /* in */ const std::wstring &text)
+	{
+		for (auto c = text.cbegin(); c != text.cend() && state != DEAD; ++c)
+			state = Step(state, *c);
+		return state;
+	}
+
+	bool IsMatch(/* in */ const std::wstring &text)
+	{ return IsAccepting(Step(m_start, text)); }
+
+	inline size_t GetDfaStateCount(void) const { return m_dfa.size(); }
+
+private:
+	static const uint32_t NO_SET = 0xFFFFFFFFu;
+	static const uint32_t UNBOUNDED = 0xFFFFFFFFu;
+
+	struct CharSet
+	{
+		enum { WORD = 1, SPACE = 2, DIGIT = 4 };
+
+		CharSet() : classes(0), negatedClasses(0), bNegated(false) { }
+
+		inline static bool IsWord(/* in */ wchar_t c) { return std::iswalnum(c) || c == L'_'; }
+
+		bool Contains(/* in */ wchar_t c) const
+		{
+			bool bIn = false;
+			for (auto &range : ranges)
+				bIn = bIn || (range.first <= c && c <= range.second);
+			bIn = bIn ||
+				((classes & WORD) && IsWord(c)) || ((negatedClasses & WORD) && !IsWord(c)) ||
+				((classes & SPACE) && std::iswspace(c)) || ((negatedClasses & SPACE) && !std::iswspace(c)) ||
+				((classes & DIGIT) && std::iswdigit(c)) || ((negatedClasses & DIGIT) && !std::iswdigit(c));
+			return bIn != bNegated;
+		}
+
+		std::vector<std::pair<wchar_t, wchar_t>> ranges;
+		unsigned classes;
+		unsigned negatedClasses;
+		bool bNegated;
+	};
+
+	struct Ast
+	{
+		enum Kind { CHARS, CONCAT, ALTERNATE, REPEAT };
+
+		Ast(/* in */ Kind kind) : kind(kind), set(NO_SET), min(0), max(0) { }
+
+		Kind kind;
+		uint32_t set;
+		uint32_t min;
+		uint32_t max;
+		std::vector<std::unique_ptr<Ast>> children;
+	};
+
+	//recursive descent over alternation, concatenation, repetition and atoms; a null tree means the syntax isn't supported
+	class Parser
+	{
+	public:
+		Parser(/* in */ const std::wstring &regex, /* inout */ std::vector<CharSet> &sets) : m_regex(regex), m_sets(sets), m_pos(0), m_end(regex.size()) { }
+
+		std::unique_ptr<Ast> Parse(void)
+		{
+			//a full match is anchored at both ends anyway
+			if (m_pos < m_end && m_regex[m_pos] == L'^')
+				m_pos++;
+			if (m_end > m_pos && m_regex[m_end - 1] == L'$' && !_IsEscaped(m_end - 1))
+				m_end--;
+
+			auto root = _ParseAlternation();
+			if (!root || m_pos != m_end)
+				return nullptr;
+			return root;
+		}
+
+	private:
+		bool _IsEscaped(/* in */ size_t pos) const
+		{
+			size_t backslashes = 0;
+			while (pos > backslashes && m_regex[pos - backslashes - 1] == L'\\')
+				backslashes++;
+			return backslashes % 2 == 1;
+		}
+
+		inline bool _AtEnd(void) const { return m_pos >= m_end; }
+		inline wchar_t _Peek(void) const { return m_regex[m_pos]; }
+
+		std::unique_ptr<Ast> _ParseAlternation(void)
+		{
+			auto first = _ParseConcatenation();
+			if (!first || _AtEnd() || _Peek() != L'|')
+				return first;
+
+			std::unique_ptr<Ast> alternation(new Ast(Ast::ALTERNATE));
+			alternation->children.emplace_back(std::move(first));
+			while (!_AtEnd() && _Peek() == L'|')
+			{
+				m_pos++;
+				auto next = _ParseConcatenation();
+				if (!next)
+					return nullptr;
+				alternation->children.emplace_back(std::move(next));
+			}
+
+			return alternation;
+		}
+
+		std::unique_ptr<Ast> _ParseConcatenation(void)
+		{
+			std::unique_ptr<Ast> concatenation(new Ast(Ast::CONCAT));
+			while (!_AtEnd() && _Peek() != L'|' && _Peek() != L')')
+			{
+				auto repetition = _ParseRepetition();
+				if (!repetition)
+					return nullptr;
+				concatenation->children.emplace_back(std::move(repetition));
+			}
+
+			return concatenation;
+		}
+
+		std::unique_ptr<Ast> _ParseRepetition(void)
+		{
+			auto atom = _ParseAtom();
+			while (atom && !_AtEnd())
+			{
+				uint32_t min, max;
+				wchar_t c = _Peek();
+				if (c == L'*')
+					min = 0, max = UNBOUNDED;
+				else if (c == L'+')
+					min = 1, max = UNBOUNDED;
+				else if (c == L'?')
+					min = 0, max = 1;
+				else if (c == L'{')
+				{
+					if (!_ParseCount(min, max))
+						return nullptr;
+					m_pos--;
+				}
+				else
+					break;
+				m_pos++;
+
+				//lazy is the same language; possessive isn't
+				if (!_AtEnd() && _Peek() == L'?')
+					m_pos++;
+				else if (!_AtEnd() && _Peek() == L'+')
+					return nullptr;
+
+				std::unique_ptr<Ast> repeat(new Ast(Ast::REPEAT));
+				repeat->min = min;
+				repeat->max = max;
+				repeat->children.emplace_back(std::move(atom));
+				atom = std::move(repeat);
+			}
+
+			return atom;
+		}
+
+		//{n}, {n,} or {n,m}; leaves m_pos past the closing brace
+		bool _ParseCount(/* out */ uint32_t &min, /* out */ uint32_t &max)
+		{
+			m_pos++;
+			if (!_ParseNumber(min))
+				return false;
+			max = min;
+			if (!_AtEnd() && _Peek() == L',')
+			{
+				m_pos++;
+				max = UNBOUNDED;
+				if (!_AtEnd() && _Peek() != L'}' && !_ParseNumber(max))
+					return false;
+			}
+			if (_AtEnd() || _Peek() != L'}' || max < min)
+				return false;
+			m_pos++;
+			return true;
+		}
+
+		bool _ParseNumber(/* out */ uint32_t &number)
+		{
+			size_t start = m_pos;
+			number = 0;
+			while (!_AtEnd() && std::iswdigit(_Peek()) && number < MAX_NFA_STATES)
+				number = number * 10 + (m_regex[m_pos++] - L'0');
+			return m_pos != start && number < MAX_NFA_STATES;
+		}
+
+		std::unique_ptr<Ast> _Chars(/* in */ CharSet set)
+		{
+			std::unique_ptr<Ast> chars(new Ast(Ast::CHARS));
+			chars->set = static_cast<uint32_t>(m_sets.size());
+			m_sets.emplace_back(std::move(set));
+			return chars;
+		}
+
+		std::unique_ptr<Ast> _ParseAtom(void)
+		{
+			wchar_t c = m_regex[m_pos++];
+			CharSet set;
+			switch (c)
+			{
+			case L'(':
+			{
+				if (!_AtEnd() && _Peek() == L'?')
+				{
+					if (m_pos + 1 >= m_end || m_regex[m_pos + 1] != L':')
+						return nullptr;
+					m_pos += 2;
+				}
+				auto group = _ParseAlternation();
+				if (!group || _AtEnd() || _Peek() != L')')
+					return nullptr;
+				m_pos++;
+				return group;
+			}
+			case L'[':
+				return _ParseClass();
+			case L'.':
+				set.bNegated = true;
+				return _Chars(std::move(set));
+			case L'\\':
+				if (_AtEnd() || !_ParseEscape(set))
+					return nullptr;
+				return _Chars(std::move(set));
+			case L'*': case L'+': case L'?': case L'{': case L'^': case L'$':
+				return nullptr;
+			default:
+				set.ranges.emplace_back(c, c);
+				return _Chars(std::move(set));
+			}
+		}
+
+		//the character after a backslash, outside or inside a class
+		bool _ParseEscape(/* inout */ CharSet &set)
+		{
+			wchar_t c = m_regex[m_pos++];
+			wchar_t literal = c;
+			switch (c)
+			{
+			case L'w': set.classes |= CharSet::WORD; return true;
+			case L's': set.classes |= CharSet::SPACE; return true;
+			case L'd': set.classes |= CharSet::DIGIT; return true;
+			case L'W': set.negatedClasses |= CharSet::WORD; return true;
+			case L'S': set.negatedClasses |= CharSet::SPACE; return true;
+			case L'D': set.negatedClasses |= CharSet::DIGIT; return true;
+			case L'n': literal = L'\n'; break;
+			case L't': literal = L'\t'; break;
+			case L'r': literal = L'\r'; break;
+			case L'f': literal = L'\f'; break;
+			case L'v': literal = L'\v'; break;
+			default:
+				//letters and digits are the escapes that mean something else (\b, \1, \x...)
+				if (std::iswalnum(c))
+					return false;
+			}
+
+			set.ranges.emplace_back(literal, literal);
+			return true;
+		}
+
+		std::unique_ptr<Ast> _ParseClass(void)
+		{
+			CharSet set;
+			if (!_AtEnd() && _Peek() == L'^')
+			{
+				set.bNegated = true;
+				m_pos++;
+			}
+
+			bool bFirst = true;
+			while (!_AtEnd() && (_Peek() != L']' || bFirst))
+			{
+				bFirst = false;
+				wchar_t c = m_regex[m_pos++];
+				if (c == L'[' && !_AtEnd() && (_Peek() == L':' || _Peek() == L'=' || _Peek() == L'.'))
+					return nullptr;
+				if (c == L'\\')
+				{
+					if (_AtEnd())
+						return nullptr;
+					CharSet escaped;
+					if (!_ParseEscape(escaped))
+						return nullptr;
+					set.classes |= escaped.classes;
+					set.negatedClasses |= escaped.negatedClasses;
+					if (escaped.ranges.empty())
+						continue;
+					c = escaped.ranges.front().first;
+				}
+
+				wchar_t last = c;
+				if (m_pos + 1 < m_end && _Peek() == L'-' && m_regex[m_pos + 1] != L']')
+				{
+					m_pos++;
+					last = m_regex[m_pos++];
+					if (last == L'\\' || last == L'[' || last < c)
+						return nullptr;
+				}
+				set.ranges.emplace_back(c, last);
+			}
+
+			if (_AtEnd())
+				return nullptr;
+			m_pos++;
+			return _Chars(std::move(set));
+		}
+
+		const std::wstring &m_regex;
+		std::vector<CharSet> &m_sets;
+		size_t m_pos;
+		size_t m_end;
+	};
+
+	//an nfa state either matches a character set and goes to out, or moves on epsilon to any of its epsilons
+	struct NfaState
+	{
+		NfaState() : set(NO_SET), out(0), bMatch(false) { }
+
+		uint32_t set;
+		uint32_t out;
+		std::vector<uint32_t> epsilons;
+		bool bMatch;
+	};
+
+	struct DfaState
+	{
+		std::vector<uint32_t> nfaStates;
+		std::unordered_map<wchar_t, StateId> next;
+		bool bAccepting;
+	};
+
+	inline uint32_t _NewState(void)
+	{
+		m_nfa.emplace_back(NfaState());
+		return static_cast<uint32_t>(m_nfa.size() - 1);
+	}
+
+	inline uint32_t _NewSplit(/* in */ uint32_t first, /* in */ uint32_t second)
+	{
+		auto split = _NewState();
+		m_nfa[split].epsilons.emplace_back(first);
+		m_nfa[split].epsilons.emplace_back(second);
+		return split;
+	}
+
+	//builds the nfa of ast backwards, in front of next; start is where it begins
+	bool _Build(/* in */ const Ast &ast, /* in */ uint32_t next, /* out */ uint32_t &start)
+	{
+		if (m_nfa.size() > MAX_NFA_STATES)
+			return false;
+
+		switch (ast.kind)
+		{
+		case Ast::CHARS:
+			start = _NewState();
+			m_nfa[start].set = ast.set;
+			m_nfa[start].out = next;
+			return true;
+		case Ast::CONCAT:
+			start = next;
+			for (auto child = ast.children.rbegin(); child != ast.children.rend(); ++child)
+				if (!_Build(**child, start, start))
+					return false;
+			return true;
+		case Ast::ALTERNATE:
+		{
+			std::vector<uint32_t> starts(ast.children.size());
+			for (size_t i = 0; i < ast.children.size(); i++)
+				if (!_Build(*ast.children[i], next, starts[i]))
+					return false;
+			start = _NewState();
+			m_nfa[start].epsilons = std::move(starts);
+			return true;
+		}
+		case Ast::REPEAT:
+		{
+			auto &child = *ast.children.front();
+			start = next;
+			if (ast.max == UNBOUNDED)
+			{
+				//a loop that either goes around once more or leaves
+				auto loop = _NewState();
+				uint32_t body = 0;
+				if (!_Build(child, loop, body))
+					return false;
+				m_nfa[loop].epsilons.emplace_back(body);
+				m_nfa[loop].epsilons.emplace_back(next);
+				start = loop;
+			}
+			else
+			{
+				for (uint32_t i = ast.min; i < ast.max; i++)
+				{
+					uint32_t body = 0;
+					if (!_Build(child, start, body))
+						return false;
+					start = _NewSplit(body, start);
+				}
+			}
+			for (uint32_t i = 0; i < ast.min; i++)
+				if (!_Build(child, start, start))
+					return false;
+			return true;
+		}
+		}
+
+		return false;
+	}
+
+	//sorted epsilon closure, in place
+	void _Close(/* inout */ std::vector<uint32_t> &states) const
+	{
+		std::vector<bool> seen(m_nfa.size(), false);
+		std::vector<uint32_t> stack;
+		for (auto state : states)
+			if (!seen[state])
+			{
+				seen[state] = true;
+				stack.emplace_back(state);
+			}
+
+		states.clear();
+		while (!stack.empty())
+		{
+			auto state = stack.back();
+			stack.pop_back();
+			states.emplace_back(state);
+			for (auto epsilon : m_nfa[state].epsilons)
+				if (!seen[epsilon])
+				{
+					seen[epsilon] = true;
+					stack.emplace_back(epsilon);
+				}
+		}
+
+		//only the states that consume a character or accept tell dfa states apart
+		states.erase(std::remove_if(states.begin(), states.end(), [this] (uint32_t state)
+		{ return m_nfa[state].set == NO_SET && !m_nfa[state].bMatch; }), states.end());
+		std::sort(states.begin(), states.end());
+	}
+
+	StateId _AddDfaState(/* in */ const std::vector<uint32_t> &nfaStates)
+	{
+		auto found = m_dfaIds.find(nfaStates);
+		if (found != m_dfaIds.end())
+			return found->second;
+
+		StateId id = static_cast<StateId>(m_dfa.size());
+		DfaState state;
+		state.nfaStates = nfaStates;
+		state.bAccepting = std::any_of(nfaStates.cbegin(), nfaStates.cend(), [this] (uint32_t nfa) { return m_nfa[nfa].bMatch; });
+		m_dfa.emplace_back(std::move(state));
+		m_dfaIds.emplace(nfaStates, id);
+		return id;
+	}
+
+	std::vector<CharSet> m_sets;
+	std::vector<NfaState> m_nfa;
+	std::vector<DfaState> m_dfa;
+	std::map<std::vector<uint32_t>, StateId> m_dfaIds;
+	StateId m_start;
+};
@@ -0,0 +1,202 @@
+#pragma once
+
+//the longest path matched by a regex between two nodes, memoized by (regex, source, destination)
+//the cache is tagged with the generation of the graph it was filled from; the graph bumps its generation on every change,
+//and the first lookup with a new one drops everything (a new edge can make a longer path, a removed one can break a cached
+//path, so no entry survives a change)
+//the cost of an entry is one plus the edges of its path, past the capacity the least recently used entries go
+//every call takes the lock of the cache, so the const queries of a graph share it from several threads
+template <typename NodeType, typename EdgeType>
+class RegexPathCache
+{
+public:
+	typedef std::vector<const EdgeType *> Path;
+
+	static const size_t DEFAULT_CAPACITY = 1 << 16;
+
+public:
+	RegexPathCache() : m_generation(0), m_capacity(DEFAULT_CAPACITY), m_cost(0) { }
+	RegexPathCache(const RegexPathCache &other) : m_generation(0), m_capacity(DEFAULT_CAPACITY), m_cost(0) { *this = other; }
+	RegexPathCache &operator =(const RegexPathCache &other)
+	{
+		if (this != &other)
+		{
+			Clear();
+			SetCapacity(other.GetCapacity());
+			m_generation = other.GetGeneration();
+			other.ForEach([&] (const std::wstring &regex, const NodeType *source, const NodeType *destination, const Path &path)
+			{
+				Insert(m_generation, regex, source, destination, path);
+			});
+		}
+		return *this;
+	}
+	RegexPathCache(RegexPathCache &&other) : m_generation(0), m_capacity(DEFAULT_CAPACITY), m_cost(0) { *this = std::move(other); }
+	//the list and map nodes don't move, so the keys and list iterators stay valid
+	RegexPathCache &operator =(RegexPathCache &&other)
+	{
+		if (this != &other)
+		{
+			std::lock(m_mutex, other.m_mutex);
+			std::lock_guard<std::mutex> lock(m_mutex, std::adopt_lock), otherLock(other.m_mutex, std::adopt_lock);
+			m_lru = std::move(other.m_lru);
+			m_entries = std::move(other.m_entries);
+			m_generation = other.m_generation;
+			m_capacity = other.m_capacity;
+			m_cost = other.m_cost;
+			other.m_cost = 0;
+		}
+		return *this;
+	}
+
+	//false on a miss or when the graph changed since the entries were stored
+	bool Find(/* in */ uint64_t generation, /* in */ const std::wstring &regex, /* in */ const NodeType *source, /* in */ const NodeType *destination, /* out */ Path &path)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		_Validate(generation);
+		auto found = m_entries.find(Key(regex, source, destination));
+		if (found == m_entries.end())
+			return false;
+
+		m_lru.splice(m_lru.begin(), m_lru, found->second.lru);
+		path = found->second.path;
+		return true;
+	}
+
+	void Insert(/* in */ uint64_t generation, /* in */ const std::wstring &regex, /* in */ const NodeType *source, /* in */ const NodeType *destination, /* in */ Path path)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		_Validate(generation);
+		auto inserted = m_entries.emplace(Key(regex, source, destination), Entry());
+		auto &entry = inserted.first->second;
+		if (inserted.second)
+		{
+			m_lru.emplace_front(&inserted.first->first);
+			entry.lru = m_lru.begin();
+		}
+		else
+		{
+			m_cost -= _Cost(entry.path);
+			m_lru.splice(m_lru.begin(), m_lru, entry.lru);
+		}
+		entry.path = std::move(path);
+		m_cost += _Cost(entry.path);
+		_Evict();
+	}
+
+	//fn(regex, source, destination, path) for every entry, least recently used first
+	template <typename Fn>
+	void ForEach(/* in */ Fn fn) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto key = m_lru.rbegin(); key != m_lru.rend(); key++)
+			fn((*key)->regex, (*key)->source, (*key)->destination, m_entries.find(**key)->second.path);
+	}
+
+	inline void SetGeneration(/* in */ uint64_t generation)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		_Validate(generation);
+	}
+	inline uint64_t GetGeneration(void) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_generation;
+	}
+
+	inline void SetCapacity(/* in */ size_t capacity)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_capacity = capacity;
+		_Evict();
+	}
+
+	inline size_t GetCapacity(void) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_capacity;
+	}
+	inline size_t size(void) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_entries.size();
+	}
+	inline size_t GetCost(void) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_cost;
+	}
+
+	inline void Clear(void)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		_Clear();
+	}
+
+private:
+	inline void _Clear(void)
+	{
+		m_lru.clear();
+		m_entries.clear();
+		m_cost = 0;
+	}
+
+	struct Key
+	{
+		Key(/* in */ const std::wstring &regex, /* in */ const NodeType *source, /* in */ const NodeType *destination) : regex(regex), source(source), destination(destination) { }
+
+		inline bool operator==(/* in */ const Key &other) const
+		{ return source == other.source && destination == other.destination && regex == other.regex; }
+
+		std::wstring regex;
+		const NodeType *source;
+		const NodeType *destination;
+	};
+
+	struct KeyHash
+	{
+		inline size_t operator()(/* in */ const Key &key) const
+		{
+			uint64_t hash = reinterpret_cast<uintptr_t>(key.source) * 0x9E3779B97F4A7C15ull ^ reinterpret_cast<uintptr_t>(key.destination);
+			return std::hash<std::wstring>()(key.regex) ^ static_cast<size_t>(hash ^ (hash >> 29));
+		}
+	};
+
+	typedef std::list<const Key *> Lru;
+
+	struct Entry
+	{
+		Path path;
+		typename Lru::iterator lru;
+	};
+
+	inline static size_t _Cost(/* in */ const Path &path) { return path.size() + 1; }
+
+	inline void _Validate(/* in */ uint64_t generation)
+	{
+		if (generation == m_generation)
+			return;
+
+		_Clear();
+		m_generation = generation;
+	}
+
+	inline void _Evict(void)
+	{
+		while (m_cost > m_capacity && !m_lru.empty())
+		{
+			auto found = m_entries.find(*m_lru.back());
+			m_cost -= _Cost(found->second.path);
+			m_lru.pop_back();
+			m_entries.erase(found);
+		}
+	}
+
+	mutable std::mutex m_mutex;
+	//the keys of m_entries, most recently used first
+	Lru m_lru;
+	std::unordered_map<Key, Entry, KeyHash> m_entries;
+	uint64_t m_generation;
+	size_t m_capacity;
+	size_t m_cost;
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+typedef uint32_t SlotIndex;
+const SlotIndex INVALID_SLOT = std::numeric_limits<SlotIndex>::max();
+
+//stores records in fixed size slabs, so their addresses stay valid until they are erased
+//moving a pool only moves the slab table; Clear() releases everything slab by slab
+template <typename Type, size_t SlabSize = 512>
+class SlabPool
+{
+	typedef typename std::aligned_storage<sizeof(Type), std::alignment_of<Type>::value>::type Storage;
+
+public:
+	class const_iterator
+	{
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef const Type value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const Type * pointer;
+		typedef const Type & reference;
+
+		const_iterator() : m_pool(nullptr), m_index(0) { }
+		const_iterator(/* in */ const SlabPool *pool, /* in */ SlotIndex index) : m_pool(pool), m_index(index) { _SkipFree(); }
+
+		inline reference operator*() const { return (*m_pool)[m_index]; }
+		inline pointer operator->() const { return &(*m_pool)[m_index]; }
+		inline const_iterator &operator++() { m_index++; _SkipFree(); return *this; }
+		inline const_iterator operator++(int) { const_iterator old(*this); ++*this; return old; }
+		inline bool operator==(/* in */ const const_iterator &other) const { return m_index == other.m_index; }
+		inline bool operator!=(/* in */ const const_iterator &other) const { return m_index != other.m_index; }
+		inline SlotIndex GetIndex(void) const { return m_index; }
+
+	private:
+		inline void _SkipFree(void)
+		{
+			while (m_index < m_pool->m_end && !m_pool->m_live[m_index])
+				m_index++;
+		}
+
+		const SlabPool *m_pool;
+		SlotIndex m_index;
+	};
+	typedef const_iterator iterator;
+
+public:
+	SlabPool() : m_end(0), m_size(0) { }
+
+	//records keep their slots, so anything indexed by slot stays valid for the copy
+	SlabPool(/* in */ const SlabPool &other) : SlabPool()
+	{
+		_Reserve(other.m_end);
+		for (SlotIndex index = 0; index < other.m_end; index++)
+		{
+			if (other.m_live[index])
+			{
+				new (_Address(index)) Type(other[index]);
+				m_live[index] = true;
+				m_size++;
+			}
+		}
+		m_end = other.m_end;
+		m_free = other.m_free;
+	}
+
+	SlabPool(/* inout */ SlabPool &&other) :
+		m_slabs(std::move(other.m_slabs)),
+		m_live(std::move(other.m_live)),
+		m_free(std::move(other.m_free)),
+		m_end(other.m_end),
+		m_size(other.m_size)
+	{
+		other._Reset();
+	}
+
+	SlabPool &operator =(/* in */ SlabPool other)
+	{
+		Swap(other);
+		return *this;
+	}
+
+	~SlabPool() { Clear(); }
+
+	template <typename ...Args>
+	SlotIndex Emplace(/* in */ Args&& ...args)
+	{
+		SlotIndex index;
+		if (!m_free.empty())
+		{
+			index = m_free.back();
+			new (_Address(index)) Type(std::forward<Args>(args)...);
+			m_free.pop_back();
+		}
+		else
+		{
+			_Reserve(m_end + 1);
+			index = m_end;
+			new (_Address(index)) Type(std::forward<Args>(args)...);
+			m_end++;
+		}
+
+		m_live[index] = true;
+		m_size++;
+		return index;
+	}
+
+	void Erase(/* in */ SlotIndex index)
+	{
+		_Address(index)->~Type();
+		m_live[index] = false;
+		m_free.emplace_back(index);
+		m_size--;
+	}
+
+	void Clear(void)
+	{
+		for (SlotIndex index = 0; index < m_end; index++)
+			if (m_live[index])
+				_Address(index)->~Type();
+
+		m_slabs.clear();
+		_Reset();
+	}
+
+	inline void Swap(/* inout */ SlabPool &other)
+	{
+		m_slabs.swap(other.m_slabs);
+		m_live.swap(other.m_live);
+		m_free.swap(other.m_free);
+		std::swap(m_end, other.m_end);
+		std::swap(m_size, other.m_size);
+	}
+
+	inline Type &operator[](/* in */ SlotIndex index) { return *_Address(index); }
+	inline const Type &operator[](/* in */ SlotIndex index) const { return *const_cast<SlabPool *>(this)->_Address(index); }
+	inline bool IsLive(/* in */ SlotIndex index) const { return index < m_end && m_live[index]; }
+	//upper bound of the slot indexes handed out so far
+	inline SlotIndex GetEndIndex(void) const { return m_end; }
+
+	inline size_t size(void) const { return m_size; }
+	inline bool empty(void) const { return m_size == 0; }
+	inline const_iterator begin(void) const { return const_iterator(this, 0); }
+	inline const_iterator end(void) const { return const_iterator(this, m_end); }
+	inline const_iterator cbegin(void) const { return begin(); }
+	inline const_iterator cend(void) const { return end(); }
+
+	//same content regardless of the slots, like the unordered containers compare
+	inline bool operator==(/* in */ const SlabPool &other) const
+	{ return m_size == other.m_size && std::is_permutation(begin(), end(), other.begin()); }
+	inline bool operator!=(/* in */ const SlabPool &other) const { return !(*this == other); }
+
+private:
+	inline Type *_Address(/* in */ SlotIndex index)
+	{ return reinterpret_cast<Type *>(&m_slabs[index / SlabSize][index % SlabSize]); }
+
+	void _Reserve(/* in */ SlotIndex slots)
+	{
+		while (m_slabs.size() * SlabSize < slots)
+			m_slabs.emplace_back(new Storage[SlabSize]);
+		if (m_live.size() < slots)
+			m_live.resize(slots, false);
+	}
+
+	inline void _Reset(void)
+	{
+		m_slabs.clear();
+		m_live.clear();
+		m_free.clear();
+		m_end = 0;
+		m_size = 0;
+	}
+
+	std::vector<std::unique_ptr<Storage[]>> m_slabs;
+	std::vector<bool> m_live;
+	std::vector<SlotIndex> m_free;
+	SlotIndex m_end;
+	size_t m_size;
+};
@@ -0,0 +1,239 @@
+#pragma once
+
+#include "Node.h"
+#include "Edge.h"
+
+//edges removed from a context graph, kept in segments in the order they were archived
+//every segment knows the span of its archive times and of its validity intervals, and indexes its edges by label,
+//so an as-of / between query only opens the segments that can hold an answer
+//the retention policy drops whole segments, oldest first; pointers to the dropped edges are gone with them
+template <typename Policy>
+class BasicTemporalArchive
+{
+public:
+	typedef Node<Policy> CNode;
+	typedef Edge<Policy> CEdge;
+	typedef std::chrono::system_clock::time_point TimePoint;
+
+	static const size_t DEFAULT_SEGMENT_SIZE = 1024;
+
+private:
+	struct Segment
+	{
+		Segment() :
+			firstArchived(TimePoint::max()),
+			lastArchived(TimePoint::min()),
+			validFrom(TimePoint::max()),
+			validTo(TimePoint::min())
+		{ }
+
+		inline bool MayHold(/* in */ TimePoint from, /* in */ TimePoint to) const
+		{ return lastArchived >= from && validFrom <= to && validTo >= from; }
+
+		//deque, so the archived edges never move
+		std::deque<CEdge> edges;
+		std::vector<TimePoint> archivedAt;
+		std::unordered_map<LabelId, std::vector<size_t>, typename Policy::Hash> byLabel;
+		TimePoint firstArchived;
+		TimePoint lastArchived;
+		TimePoint validFrom;
+		TimePoint validTo;
+	};
+
+	//archived nodes are shared by label and counted, a node goes when its last edge does
+	typedef std::unordered_map<LabelId, std::pair<CNode, size_t>, typename Policy::Hash> Nodes;
+
+public:
+	BasicTemporalArchive() :
+		m_segmentSize(DEFAULT_SEGMENT_SIZE),
+		m_maxAge(TimePoint::duration::max()),
+		m_maxEdges(std::numeric_limits<size_t>::max()),
+		m_size(0)
+	{ }
+
+	BasicTemporalArchive(/* in */ const BasicTemporalArchive &other) :
+		m_segments(other.m_segments),
+		m_nodes(other.m_nodes),
+		m_segmentSize(other.m_segmentSize),
+		m_maxAge(other.m_maxAge),
+		m_maxEdges(other.m_maxEdges),
+		m_size(other.m_size)
+	{
+		for (auto &segment : m_segments)
+			for (auto &edge : segment.edges)
+				edge.SetNodes(m_nodes.at(edge.GetSource().GetLabelId()).first, m_nodes.at(edge.GetDestination().GetLabelId()).first);
+	}
+
+	BasicTemporalArchive(/* in */ BasicTemporalArchive &&other) = default;
+	BasicTemporalArchive &operator =(/* in */ BasicTemporalArchive &&other) = default;
+
+	BasicTemporalArchive &operator =(/* in */ const BasicTemporalArchive &other)
+	{
+		if (this != &other)
+		{
+			BasicTemporalArchive copy(other);
+			*this = std::move(copy);
+		}
+
+		return *this;
+	}
+
+	//keeps a copy of edge (and of its endpoints), archived at archivedAt
+	const CEdge &Add(/* in */ const CEdge &edge, /* in */ TimePoint archivedAt)
+	{
+		if (m_segments.empty() || m_segments.back().edges.size() >= m_segmentSize)
+		{
+			m_segments.emplace_back();
+			_ApplyMaxEdges();
+		}
+
+		auto &segment = m_segments.back();
+		const auto &source = _AddNode(edge.GetSource());
+		const auto &destination = _AddNode(edge.GetDestination());
+		segment.edges.emplace_back(edge.CopyWithNodes(source, destination, NEVER_EXPIRE, edge.GetDuration()));
+		segment.archivedAt.emplace_back(archivedAt);
+		segment.byLabel[edge.GetLabelId()].emplace_back(segment.edges.size() - 1);
+
+		auto duration = edge.GetDuration();
+		segment.firstArchived = std::min(segment.firstArchived, archivedAt);
+		segment.lastArchived = std::max(segment.lastArchived, archivedAt);
+		segment.validFrom = std::min(segment.validFrom, duration.first);
+		segment.validTo = std::max(segment.validTo, duration.second);
+		m_size++;
+
+		return segment.edges.back();
+	}
+
+	//maxAge counts from the archive time of the newest edge of a segment; segments are dropped whole
+	inline void SetRetention(/* in */ TimePoint::duration maxAge, /* in */ size_t maxEdges = std::numeric_limits<size_t>::max())
+	{
+		m_maxAge = maxAge;
+		m_maxEdges = maxEdges;
+		_ApplyMaxEdges();
+	}
+	inline void SetSegmentSize(/* in */ size_t segmentSize) { m_segmentSize = std::max<size_t>(segmentSize, 1); }
+
+	//drops the segments past the retention age at now; returns how many edges went
+	size_t ApplyRetention(/* in */ TimePoint now)
+	{
+		size_t dropped = 0;
+		while (!m_segments.empty() && m_maxAge != TimePoint::duration::max() && m_segments.front().lastArchived < now - m_maxAge)
+			dropped += _DropOldestSegment();
+
+		return dropped;
+	}
+
+	//the archived edges that were still in the graph at some point of [from, to] and whose validity intersects it
+	template <typename Fn>
+	void ForEachBetween(/* in */ TimePoint from, /* in */ TimePoint to, /* in */ Fn fn) const
+	{
+		for (auto &segment : m_segments)
+		{
+			if (!segment.MayHold(from, to))
+				continue;
+			for (size_t i = 0; i < segment.edges.size(); i++)
+				if (_IsIn(segment, i, from, to))
+					fn(segment.edges[i]);
+		}
+	}
+
+	template <typename Fn>
+	inline void ForEachAsOf(/* in */ TimePoint time, /* in */ Fn fn) const { ForEachBetween(time, time, fn); }
+
+	//same as ForEachBetween, restricted to one label
+	template <typename Fn>
+	void ForEachByLabel(/* in */ LabelId label, /* in */ TimePoint from, /* in */ TimePoint to, /* in */ Fn fn) const
+	{
+		for (auto &segment : m_segments)
+		{
+			if (!segment.MayHold(from, to))
+				continue;
+			auto found = segment.byLabel.find(label);
+			if (found == segment.byLabel.cend())
+				continue;
+			for (auto i : found->second)
+				if (_IsIn(segment, i, from, to))
+					fn(segment.edges[i]);
+		}
+	}
+
+	template <typename Fn>
+	inline void ForEach(/* in */ Fn fn) const { ForEachBetween(TimePoint::min(), TimePoint::max(), fn); }
+
+	template <typename Fn>
+	void ForEachNode(/* in */ Fn fn) const
+	{
+		for (auto &node : m_nodes)
+			fn(node.second.first);
+	}
+
+	inline const CNode *FindNode(/* in */ const CNode &node) const
+	{
+		auto found = m_nodes.find(node.GetLabelId());
+		return found != m_nodes.cend() ? &found->second.first : nullptr;
+	}
+
+	inline size_t size(void) const { return m_size; }
+	inline bool empty(void) const { return m_size == 0; }
+	inline size_t GetSegmentCount(void) const { return m_segments.size(); }
+
+	inline void Clear(void)
+	{
+		m_segments.clear();
+		m_nodes.clear();
+		m_size = 0;
+	}
+
+private:
+	inline static bool _IsIn(/* in */ const Segment &segment, /* in */ size_t i, /* in */ TimePoint from, /* in */ TimePoint to)
+	{
+		auto duration = segment.edges[i].GetDuration();
+		return segment.archivedAt[i] >= from && duration.first <= to && duration.second >= from;
+	}
+
+	const CNode &_AddNode(/* in */ const CNode &node)
+	{
+		auto found = m_nodes.find(node.GetLabelId());
+		if (found == m_nodes.end())
+			found = m_nodes.emplace(node.GetLabelId(), std::make_pair(node, size_t(0))).first;
+		found->second.second++;
+
+		return found->second.first;
+	}
+
+	void _ReleaseNode(/* in */ const CNode &node)
+	{
+		auto found = m_nodes.find(node.GetLabelId());
+		if (found != m_nodes.end() && --found->second.second == 0)
+			m_nodes.erase(found);
+	}
+
+	//keeps the segment being filled
+	void _ApplyMaxEdges(void)
+	{
+		while (m_segments.size() > 1 && m_size > m_maxEdges)
+			_DropOldestSegment();
+	}
+
+	size_t _DropOldestSegment(void)
+	{
+		auto &segment = m_segments.front();
+		auto dropped = segment.edges.size();
+		for (auto &edge : segment.edges)
+		{
+			_ReleaseNode(edge.GetSource());
+			_ReleaseNode(edge.GetDestination());
+		}
+
+		m_size -= dropped;
+		m_segments.pop_front();
+		return dropped;
+	}
+
+	std::deque<Segment> m_segments;
+	Nodes m_nodes;
+	size_t m_segmentSize;
+	TimePoint::duration m_maxAge;
+	size_t m_maxEdges;
+	size_t m_size;
+};
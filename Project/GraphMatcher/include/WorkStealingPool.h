@@ -0,0 +1,102 @@
+#pragma once
+
+//runs a task, and every task it pushes, on a number of threads; each thread has a deque of its own, takes its newest task
+//first and, out of work, steals the oldest task of another one (the oldest were pushed nearest the root of whatever the
+//tasks split, so they are the largest)
+//fn(worker, task, push) runs a task on the thread numbered worker, the calling thread being worker 0, and push hands out
+//more work; Run returns once every task ran, and rethrows the first exception a task threw (the tasks left are dropped)
+template <typename Task>
+class WorkStealingPool
+{
+public:
+	typedef std::function<void(/* in */ Task &&task)> Push;
+
+	template <typename Fn>
+	static void Run(/* in */ unsigned int threads, /* in */ Task root, /* in */ Fn fn)
+	{
+		threads = std::max(1u, threads);
+		std::vector<Queue> queues(threads);
+		queues[0].tasks.emplace_back(std::move(root));
+		//pushed and not finished yet, the workers leave once it drops to zero
+		std::atomic<size_t> pending(1);
+		std::atomic<bool> bFailed(false);
+		std::exception_ptr error;
+
+		auto fnWork = [&] (/* in */ unsigned int worker)
+		{
+			Push push = [&] (/* in */ Task &&task)
+			{
+				pending++;
+				std::lock_guard<std::mutex> lock(queues[worker].mutex);
+				queues[worker].tasks.emplace_back(std::move(task));
+			};
+
+			Task task;
+			while (pending > 0)
+			{
+				if (!_Pop(queues[worker], task) && !_Steal(queues, worker, task))
+				{
+					std::this_thread::yield();
+					continue;
+				}
+
+				if (!bFailed)
+				{
+					try
+					{
+						fn(worker, task, push);
+					}
+					catch (...)
+					{
+						if (!bFailed.exchange(true))
+							error = std::current_exception();
+					}
+				}
+				pending--;
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for (unsigned int worker = 1; worker < threads; worker++)
+			workers.emplace_back(fnWork, worker);
+		fnWork(0);
+		for (auto &worker : workers)
+			worker.join();
+
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+private:
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	inline static bool _Pop(/* inout */ Queue &queue, /* out */ Task &task)
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tasks.empty())
+			return false;
+		task = std::move(queue.tasks.back());
+		queue.tasks.pop_back();
+		return true;
+	}
+
+	static bool _Steal(/* inout */ std::vector<Queue> &queues, /* in */ unsigned int worker, /* out */ Task &task)
+	{
+		for (size_t i = 1; i < queues.size(); i++)
+		{
+			auto &queue = queues[(worker + i) % queues.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (!queue.tasks.empty())
+			{
+				task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+};